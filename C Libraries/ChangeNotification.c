@@ -20,6 +20,14 @@
 #define _CN_IPL_IPC	4
 #define _CN_SPL_IPC	0
 
+// Ports carrying CN pins, index into cn_ports
+#define CN_PORTB    0
+#define CN_PORTC    1
+#define CN_PORTD    2
+#define CN_PORTF    3
+#define CN_PORTG    4
+#define NUM_CN_PORTS 5
+
 /*******************************************************************************
  * PRIVATE TYPES
  ******************************************************************************/
@@ -35,6 +43,7 @@ typedef struct{
     unsigned char pin;
     volatile unsigned int *TRIS;
     volatile unsigned int *PORT;
+    unsigned char port;
 } CN_SETTING;
 
 /*******************************************************************************
@@ -66,36 +75,56 @@ CN_STATE cn_states[NUM_CN] = {
 };
 
 const CN_SETTING cn_settings[NUM_CN] = {
-	{ 14, &TRISC, &PORTC }, // CN0  - RC14
-	{ 13, &TRISC, &PORTC }, // CN1  - RC13
-	{  0, &TRISB, &PORTB }, // CN2  - RB0
-	{  1, &TRISB, &PORTB }, // CN3  - RB1
-	{  2, &TRISB, &PORTB }, // CN4  - RB2
-	{  3, &TRISB, &PORTB }, // CN5  - RB3
-	{  4, &TRISB, &PORTB }, // CN6  - RB4
-	{  5, &TRISB, &PORTB }, // CN7  - RB5
-	{  6, &TRISG, &PORTG }, // CN8  - RG6
-	{  7, &TRISG, &PORTG }, // CN9  - RG7
-	{  8, &TRISG, &PORTG }, // CN10 - RG8
-	{  9, &TRISG, &PORTG }, // CN11 - RG9
-	{ 15, &TRISB, &PORTB }, // CN12 - RB15
-	{  4, &TRISD, &PORTD }, // CN13 - RD4
-	{  5, &TRISD, &PORTD }, // CN14 - RD5
-	{  6, &TRISD, &PORTD }, // CN15 - RD6
-	{  7, &TRISD, &PORTD }, // CN16 - RD7
-	{  4, &TRISF, &PORTF }, // CN17 - RF4
-	{  5, &TRISF, &PORTF }, // CN18 - RF5
-	{ 13, &TRISD, &PORTD }, // CN19 - RD13
-	{ 14, &TRISD, &PORTD }, // CN20 - RD14
-	{ 15, &TRISD, &PORTD }  // CN21 - RD15
+	{ 14, &TRISC, &PORTC, CN_PORTC }, // CN0  - RC14
+	{ 13, &TRISC, &PORTC, CN_PORTC }, // CN1  - RC13
+	{  0, &TRISB, &PORTB, CN_PORTB }, // CN2  - RB0
+	{  1, &TRISB, &PORTB, CN_PORTB }, // CN3  - RB1
+	{  2, &TRISB, &PORTB, CN_PORTB }, // CN4  - RB2
+	{  3, &TRISB, &PORTB, CN_PORTB }, // CN5  - RB3
+	{  4, &TRISB, &PORTB, CN_PORTB }, // CN6  - RB4
+	{  5, &TRISB, &PORTB, CN_PORTB }, // CN7  - RB5
+	{  6, &TRISG, &PORTG, CN_PORTG }, // CN8  - RG6
+	{  7, &TRISG, &PORTG, CN_PORTG }, // CN9  - RG7
+	{  8, &TRISG, &PORTG, CN_PORTG }, // CN10 - RG8
+	{  9, &TRISG, &PORTG, CN_PORTG }, // CN11 - RG9
+	{ 15, &TRISB, &PORTB, CN_PORTB }, // CN12 - RB15
+	{  4, &TRISD, &PORTD, CN_PORTD }, // CN13 - RD4
+	{  5, &TRISD, &PORTD, CN_PORTD }, // CN14 - RD5
+	{  6, &TRISD, &PORTD, CN_PORTD }, // CN15 - RD6
+	{  7, &TRISD, &PORTD, CN_PORTD }, // CN16 - RD7
+	{  4, &TRISF, &PORTF, CN_PORTF }, // CN17 - RF4
+	{  5, &TRISF, &PORTF, CN_PORTF }, // CN18 - RF5
+	{ 13, &TRISD, &PORTD, CN_PORTD }, // CN19 - RD13
+	{ 14, &TRISD, &PORTD, CN_PORTD }, // CN20 - RD14
+	{ 15, &TRISD, &PORTD, CN_PORTD }  // CN21 - RD15
+};
+
+volatile unsigned int * const cn_ports[NUM_CN_PORTS] = {
+    &PORTB, &PORTC, &PORTD, &PORTF, &PORTG
 };
 
+/*
+ * Dispatch tables for the ISR, rebuilt on attach and detach
+ * cn_port_mask - active CN bits on each port
+ * cn_port_last - port value as of the last ISR, only masked bits are valid
+ * cn_bit_to_cn - CN number for each port bit
+ */
+unsigned int cn_port_mask[NUM_CN_PORTS];
+unsigned int cn_port_last[NUM_CN_PORTS];
+unsigned char cn_bit_to_cn[NUM_CN_PORTS][16];
+
+#ifdef CN_ISR_PROFILE
+volatile unsigned int cn_isr_last;
+volatile unsigned int cn_isr_max;
+#endif
+
 /*******************************************************************************
  * PUBLIC FUNCTIONS
  ******************************************************************************/
 char CN_AttachInterrupt(CN cn, void (*function)(int), CN_INTTYPE type)
 {
     int s;
+    int p;
 
     // check bounds
     if (cn.num < 0 || cn.num > NUM_CN)
@@ -140,6 +169,13 @@ char CN_AttachInterrupt(CN cn, void (*function)(int), CN_INTTYPE type)
     // if s, set 1 else 0
     cn_states[cn.num].current = cn_states[cn.num].previous = s == 0 ? 0 : 1;
 
+    // add to the ISR dispatch, snapshot starts from the level just read
+    IEC1bits.CNIE = 0;
+    p = cn_settings[cn.num].port;
+    cn_bit_to_cn[p][cn_settings[cn.num].pin] = cn.num;
+    cn_port_last[p] = (cn_port_last[p] & ~(1<<cn_settings[cn.num].pin)) | s;
+    cn_port_mask[p] |= 1<<cn_settings[cn.num].pin;
+
     // clear int flag, enable int, and assign priorities
     // enable CN control reg, disable stop idle
     IFS1bits.CNIF	=	0;
@@ -178,6 +214,9 @@ char CN_DetachInterrupt(CN cn, CN_INTTYPE type)
 	// disable CN for this pin
 	CNEN &= ~(1<<cn.num);
 
+	// drop from the ISR dispatch
+	cn_port_mask[cn_settings[cn.num].port] &= ~(1<<cn_settings[cn.num].pin);
+
 	// mark inactive
 	cn_states[cn.num].isActive = 0x00;
     }
@@ -185,47 +224,106 @@ char CN_DetachInterrupt(CN cn, CN_INTTYPE type)
     return SUCCESS;
 }
 
+char CN_ReadPin(CN cn)
+{
+    // check bounds
+    if (cn.num >= NUM_CN)
+	return ERROR;
+
+    return cn_states[cn.num].current;
+}
+
+unsigned char CN_DisableInterrupts(void)
+{
+    unsigned char state = IEC1bits.CNIE;
+
+    IEC1bits.CNIE = 0;
+
+    return state;
+}
+
+void CN_RestoreInterrupts(unsigned char state)
+{
+    IEC1bits.CNIE = state;
+}
+
+#ifdef CN_ISR_PROFILE
+void CN_GetISRCycles(unsigned int *last, unsigned int *max)
+{
+    // core timer ticks once every 2 system clocks
+    *last = cn_isr_last * 2;
+    *max = cn_isr_max * 2;
+}
+#endif
+
 /*******************************************************************************
  * PRIVATE FUNCTIONS
  ******************************************************************************/
+/*
+ * Reads each port with active pins once, finds the pins that changed from the
+ * XOR with the last read and walks only those, highest bit first using clz.
+ * Every pin's state is updated before any handler runs, so a handler reading
+ * another pin with CN_ReadPin sees it as of this interrupt. Two pins that
+ * changed together, like both channels of a quadrature encoder, then read as
+ * one change rather than two in port order
+ */
 void __ISR(_CHANGE_NOTICE_VECTOR, _CN_IPL_ISR) cn_isr()
 {
+    unsigned char p;
     unsigned char i;
-    unsigned int onoff;
-
-    // Update all ACTIVE CN pin values, call appropriate handlers
-    for (i = 0; i < NUM_CN; i++) {
-	
-	// check that its active first, save some processing
-	if (cn_states[i].isActive) {
-
-	    // Read the CN pin, store in var s
-	    onoff = (*(cn_settings[i].PORT) & (1 << cn_settings[i].pin)) ? 0x01 : 0x00;
-
-	    // If state changed
-	    if (cn_states[i].current != onoff) {
-		
-		// update state memory
-		cn_states[i].previous = cn_states[i].current;
-		cn_states[i].current = onoff;
-
-		// if FALLING EDGE and service functions exist to handle
-		if (cn_states[i].previous == 0x01) {
-
-		    // call falling edge handler
-		    if (cn_states[i].falling != NULL)
-			cn_states[i].falling(i);
-		    
-		} else {
-
-		    // call rising edge handler
-		    if (cn_states[i].rising != NULL)
-			cn_states[i].rising(i);
-		}
-	    }
+    unsigned int bit;
+    unsigned int now;
+    unsigned int changed;
+    unsigned int cn_changed[NUM_CN_PORTS];
+    void (*handler)(int);
+#ifdef CN_ISR_PROFILE
+    unsigned int start = _CP0_GET_COUNT();
+#endif
+
+    for (p = 0; p < NUM_CN_PORTS; p++) {
+	cn_changed[p] = 0;
+	if (cn_port_mask[p] == 0)
+	    continue;
+
+	// one read per port, also clears the mismatch for these pins
+	now = *(cn_ports[p]);
+	changed = (now ^ cn_port_last[p]) & cn_port_mask[p];
+	cn_port_last[p] = now;
+	cn_changed[p] = changed;
+
+	// update state memory
+	while (changed) {
+	    bit = 31 - __builtin_clz(changed);
+	    changed &= ~(1 << bit);
+
+	    i = cn_bit_to_cn[p][bit];
+	    cn_states[i].previous = cn_states[i].current;
+	    cn_states[i].current = (now >> bit) & 0x01;
+	}
+    }
+
+    for (p = 0; p < NUM_CN_PORTS; p++) {
+	changed = cn_changed[p];
+
+	while (changed) {
+	    bit = 31 - __builtin_clz(changed);
+	    changed &= ~(1 << bit);
+
+	    i = cn_bit_to_cn[p][bit];
+
+	    // call the handler for the edge type, if one exists
+	    handler = cn_states[i].current ? cn_states[i].rising : cn_states[i].falling;
+	    if (handler != NULL)
+		handler(i);
 	}
     }
 
     // Clear flag
     IFS1bits.CNIF = 0;
+
+#ifdef CN_ISR_PROFILE
+    cn_isr_last = _CP0_GET_COUNT() - start;
+    if (cn_isr_last > cn_isr_max)
+	cn_isr_max = cn_isr_last;
+#endif
 }
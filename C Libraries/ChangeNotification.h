@@ -9,10 +9,11 @@
  * be implemented in other ways. Increased the maximum operating frequency of
  * the module with optimizations to the ISR and module cleanliness.
  *
- * BUG: Module is limited by the CN delay of ~17us and a ~40us execution time
- * for the ISR. Generally, this gives an upper limit of 6kHz on a signal with
- * RISING and FALLING interrupts. Realistically, a lower limit is more likely
- * because of the caller's interrupt handlers.
+ * BUG: Module is limited by the CN delay of ~17us plus the ISR execution time.
+ * The ISR reads each port once and only visits pins that changed, so its cost
+ * scales with the number of edges rather than the number of CN pins. Define
+ * CN_ISR_PROFILE to measure it on the bot, the caller's interrupt handlers
+ * usually dominate.
  *
  * NOTE: AttachInterrupt() resets the current and previous values of that pin
  * even if an interrupt exists, may miss pending interrupts.
@@ -68,6 +69,9 @@ typedef struct {
 
 #define NUM_CN 22
 
+// Define to record ISR run time, read with CN_GetISRCycles()
+//#define CN_ISR_PROFILE
+
 // Enum defining signal interrupt types
 typedef enum {
     RISING,
@@ -104,4 +108,46 @@ char CN_AttachInterrupt(CN cn, void (*func)(int), CN_INTTYPE type);
  */
 char CN_DetachInterrupt(CN cn, CN_INTTYPE type);
 
+/**
+ * @Function CN_ReadPin(CN cn)
+ * @param cn - CN pin to read
+ * @return 1 or 0 for the pin level as last seen by the ISR, ERROR if cn is out
+ * of bounds
+ * @brief Level the handlers are working from, matches the edge being handled
+ * when called from inside a handler
+ * @author rcrobert 2014.12.06
+ */
+char CN_ReadPin(CN cn);
+
+/**
+ * @Function CN_DisableInterrupts(void)
+ * @return Previous interrupt enable state, pass to CN_RestoreInterrupts
+ * @brief Masks the CN interrupt so multi-word data shared with handlers can be
+ * copied consistently. Keep the masked section short, edges that happen while
+ * masked are only caught if the pin has not changed back
+ * @author rcrobert 2014.12.06
+ */
+unsigned char CN_DisableInterrupts(void);
+
+/**
+ * @Function CN_RestoreInterrupts(unsigned char state)
+ * @param state - Value returned by CN_DisableInterrupts
+ * @return None
+ * @author rcrobert 2014.12.06
+ */
+void CN_RestoreInterrupts(unsigned char state);
+
+#ifdef CN_ISR_PROFILE
+/**
+ * @Function CN_GetISRCycles(unsigned int *last, unsigned int *max)
+ * @param last - Cycles spent in the most recent ISR
+ * @param max - Worst case cycles since reset
+ * @return None
+ * @brief Measured from entry of the ISR body to exit, does not include the
+ * compiler's context save and restore
+ * @author rcrobert 2014.12.06
+ */
+void CN_GetISRCycles(unsigned int *last, unsigned int *max);
+#endif
+
 #endif
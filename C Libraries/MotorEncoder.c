@@ -2,6 +2,7 @@
 #include "MotorEncoder.h"
 #include "ChangeNotification.h"
 
+#include <xc.h>
 #include <BOARD.h>
 /*
  * Any advantage in hiding the EncoderData data structure? Should users be given
@@ -23,18 +24,44 @@
 #define ENCODER_6_CN (CN){15}
 
 #define NO_TARGET (-1)
+#define NO_ENCODER (-1)
+#define NO_PAIR (-1)
+
+// Quadrature transition result for an illegal (skipped) state
+#define QUAD_ERR (2)
+
+// Core timer runs at SYSCLK/2
+#define CORE_TICKS_PER_SEC (40000000LL)
+#define CORE_TICKS_PER_MS (40000)
+
+// Edges timed for the interval estimate, 4 intervals is one quadrature cycle
+#define EDGE_HISTORY 5
 
 /*******************************************************************************
  * PRIVATE VARIABLES
  ******************************************************************************/
 unsigned char ActiveEncoders = 0x00;
+unsigned char ClaimedPins = 0x00;   // active encoders plus quadrature B pins
 unsigned char ModInitialized = FALSE;
 
 typedef struct {
-    volatile int count;
+    volatile int32_t count;
     volatile int target;
     void (*handler)();
     unsigned char overflow;
+    volatile uint32_t errors;
+    signed char pair;	    // channel B pin for quadrature, else NO_PAIR
+    unsigned char quadState;	// last AB state, A is bit 1
+
+    // Edge timing, written by the ISR
+    uint32_t edgeTicks[EDGE_HISTORY];	// core timer at recent counted edges
+    unsigned char edgeHead;		// newest entry in edgeTicks
+    unsigned char edgeRun;		// consecutive edges in the same direction
+    signed char edgeDir;
+
+    // Velocity, written by Encoder_UpdateVelocity
+    int32_t windowCount;
+    EncoderVelocity velocity;
 } EncoderData;
 
 EncoderData Encoders[NUM_ENCODERS];
@@ -47,12 +74,31 @@ CN EncoderCN[NUM_ENCODERS] = {
     ENCODER_6_CN
 };
 
+// Encoder owning each CN pin, saves a search in the handler
+signed char CNToEncoder[NUM_CN];
+
+uint32_t LastVelocityUpdate;
+
+/*
+ * Indexed by (oldAB << 2) | newAB. Single steps count +-1, no change is 0 and
+ * both channels changing at once means a state was missed
+ */
+static const signed char QuadTable[16] = {
+     0, -1,  1, QUAD_ERR,
+     1,  0, QUAD_ERR, -1,
+    -1, QUAD_ERR,  0,  1,
+    QUAD_ERR,  1, -1,  0
+};
+
 /*******************************************************************************
  * PRIVATE FUNCTION PROTOTYPES
  ******************************************************************************/
 // Handler function called by CN ISR
 void EncoderHandler(int cn);
 
+static void ResetVelocity(EncoderData *E);
+static int32_t IntervalVelocity(EncoderData *E, uint32_t now);
+
 /*******************************************************************************
  * PUBLIC FUNCTIONS
  ******************************************************************************/
@@ -64,6 +110,7 @@ char Encoder_Init(void)
 
     // No encoders active
     ActiveEncoders = 0x00;
+    ClaimedPins = 0x00;
 
     // Init array
     int i;
@@ -72,6 +119,13 @@ char Encoder_Init(void)
 	Encoders[i].target = NO_TARGET;
 	Encoders[i].handler = NULL;
 	Encoders[i].overflow = FALSE;
+	Encoders[i].errors = 0;
+	Encoders[i].pair = NO_PAIR;
+	Encoders[i].quadState = 0x00;
+    }
+
+    for (i = 0; i < NUM_CN; i++) {
+	CNToEncoder[i] = NO_ENCODER;
     }
 
     // Mark intialized
@@ -88,29 +142,83 @@ char Encoder_AddPins(int encoder)
 	return ERROR;
     }
 
-    if (encoder >= NUM_ENCODERS) {
+    if (encoder >= NUM_ENCODERS || encoder < 0) {
 	// ERROR out of bounds
 	return ERROR;
     }
 
-    if (ActiveEncoders & (1 << encoder)) {
+    if (ClaimedPins & (1 << encoder)) {
 	// ERROR already added
 	return ERROR;
     }
 
+    // Clear
+    EncoderData *E = &(Encoders[encoder]);
+
+    E->count = 0;
+    E->target = NO_TARGET;
+    E->handler = NULL;
+    E->overflow = FALSE;
+    E->errors = 0;
+    E->pair = NO_PAIR;
+    ResetVelocity(E);
+
     // Add to active list
     ActiveEncoders |= (1 << encoder);
+    ClaimedPins |= (1 << encoder);
+    CNToEncoder[EncoderCN[encoder].num] = encoder;
 
     // Attach handler
     CN_AttachInterrupt(EncoderCN[encoder], EncoderHandler, RISING);
 
+    return SUCCESS;
+}
+
+// enables a quadrature encoder on two pins, referred to by channel A after
+char Encoder_AddQuadPins(int encoderA, int encoderB)
+{
+    if (!ModInitialized) {
+	// ERROR not initialized
+	return ERROR;
+    }
+
+    if (encoderA >= NUM_ENCODERS || encoderA < 0 ||
+	    encoderB >= NUM_ENCODERS || encoderB < 0 || encoderA == encoderB) {
+	// ERROR out of bounds
+	return ERROR;
+    }
+
+    if (ClaimedPins & ((1 << encoderA) | (1 << encoderB))) {
+	// ERROR already added
+	return ERROR;
+    }
+
     // Clear
-    EncoderData *E = &(Encoders[encoder]);
+    EncoderData *E = &(Encoders[encoderA]);
 
     E->count = 0;
     E->target = NO_TARGET;
     E->handler = NULL;
     E->overflow = FALSE;
+    E->errors = 0;
+    E->pair = encoderB;
+    ResetVelocity(E);
+
+    // Both channels land on the A entry, only A is visible through the API
+    ActiveEncoders |= (1 << encoderA);
+    ClaimedPins |= (1 << encoderA) | (1 << encoderB);
+    CNToEncoder[EncoderCN[encoderA].num] = encoderA;
+    CNToEncoder[EncoderCN[encoderB].num] = encoderA;
+
+    // Decode every edge on both channels
+    CN_AttachInterrupt(EncoderCN[encoderA], EncoderHandler, RISING);
+    CN_AttachInterrupt(EncoderCN[encoderA], EncoderHandler, FALLING);
+    CN_AttachInterrupt(EncoderCN[encoderB], EncoderHandler, RISING);
+    CN_AttachInterrupt(EncoderCN[encoderB], EncoderHandler, FALLING);
+
+    // Start from the current state so the first edge decodes cleanly
+    E->quadState = (CN_ReadPin(EncoderCN[encoderA]) << 1) |
+	    CN_ReadPin(EncoderCN[encoderB]);
 
     return SUCCESS;
 }
@@ -202,6 +310,117 @@ int Encoder_GetCount(int encoder)
     return Encoders[encoder].count;
 }
 
+// copies count and errors without the ISR landing in between
+char Encoder_GetSnapshot(int encoder, EncoderSnapshot *snap)
+{
+    unsigned char intState;
+
+    if (!ModInitialized) {
+	// ERROR not initialized
+	return ERROR;
+    }
+
+    if (encoder >= NUM_ENCODERS || encoder < 0) {
+	// ERROR out of range
+	return ERROR;
+    }
+
+    if ( !(ActiveEncoders & (1 << encoder))) {
+	// ERROR not active yet
+	return ERROR;
+    }
+
+    intState = CN_DisableInterrupts();
+    snap->count = Encoders[encoder].count;
+    snap->errors = Encoders[encoder].errors;
+    CN_RestoreInterrupts(intState);
+
+    return SUCCESS;
+}
+
+// refreshes all velocity estimates, safe to call every pass of the main loop
+uint8_t Encoder_UpdateVelocity(void)
+{
+    int i;
+    uint32_t now;
+    uint32_t windowTicks;
+    int32_t count;
+    int32_t windowCounts;
+    int32_t countVel;
+    int32_t edgeVel;
+    int32_t weight;
+    unsigned char intState;
+    EncoderData *E;
+
+    if (!ModInitialized)
+	return FALSE;
+
+    now = _CP0_GET_COUNT();
+    windowTicks = now - LastVelocityUpdate;
+    if (windowTicks < (ENCODER_VELOCITY_PERIOD_MS * CORE_TICKS_PER_MS))
+	return FALSE;
+    LastVelocityUpdate = now;
+
+    for (i = 0; i < NUM_ENCODERS; i++) {
+	if (!(ActiveEncoders & (1 << i)))
+	    continue;
+
+	E = &(Encoders[i]);
+
+	// Count and edge history from the same instant
+	intState = CN_DisableInterrupts();
+	count = E->count;
+	edgeVel = IntervalVelocity(E, now);
+	E->velocity.timestamp = E->edgeTicks[E->edgeHead];
+	CN_RestoreInterrupts(intState);
+
+	windowCounts = count - E->windowCount;
+	E->windowCount = count;
+	countVel = (int32_t) (((int64_t) windowCounts * CORE_TICKS_PER_SEC) /
+		windowTicks);
+
+	// Few counts per window means the count estimate is mostly quantization
+	if (windowCounts < 0)
+	    windowCounts = -windowCounts;
+
+	if (windowCounts <= ENCODER_BLEND_LOW) {
+	    E->velocity.countsPerSec = edgeVel;
+	} else if (windowCounts >= ENCODER_BLEND_HIGH) {
+	    E->velocity.countsPerSec = countVel;
+	} else {
+	    weight = windowCounts - ENCODER_BLEND_LOW;
+	    E->velocity.countsPerSec = (countVel * weight + edgeVel *
+		    (ENCODER_BLEND_HIGH - ENCODER_BLEND_LOW - weight)) /
+		    (ENCODER_BLEND_HIGH - ENCODER_BLEND_LOW);
+	}
+    }
+
+    return FALSE;
+}
+
+// returns the last velocity published by Encoder_UpdateVelocity
+char Encoder_GetVelocity(int encoder, EncoderVelocity *vel)
+{
+    if (!ModInitialized) {
+	// ERROR not initialized
+	return ERROR;
+    }
+
+    if (encoder >= NUM_ENCODERS || encoder < 0) {
+	// ERROR out of range
+	return ERROR;
+    }
+
+    if ( !(ActiveEncoders & (1 << encoder))) {
+	// ERROR not active yet
+	return ERROR;
+    }
+
+    *vel = Encoders[encoder].velocity;
+
+    return SUCCESS;
+}
+
 // resets the internal count
 char Encoder_ClrCount(int encoder)
 {
@@ -221,7 +440,11 @@ char Encoder_ClrCount(int encoder)
     }
 
     // Reset internal count
+    unsigned char intState = CN_DisableInterrupts();
     Encoders[encoder].count = 0;
+    Encoders[encoder].errors = 0;
+    Encoders[encoder].windowCount = 0;
+    CN_RestoreInterrupts(intState);
 
     return SUCCESS;
 }
@@ -272,14 +495,28 @@ char Encoder_RemovePins(int encoder)
 
     EncoderData *E = &(Encoders[encoder]);
 
+    // Remove handlers
+    CN_DetachInterrupt(EncoderCN[encoder], RISING);
+    CN_DetachInterrupt(EncoderCN[encoder], FALLING);
+    CNToEncoder[EncoderCN[encoder].num] = NO_ENCODER;
+
+    if (E->pair != NO_PAIR) {
+	CN_DetachInterrupt(EncoderCN[E->pair], RISING);
+	CN_DetachInterrupt(EncoderCN[E->pair], FALLING);
+	CNToEncoder[EncoderCN[E->pair].num] = NO_ENCODER;
+	ClaimedPins &= ~(1 << E->pair);
+    }
+
+    ActiveEncoders &= ~(1 << encoder);
+    ClaimedPins &= ~(1 << encoder);
+
     // Clear
     E->target = NO_TARGET;
     E->count = 0;
     E->handler = NULL;
     E->overflow = FALSE;
-
-    // Remove handler
-    CN_DetachInterrupt(EncoderCN[encoder], RISING);
+    E->errors = 0;
+    E->pair = NO_PAIR;
 
     return SUCCESS;
 }
@@ -297,14 +534,19 @@ char Encoder_End(void)
     // Detach all handlers
     for (i = 0; i < NUM_ENCODERS; i++) {
 	CN_DetachInterrupt(EncoderCN[i], RISING);
+	CN_DetachInterrupt(EncoderCN[i], FALLING);
+	CNToEncoder[EncoderCN[i].num] = NO_ENCODER;
 	Encoders[i].count = 0;
 	Encoders[i].target = NO_TARGET;
 	Encoders[i].handler = NULL;
 	Encoders[i].overflow = FALSE;
+	Encoders[i].errors = 0;
+	Encoders[i].pair = NO_PAIR;
     }
 
     // Reset module
     ActiveEncoders = 0x00;
+    ClaimedPins = 0x00;
     ModInitialized = FALSE;
 
     return SUCCESS;
@@ -316,36 +558,104 @@ char Encoder_End(void)
 void EncoderHandler(int cn)
 {
     int i;
+    int delta;
+    unsigned char newState;
     EncoderData *E;
 
-    for (i = 0; i < NUM_ENCODERS; i++) {
-	if (EncoderCN[i].num == cn) {
-	    // i is the encoder that triggered, handle
-	    E = &(Encoders[i]);
-	    
-	    // Check for overflow, increment if not
-	    if (!E->overflow)
-		++E->count;
-
-	    // Check for resulting overflow
-	    if (E->count < 0) {
-		E->overflow = TRUE;
-	    }
-
-	    // Check if target reached, call handler and remove it after
-	    if (E->target == 0) {
-		if (E->handler) {
-		    E->handler();
-		    E->handler = NULL;
-		}
-		
-		E->target = NO_TARGET;
-	    } else if (E->target > 0) {
-		--E->target;
-	    }
-
-	    // Only called with one encoder, break and exit
-	    break;
+    i = CNToEncoder[cn];
+    if (i == NO_ENCODER)
+	return;
+
+    E = &(Encoders[i]);
+
+    if (E->pair == NO_PAIR) {
+	// Single channel, only attached to rising edges
+	delta = 1;
+    } else {
+	newState = (CN_ReadPin(EncoderCN[i]) << 1) | CN_ReadPin(EncoderCN[E->pair]);
+	delta = QuadTable[(E->quadState << 2) | newState];
+	E->quadState = newState;
+
+	if (delta == QUAD_ERR) {
+	    // Missed a state, direction unknown so do not count it
+	    ++E->errors;
+	    return;
+	}
+
+	if (delta == 0)
+	    return;
+    }
+
+    // Time the edge, a change in direction restarts the interval history
+    if (delta != E->edgeDir) {
+	E->edgeDir = delta;
+	E->edgeRun = 0;
+    }
+    if (E->edgeRun < EDGE_HISTORY)
+	++E->edgeRun;
+    E->edgeHead = (E->edgeHead + 1) % EDGE_HISTORY;
+    E->edgeTicks[E->edgeHead] = _CP0_GET_COUNT();
+
+    // Check for overflow, count if not, saturates at the limit
+    if (!E->overflow) {
+	if ((delta > 0 && E->count == INT32_MAX) ||
+		(delta < 0 && E->count == INT32_MIN)) {
+	    E->overflow = TRUE;
+	} else {
+	    E->count += delta;
 	}
     }
+
+    // Check if target reached, call handler and remove it after
+    if (E->target == 0) {
+	if (E->handler) {
+	    E->handler();
+	    E->handler = NULL;
+	}
+
+	E->target = NO_TARGET;
+    } else if (E->target > 0) {
+	--E->target;
+    }
+}
+
+static void ResetVelocity(EncoderData *E)
+{
+    E->edgeHead = 0;
+    E->edgeRun = 0;
+    E->edgeDir = 0;
+    E->edgeTicks[0] = _CP0_GET_COUNT();
+    E->windowCount = 0;
+    E->velocity.countsPerSec = 0;
+    E->velocity.timestamp = E->edgeTicks[0];
+}
+
+/*
+ * Counts per second from the time spanned by the last few edges. Spanning a
+ * full quadrature cycle cancels the uneven spacing between A and B edges.
+ * Call with the CN interrupt masked
+ */
+static int32_t IntervalVelocity(EncoderData *E, uint32_t now)
+{
+    unsigned char edges;
+    uint32_t span;
+    uint32_t sinceEdge;
+    int32_t vel;
+
+    sinceEdge = now - E->edgeTicks[E->edgeHead];
+    if (E->edgeRun < 2 || sinceEdge > (ENCODER_STOP_TIMEOUT_MS * CORE_TICKS_PER_MS))
+	return 0;
+
+    // edgeRun edges give edgeRun - 1 intervals
+    edges = E->edgeRun - 1;
+    span = E->edgeTicks[E->edgeHead] -
+	    E->edgeTicks[(E->edgeHead + EDGE_HISTORY - edges) % EDGE_HISTORY];
+
+    // Slowing down, the edge that has not come yet bounds the speed
+    if (sinceEdge > span / edges)
+	span = sinceEdge * edges;
+
+    vel = (int32_t) ((edges * CORE_TICKS_PER_SEC) / span);
+
+    return (E->edgeDir < 0) ? -vel : vel;
 }
@@ -11,6 +11,7 @@
 #include <peripheral/adc10.h>
 #include <peripheral/ports.h>
 #include <peripheral/power.h>
+#include <peripheral/timer.h>
 #include <BOARD.h>
 #include <serial.h>
 
@@ -38,7 +39,7 @@
 //#define AD_DEBUG_VERBOSE
 #ifdef AD_DEBUG_VERBOSE
 #include "serial.h"
-#define dbprintf(...) while(!IsTransmitEmpty()); printf(__VA_ARGS__)
+#define dbprintf(...) printf(__VA_ARGS__)
 #else
 #define dbprintf(...)
 #endif
@@ -57,6 +58,20 @@
 #define POINTS_PER_SECOND_PER_PIN 9345
 #define FREQUENCY_TO_SAMPLE 1
 
+//triggered scans, Timer3 at PB/8 and the core timer at SYSCLK/2
+#define TRIGGER_TICKS_PER_US 5
+#define CORE_TICKS_PER_SECOND 40000000L
+
+//scans up to this many pins use the buffer as two halves
+#define ALT_BUF_MAX_PINS 8
+
+//pin number of the highest bit in an AD_PORTxxx mask, one clz instruction
+#define PIN_NUMBER(Pin) (31 - __builtin_clz(Pin))
+
+//sequence points of the ValuesSeq and RingScans locks, the value arrays are
+//not volatile so the compiler must not move their loads and stores past these
+#define AD_BARRIER() __asm__ __volatile__("" ::: "memory")
+
 
 
 
@@ -85,6 +100,12 @@ static unsigned int PinsToRemove;
 static unsigned int PinCount;
 static unsigned int ADValues[NUM_AD_PINS];
 static int PortMapping[NUM_AD_PINS];
+static unsigned char ScanToPin[NUM_AD_PINS];
+
+//whole scans by pin number, slot RingScans % AD_RING_SCANS is written next
+static uint16_t SampleRing[AD_RING_SCANS][NUM_AD_PINS];
+static uint32_t SampleTimes[AD_RING_SCANS];
+static volatile uint32_t RingScans = 0;
 
 static char ADActive;
 static char ADNewData = FALSE;
@@ -98,10 +119,30 @@ static uint8_t BatFiltHistoryCurPoint = -1;
 static uint32_t PointsPerBatSamples = 0;
 static uint32_t SampleCount = 0;
 
+static char ADTriggered = FALSE;
+static volatile char ScanPending = FALSE;
+static volatile uint16_t ScanSequence = 0;
+static uint32_t BatCheckTime = 0;
+
+//boxcar decimation per pin, by pin number
+static unsigned char OversampleLog2[NUM_AD_PINS];
+static uint32_t OversampleSum[NUM_AD_PINS];
+static uint16_t OversampleCount[NUM_AD_PINS];
+static uint16_t HiResValues[NUM_AD_PINS];
+//scans per AD_TriggerScan, enough for the highest ratio
+static unsigned char BurstLog2 = 0;
+static volatile uint16_t BurstLeft = 0;
+
+static ADIsrStats IsrStats;
+
+//odd while the interrupt is changing values, see ReadPins
+static volatile uint32_t ValuesSeq = 0;
+
 /*******************************************************************************
  * PRIVATE FUNCTION PROTOTYPES                                                            *
  ******************************************************************************/
 char AD_SetPins(void);
+static char ReadPins(unsigned int Pins, unsigned int *Values, unsigned int *HiRes);
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                           *
@@ -252,13 +293,236 @@ unsigned int AD_ReadADPin(unsigned int Pin)
         dbprintf("%s returning error with unactivated pin: %X %X\r\n", __FUNCTION__, Pin);
         return ERROR;
     }
-    unsigned char TranslatedPin = 0;
-    while (Pin > 1) {
+    return ADValues[PortMapping[PIN_NUMBER(Pin)]];
+}
+
+/**
+ * @Function AD_SetTriggered(char triggered)
+ * @param triggered - TRUE for one scan per AD_TriggerScan, FALSE to free run
+ * @return SUCCESS or ERROR
+ * @brief  Reconfigures the A/D straight away, a scan in progress is dropped
+ * @author rcrobert, 2014.12.13 */
+char AD_SetTriggered(char triggered)
+{
+    if (!ADActive) {
+        dbprintf("%s called before enable\r\n", __FUNCTION__);
+        return ERROR;
+    }
+    INTEnable(INT_T3, INT_DISABLED);
+    T3CON = 0;
+    INTClearFlag(INT_T3);
+    ADTriggered = triggered;
+    ScanPending = FALSE;
+    BatCheckTime = _CP0_GET_COUNT();
+    if (triggered) {
+        INTSetVectorPriority(INT_TIMER_3_VECTOR, 2);
+        INTSetVectorSubPriority(INT_TIMER_3_VECTOR, 3);
+    }
+    AD_SetPins();
+    return SUCCESS;
+}
+
+/**
+ * @Function AD_TriggerScan(unsigned int settleUs)
+ * @param settleUs - delay before sampling starts, up to AD_SETTLE_MAX_US
+ * @return SUCCESS, ERROR if not triggered or a scan is already on its way
+ * @brief  Timer3 runs one shot for the settle time, its interrupt sets ASAM
+ * and the A/D clears it again at the end of the scan (CLRASAM)
+ * @author rcrobert, 2014.12.13 */
+char AD_TriggerScan(unsigned int settleUs)
+{
+    unsigned char CurPin;
+
+    if (!ADActive || !ADTriggered || ScanPending) {
+        return ERROR;
+    }
+    if (settleUs > AD_SETTLE_MAX_US) {
+        dbprintf("%s settle time too long: %u\r\n", __FUNCTION__, settleUs);
+        return ERROR;
+    }
+    //decimations start with the burst so none straddles two triggers
+    for (CurPin = 0; CurPin < NUM_AD_PINS; CurPin++) {
+        OversampleSum[CurPin] = 0;
+        OversampleCount[CurPin] = 0;
+    }
+    BurstLeft = 1 << BurstLog2;
+    ScanPending = TRUE;
+    if (settleUs == 0) {
+        AD1CON1SET = _AD1CON1_ASAM_MASK;
+        return SUCCESS;
+    }
+    T3CON = T3_PS_1_8;
+    TMR3 = 0;
+    PR3 = settleUs * TRIGGER_TICKS_PER_US;
+    INTClearFlag(INT_T3);
+    INTEnable(INT_T3, INT_ENABLED);
+    T3CONSET = _T3CON_ON_MASK;
+    return SUCCESS;
+}
+
+/**
+ * @Function AD_SetOversample(unsigned int Pins, unsigned char Log2Ratio)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Log2Ratio - 0 to AD_OVERSAMPLE_MAX_LOG2, 2 ^ Log2Ratio samples each
+ * @return SUCCESS or ERROR
+ * @brief  Takes effect with the next decimation, a triggered scan runs as many
+ * back to back scans as the highest ratio needs
+ * @author rcrobert, 2014.12.13 */
+char AD_SetOversample(unsigned int Pins, unsigned char Log2Ratio)
+{
+    unsigned char CurPin;
+
+    if ((Pins == 0) || (Pins > ALLADPINS) || (Log2Ratio > AD_OVERSAMPLE_MAX_LOG2)) {
+        dbprintf("%s returning ERROR for %X at %d\r\n", __FUNCTION__, Pins, Log2Ratio);
+        return ERROR;
+    }
+    BurstLog2 = 0;
+    for (CurPin = 0; CurPin < NUM_AD_PINS; CurPin++) {
+        if (Pins & (1 << CurPin)) {
+            OversampleLog2[CurPin] = Log2Ratio;
+        }
+        if (OversampleLog2[CurPin] > BurstLog2) {
+            BurstLog2 = OversampleLog2[CurPin];
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * @Function AD_ReadADPins(unsigned int Pins, unsigned int *Values)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one value per pin, lowest AD_PORTxxx first
+ * @return SUCCESS or ERROR if any of the pins is not active
+ * @brief  All values come from the same scan
+ * @author rcrobert, 2014.12.13 */
+char AD_ReadADPins(unsigned int Pins, unsigned int *Values)
+{
+    return ReadPins(Pins, Values, NULL);
+}
+
+/**
+ * @Function AD_ReadADPinsHiRes(unsigned int Pins, unsigned int *Values)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one AD_ReadADPinHiRes value per pin, lowest AD_PORTxxx first
+ * @return SUCCESS or ERROR if any of the pins is not active
+ * @author rcrobert, 2014.12.13 */
+char AD_ReadADPinsHiRes(unsigned int Pins, unsigned int *Values)
+{
+    return ReadPins(Pins, NULL, Values);
+}
+
+/**
+ * @Function AD_ReadADPinsBoth(unsigned int Pins, unsigned int *Values,
+ *           unsigned int *HiRes)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one 10-bit value per pin, lowest AD_PORTxxx first
+ * @param HiRes - one AD_ReadADPinHiRes value per pin, same order
+ * @return SUCCESS or ERROR if any of the pins is not active
+ * @author rcrobert, 2014.12.16 */
+char AD_ReadADPinsBoth(unsigned int Pins, unsigned int *Values, unsigned int *HiRes)
+{
+    return ReadPins(Pins, Values, HiRes);
+}
 
-        Pin >>= 1;
-        TranslatedPin++;
+/**
+ * @Function AD_ReadADPinHiRes(unsigned int Pin)
+ * @param Pin, used #defined AD_PORTxxx to select pin
+ * @return Mean of the last 2 ^ Log2Ratio samples times AD_HIRES_SCALE, 0 to
+ * 4092, or ERROR
+ * @author rcrobert, 2014.12.13 */
+unsigned int AD_ReadADPinHiRes(unsigned int Pin)
+{
+    if (!ADActive || !(ActivePins & Pin)) {
+        dbprintf("%s returning error with unactivated pin: %X\r\n", __FUNCTION__, Pin);
+        return ERROR;
     }
-    return ADValues[PortMapping[TranslatedPin]];
+    return HiResValues[PIN_NUMBER(Pin)];
+}
+
+/**
+ * @Function AD_GetIsrStats(ADIsrStats *Stats)
+ * @param Stats - filled with the interrupt timing
+ * @return None
+ * @author rcrobert, 2014.12.13 */
+void AD_GetIsrStats(ADIsrStats *Stats)
+{
+    *Stats = IsrStats;
+}
+
+/**
+ * @Function AD_ReadSequence(void)
+ * @param None
+ * @return Count of finished scans, wraps
+ * @author rcrobert, 2014.12.13 */
+uint16_t AD_ReadSequence(void)
+{
+    return ScanSequence;
+}
+
+/**
+ * @Function AD_ReadLatestSamples(unsigned int Pin, uint16_t *Values,
+ *           uint32_t *Times, unsigned int Count)
+ * @param Pin - one AD_PORTxxx
+ * @param Values - gets the samples, oldest first
+ * @param Times - core timer at the end of each sample's scan, can be NULL
+ * @param Count - samples wanted, up to AD_RING_SCANS - 1
+ * @return Samples copied, fewer than Count early on, 0 for an inactive pin
+ * @brief  Copies again if the ISR wrapped onto the samples mid copy, so no
+ * interrupts are masked and nothing comes back torn
+ * @author rcrobert, 2014.12.13 */
+unsigned int AD_ReadLatestSamples(unsigned int Pin, uint16_t *Values, uint32_t *Times, unsigned int Count)
+{
+    uint32_t first;
+    uint32_t last;
+    unsigned int i;
+    unsigned char TranslatedPin;
+
+    if (!ADActive || !(ActivePins & Pin)) {
+        return 0;
+    }
+    TranslatedPin = PIN_NUMBER(Pin);
+    if (Count > AD_RING_SCANS - 1) {
+        Count = AD_RING_SCANS - 1;
+    }
+    do {
+        last = RingScans;
+        AD_BARRIER();
+        if (Count > last) {
+            Count = last;
+        }
+        first = last - Count;
+        for (i = 0; i < Count; i++) {
+            Values[i] = SampleRing[(first + i) % AD_RING_SCANS][TranslatedPin];
+            if (Times) {
+                Times[i] = SampleTimes[(first + i) % AD_RING_SCANS];
+            }
+        }
+        AD_BARRIER();
+    } while ((RingScans - first) > AD_RING_SCANS);
+    return Count;
+}
+
+/**
+ * @Function AD_ReadBatteryFilter(void)
+ * @param None
+ * @return Low passed battery reading in A/D counts
+ * @brief  Same value the undervoltage lockout is judged on, a single word so
+ * it reads whole while the ISR updates it
+ * @author rcrobert, 2014.12.11 */
+unsigned int AD_ReadBatteryFilter(void)
+{
+    return Filt_BatVoltage;
+}
+
+/**
+ * @Function AD_UndervoltageHook(void)
+ * @param None
+ * @return None
+ * @brief  Weak so a project can keep a record before the board sleeps,
+ * BlackBox.c does
+ * @author rcrobert, 2014.12.12 */
+void __attribute__((weak)) AD_UndervoltageHook(void)
+{
 }
 
 /**
@@ -274,6 +538,10 @@ void AD_End(void)
         return;
     }
     INTEnable(INT_AD1, INT_DISABLED);
+    INTEnable(INT_T3, INT_DISABLED);
+    T3CON = 0;
+    ADTriggered = FALSE;
+    ScanPending = FALSE;
     AD1CON1CLR = _AD1CON1_ON_MASK;
     PinsToRemove = ALLADPINS;
     AD_SetPins();
@@ -307,6 +575,8 @@ char AD_SetPins(void)
     unsigned int rempcfg = 0;
     unsigned char CurPin = 0;
     unsigned int CurPinOrder = 0x00;
+    unsigned int config1;
+    unsigned int config2;
     int ADMapping[NUM_AD_PINS_UNO];
     AD1CON1CLR = _AD1CON1_ON_MASK; //disable A/D system and interrupt
     INTEnable(INT_AD1, INT_DISABLED);
@@ -336,13 +606,24 @@ char AD_SetPins(void)
     for (CurPin = 0; CurPin < NUM_AD_PINS_UNO; CurPin++) {//translate AD Mapping to Port Mapping
         if (ADMapping[CurPin] != -1) {
             PortMapping[ADMapping[CurPin]] = CurPinOrder;
+            ScanToPin[CurPinOrder] = ADMapping[CurPin];
             CurPinOrder++;
         }
     }
     cssl = ~cssl;
-    OpenADC10(ADC_MODULE_ON | ADC_FORMAT_INTG | ADC_CLK_AUTO | ADC_AUTO_SAMPLING_ON,
-            ADC_VREF_AVDD_AVSS | ADC_SCAN_ON | ((PinCount - 1) << _AD1CON2_SMPI_POSITION) | ADC_BUF_16,
-            ADC_SAMPLE_TIME_29 | ADC_CONV_CLK_51Tcy2 | ADC_CONV_CLK_PB, pcfg, cssl);
+    //triggered waits for AD_TriggerScan, hardware stops it after one scan
+    config1 = ADC_MODULE_ON | ADC_FORMAT_INTG | ADC_CLK_AUTO |
+            (ADTriggered ? ADC_AUTO_SAMPLING_OFF : ADC_AUTO_SAMPLING_ON);
+    //with two halves the A/D fills one while the interrupt empties the other
+    config2 = ADC_VREF_AVDD_AVSS | ADC_SCAN_ON | ((PinCount - 1) << _AD1CON2_SMPI_POSITION) |
+            ((PinCount <= ALT_BUF_MAX_PINS) ? ADC_ALT_BUF_ON : ADC_BUF_16);
+    ScanPending = FALSE;
+    //added pins have no history yet, start the ring over
+    RingScans = 0;
+    OpenADC10(config1, config2, ADC_SAMPLE_TIME_29 | ADC_CONV_CLK_51Tcy2 | ADC_CONV_CLK_PB, pcfg, cssl);
+    if (ADTriggered) {
+        AD1CON1SET = _AD1CON1_CLRASAM_MASK;
+    }
     AD1PCFGSET = rempcfg;
     //recalculate interval between battery samples
     PointsPerBatSamples = (POINTS_PER_SECOND_PER_PIN / PinCount) / (float) FREQUENCY_TO_SAMPLE;
@@ -352,6 +633,49 @@ char AD_SetPins(void)
     return SUCCESS;
 }
 
+/**
+ * @Function ReadPins(unsigned int Pins, unsigned int *Values, unsigned int *HiRes)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one value per pin, lowest AD_PORTxxx first, or NULL
+ * @param HiRes - the decimated values in the same order, or NULL
+ * @return SUCCESS or ERROR
+ * @brief  Sequence lock against the interrupt. If ValuesSeq moved during the
+ * copy a scan landed in the middle of it and the copy is done again, nothing
+ * is masked. Each pin is a clz and a PortMapping load
+ * @note  Private Function. DO NOT USE.
+ * @author rcrobert, 2014.12.13 */
+static char ReadPins(unsigned int Pins, unsigned int *Values, unsigned int *HiRes)
+{
+    uint32_t Seq;
+    unsigned int Remaining;
+    unsigned int Pin;
+    unsigned int Count;
+
+    if (!ADActive || (Pins == 0) || ((ActivePins & Pins) != Pins)) {
+        dbprintf("%s returning error with unactivated pins: %X\r\n", __FUNCTION__, Pins);
+        return ERROR;
+    }
+    do {
+        Seq = ValuesSeq;
+        AD_BARRIER();
+        Remaining = Pins;
+        Count = 0;
+        while (Remaining) {
+            Pin = PIN_NUMBER(Remaining & -Remaining);
+            if (Values) {
+                Values[Count] = ADValues[PortMapping[Pin]];
+            }
+            if (HiRes) {
+                HiRes[Count] = HiResValues[Pin];
+            }
+            Count++;
+            Remaining &= Remaining - 1;
+        }
+        AD_BARRIER();
+    } while ((Seq & 1) || (Seq != ValuesSeq));
+    return SUCCESS;
+}
+
 /**
  * @Function ADCIntHandler
  * @param None
@@ -361,21 +685,61 @@ char AD_SetPins(void)
  * @author Max Dunne, 2013.08.25 */
 void __ISR(_ADC_VECTOR, ipl1) ADCIntHandler(void)
 {
+    uint32_t StartTime = _CP0_GET_COUNT();
+    uint32_t Ticks;
     unsigned char CurPin = 0;
+    unsigned char Pin;
+    unsigned char BufOffset = 0;
+    unsigned int Value;
+    uint16_t *Slot = SampleRing[RingScans % AD_RING_SCANS];
     INTClearFlag(INT_AD1);
-    for (CurPin = 0; CurPin <= PinCount; CurPin++) {
-        ADValues[CurPin] = ReadADC10(CurPin); //read in new set of values
+    ValuesSeq++;
+    AD_BARRIER();
+    //BUFS set means the A/D is filling the top half, so the bottom is done
+    if ((AD1CON2 & _AD1CON2_BUFM_MASK) && !(AD1CON2 & _AD1CON2_BUFS_MASK)) {
+        BufOffset = 8;
+    }
+    for (CurPin = 0; CurPin < PinCount; CurPin++) {
+        Value = ReadADC10(BufOffset + CurPin); //read in new set of values
+        ADValues[CurPin] = Value;
+        Pin = ScanToPin[CurPin];
+        Slot[Pin] = Value;
+        //boxcar, the sum of 2^n samples scaled to AD_HIRES_SCALE
+        OversampleSum[Pin] += Value;
+        if (++OversampleCount[Pin] >> OversampleLog2[Pin]) {
+            HiResValues[Pin] = (OversampleSum[Pin] * AD_HIRES_SCALE) >> OversampleLog2[Pin];
+            OversampleSum[Pin] = 0;
+            OversampleCount[Pin] = 0;
+        }
+    }
+    SampleTimes[RingScans % AD_RING_SCANS] = _CP0_GET_COUNT();
+    AD_BARRIER();
+    RingScans++;
+    //a triggered scan is done once its burst is
+    if (!ADTriggered) {
+        ScanSequence++;
+    } else if (BurstLeft > 1) {
+        BurstLeft--;
+        AD1CON1SET = _AD1CON1_ASAM_MASK;
+    } else {
+        BurstLeft = 0;
+        ScanSequence++;
+        ScanPending = FALSE;
     }
     //calculate new filtered battery voltage
     Filt_BatVoltage = (Filt_BatVoltage * KEEP_FILT + AD_ReadADPin(BAT_VOLTAGE_MONITOR) * ADD_FILT) >> SHIFT_FILT;
 
     SampleCount++;
-    if (SampleCount > PointsPerBatSamples) {//if sample time has passed
+    //triggered scans come at the caller's rate, so go by time instead
+    if (ADTriggered ? ((_CP0_GET_COUNT() - BatCheckTime) >= CORE_TICKS_PER_SECOND / FREQUENCY_TO_SAMPLE) :
+            (SampleCount > PointsPerBatSamples)) {//if sample time has passed
+        BatCheckTime = _CP0_GET_COUNT();
         PrevFilt_BatVoltage = CurFilt_BatVoltage;
         CurFilt_BatVoltage = Filt_BatVoltage;
         SampleCount = 0;
         //check for battery undervoltage check
         if ((CurFilt_BatVoltage <= BAT_VOLTAGE_LOCKOUT) && (PrevFilt_BatVoltage <= BAT_VOLTAGE_LOCKOUT) && (AD_ReadADPin(BAT_VOLTAGE_MONITOR) > BAT_VOLTAGE_NO_BAT)) {
+            AD_UndervoltageHook();
             BOARD_End();
             while (1) {
                 printf("Battery is undervoltage with reading %d, Going to sleep\r\n", AD_ReadADPin(BAT_VOLTAGE_MONITOR));
@@ -392,7 +756,31 @@ void __ISR(_ADC_VECTOR, ipl1) ADCIntHandler(void)
     if (PinsToAdd | PinsToRemove) {
         AD_SetPins();
     }
+    AD_BARRIER();
+    ValuesSeq++;
     ADNewData = TRUE;
+
+    Ticks = _CP0_GET_COUNT() - StartTime;
+    IsrStats.scans++;
+    IsrStats.lastTicks = Ticks;
+    if (Ticks > IsrStats.maxTicks) {
+        IsrStats.maxTicks = Ticks;
+    }
+}
+
+/**
+ * @Function ADTriggerIntHandler
+ * @param None
+ * @return None
+ * @brief  Timer3 match at the end of the settle time, starts the scan
+ * @note  This function is not to be called by the user
+ * @author rcrobert, 2014.12.13 */
+void __ISR(_TIMER_3_VECTOR, ipl2) ADTriggerIntHandler(void)
+{
+    T3CONCLR = _T3CON_ON_MASK;
+    INTEnable(INT_T3, INT_DISABLED);
+    INTClearFlag(INT_T3);
+    AD1CON1SET = _AD1CON1_ASAM_MASK;
 }
 
 
@@ -0,0 +1,248 @@
+/*
+ * File:   AD.h
+ * Author: mdunne
+ *
+ * Scanned A/D on the Uno32 analog pins plus the battery monitor.
+ *
+ * Free running by default, every active pin is converted over and over. With
+ * AD_SetTriggered each scan is started by AD_TriggerScan instead, after a
+ * settle time timed by Timer3, so a caller switching an external mux knows
+ * exactly which address the values came from. Every finished scan bumps the
+ * sequence number AD_ReadSequence returns.
+ *
+ * Up to 8 pins the result buffer runs as two halves, the interrupt copies
+ * one while the A/D fills the other. Every scan also goes into a ring of the
+ * last AD_RING_SCANS with the core timer at its end, see AD_ReadLatestSamples.
+ *
+ * Any pin can be oversampled by a power of two, a boxcar sums 2^n scans and
+ * AD_ReadADPinHiRes returns the mean on a 12 bit scale. 4x gives 11 real
+ * bits and 16x 12. A triggered scan then runs 2^n scans back to back, about
+ * 107us a pin each, so n is bounded by how long the caller waits for it.
+ *
+ * Local copy of the CMPE118 header, shadows the one in C:\CMPE118\include as
+ * long as ..\ comes first in the include directories.
+ *
+ * Created on November 22, 2011, 8:57 AM
+ */
+
+#ifndef AD_H
+#define	AD_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// Pin bits, OR together for AD_AddPins and AD_RemovePins
+#define AD_PORTV3 (1<<0)
+#define AD_PORTV4 (1<<1)
+#define AD_PORTV5 (1<<2)
+#define AD_PORTV6 (1<<3)
+#define AD_PORTV7 (1<<4)
+#define AD_PORTV8 (1<<5)
+#define AD_PORTW3 (1<<6)
+#define AD_PORTW4 (1<<7)
+#define AD_PORTW5 (1<<8)
+#define AD_PORTW6 (1<<9)
+#define AD_PORTW7 (1<<10)
+#define AD_PORTW8 (1<<11)
+#define BAT_VOLTAGE (1<<12)
+
+// Longest delay AD_TriggerScan can time with Timer3
+#define AD_SETTLE_MAX_US 13000
+
+// Whole scans kept for AD_ReadLatestSamples, a power of two
+#define AD_RING_SCANS 32
+
+// Oversampling, AD_ReadADPinHiRes is always 12 bit whatever the ratio
+#define AD_OVERSAMPLE_MAX_LOG2 6
+#define AD_HIRES_SCALE 4
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+// A/D interrupt time in core timer ticks, 25ns each
+typedef struct {
+    uint32_t scans;
+    uint32_t lastTicks;
+    uint32_t maxTicks;
+} ADIsrStats;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function AD_Init
+ * @param None
+ * @return SUCCESS or ERROR
+ * @brief  Initializes the A/D subsystem and enable battery voltage monitoring.
+ * @author Max Dunne, 2013.08.10 */
+char AD_Init(void);
+
+/**
+ * @Function AD_AddPins(unsigned int AddPins)
+ * @param AddPins - use #defined AD_PORTxxx OR'd together for each A/D Pin you wish to add
+ * @return SUCCESS OR ERROR
+ * @brief  Add pins to the A/D system.  If any pin is already active it returns an
+ * error and does not add any
+ * @author Max Dunne, 2013.08.15 */
+char AD_AddPins(unsigned int AddPins);
+
+/**
+ * @Function AD_RemovePins(unsigned int RemovePins)
+ * @param RemovePins - use #defined AD_PORTxxx OR'd together for each A/D Pin you wish to remove
+ * @return SUCCESS OR ERROR
+ * @brief  Remove pins from the A/D system.  If any pin is not active it returns an
+ * error and does not remove any
+ * @author Max Dunne, 2013.08.15 */
+char AD_RemovePins(unsigned int RemovePins);
+
+/**
+ * @Function AD_ActivePins(void)
+ * @param None
+ * @return Listing of all A/D pins that are active.
+ * @brief  Returns a variable of all active A/D pins. An individual pin can be determined
+ * if active by "anding" with the AD_PORTXX Macros
+ * @author Max Dunne, 2013.08.15 */
+unsigned int AD_ActivePins(void);
+
+/**
+ * @Function AD_IsNewDataReady(void)
+ * @param None
+ * @return TRUE or FALSE
+ * @brief  This function returns a flag indicating that the A/D has new values since the last read of any value
+ * @author Max Dunne, 2013.08.15 */
+char AD_IsNewDataReady(void);
+
+/**
+ * @Function AD_ReadADPin(unsigned int Pin)
+ * @param Pin, used #defined AD_PORTxxx to select pin
+ * @return 10-bit AD Value or ERROR
+ * @brief  Reads current value from buffer for given pin
+ * @author Max Dunne, 2011.12.10 */
+unsigned int AD_ReadADPin(unsigned int Pin);
+
+/**
+ * @Function AD_SetTriggered(char triggered)
+ * @param triggered - TRUE for one scan per AD_TriggerScan, FALSE to free run
+ * @return SUCCESS or ERROR
+ * @brief  Takes Timer3 while triggered. The battery monitor is only read when
+ * someone triggers, the undervoltage check still runs once a second of scans
+ * @author rcrobert, 2014.12.13 */
+char AD_SetTriggered(char triggered);
+
+/**
+ * @Function AD_TriggerScan(unsigned int settleUs)
+ * @param settleUs - delay before sampling starts, up to AD_SETTLE_MAX_US
+ * @return SUCCESS, ERROR if not triggered or a scan is already on its way
+ * @brief  Converts every active pin once, or back to back as many times as
+ * the highest oversampling ratio needs, starting settleUs from now. The
+ * results carry sequence AD_ReadSequence() + 1 as read before this call
+ * @author rcrobert, 2014.12.13 */
+char AD_TriggerScan(unsigned int settleUs);
+
+/**
+ * @Function AD_SetOversample(unsigned int Pins, unsigned char Log2Ratio)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Log2Ratio - 0 to AD_OVERSAMPLE_MAX_LOG2, 2 ^ Log2Ratio samples each
+ * @return SUCCESS or ERROR
+ * @author rcrobert, 2014.12.13 */
+char AD_SetOversample(unsigned int Pins, unsigned char Log2Ratio);
+
+/**
+ * @Function AD_ReadADPinHiRes(unsigned int Pin)
+ * @param Pin, used #defined AD_PORTxxx to select pin
+ * @return Mean of the last 2 ^ Log2Ratio samples times AD_HIRES_SCALE, 0 to
+ * 4092, or ERROR
+ * @brief  Updated once per decimation, AD_ReadADPin still has every sample
+ * @author rcrobert, 2014.12.13 */
+unsigned int AD_ReadADPinHiRes(unsigned int Pin);
+
+/**
+ * @Function AD_GetIsrStats(ADIsrStats *Stats)
+ * @param Stats - filled with the interrupt timing
+ * @return None
+ * @author rcrobert, 2014.12.13 */
+void AD_GetIsrStats(ADIsrStats *Stats);
+
+/**
+ * @Function AD_ReadSequence(void)
+ * @param None
+ * @return Count of finished scans, wraps. The scan AD_ReadADPin returns from.
+ * A triggered scan with oversampling counts once at the end of its burst
+ * @author rcrobert, 2014.12.13 */
+uint16_t AD_ReadSequence(void);
+
+/**
+ * @Function AD_ReadLatestSamples(unsigned int Pin, uint16_t *Values,
+ *           uint32_t *Times, unsigned int Count)
+ * @param Pin - one AD_PORTxxx
+ * @param Values - gets the samples, oldest first
+ * @param Times - core timer at the end of each sample's scan, can be NULL
+ * @param Count - samples wanted, up to AD_RING_SCANS - 1
+ * @return Samples copied, fewer than Count early on, 0 for an inactive pin
+ * @brief  The newest Count samples from whole scans, none are skipped or
+ * torn. The ring starts over whenever pins are added or removed
+ * @author rcrobert, 2014.12.13 */
+unsigned int AD_ReadLatestSamples(unsigned int Pin, uint16_t *Values, uint32_t *Times, unsigned int Count);
+
+/**
+ * @Function AD_ReadADPins(unsigned int Pins, unsigned int *Values)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one 10-bit value per pin, lowest AD_PORTxxx first
+ * @return SUCCESS or ERROR if any of the pins is not active
+ * @brief  All values come from the same scan. Guarded by a sequence count
+ * the interrupt bumps, a read the interrupt lands in is done again, so
+ * interrupts are never masked
+ * @author rcrobert, 2014.12.13 */
+char AD_ReadADPins(unsigned int Pins, unsigned int *Values);
+
+/**
+ * @Function AD_ReadADPinsHiRes(unsigned int Pins, unsigned int *Values)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one AD_ReadADPinHiRes value per pin, lowest AD_PORTxxx first
+ * @return SUCCESS or ERROR if any of the pins is not active
+ * @author rcrobert, 2014.12.13 */
+char AD_ReadADPinsHiRes(unsigned int Pins, unsigned int *Values);
+
+/**
+ * @Function AD_ReadADPinsBoth(unsigned int Pins, unsigned int *Values,
+ *           unsigned int *HiRes)
+ * @param Pins - AD_PORTxxx OR'd together
+ * @param Values - one 10-bit value per pin, lowest AD_PORTxxx first
+ * @param HiRes - one AD_ReadADPinHiRes value per pin, same order
+ * @return SUCCESS or ERROR if any of the pins is not active
+ * @brief  AD_ReadADPins and AD_ReadADPinsHiRes under one sequence lock, so
+ * both come from the same scan
+ * @author rcrobert, 2014.12.16 */
+char AD_ReadADPinsBoth(unsigned int Pins, unsigned int *Values, unsigned int *HiRes);
+
+/**
+ * @Function AD_ReadBatteryFilter(void)
+ * @param None
+ * @return Low passed battery reading in A/D counts, the value the undervoltage
+ * lockout is judged on
+ * @author rcrobert, 2014.12.11 */
+unsigned int AD_ReadBatteryFilter(void);
+
+/**
+ * @Function AD_End(void)
+ * @param None
+ * @return None
+ * @brief  disables the A/D subsystem and release the pins used
+ * @author Max Dunne, 2013.09.20 */
+void AD_End(void);
+
+/**
+ * @Function AD_UndervoltageHook(void)
+ * @param None
+ * @return None
+ * @brief  Called once from the A/D interrupt when the undervoltage lockout
+ * trips, before BOARD_End and sleep. Empty unless another module supplies it
+ * @author rcrobert, 2014.12.12 */
+void AD_UndervoltageHook(void);
+
+#endif	/* AD_H */
@@ -0,0 +1,282 @@
+/*
+ * File:   Battery.c
+ * Author: rcrobert
+ *
+ * Open circuit voltage, charge and run time from the battery monitor and the
+ * motor commands. See Battery.h
+ *
+ * Created on December 13, 2014, 2:10 PM
+ */
+
+#include <BOARD.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "BotConfig.h"
+#include "MotorDriver.h"
+#include "Battery.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES
+ ******************************************************************************/
+
+// Battery monitor samples averaged per step, from the A/D ring
+#define BATTERY_SAMPLES (8)
+
+// Voltage and load statistics average over 2^4 steps, about 1.6s
+#define STAT_SHIFT (4)
+
+// Load variance, duty^2, below which the load is too steady to fit against
+#define FIT_MIN_LOAD_VAR (2500)
+
+// Each fit moves the resistance 1/8 of the way
+#define FIT_SHIFT (3)
+#define RESISTANCE_MAX (3000)
+
+// Open circuit voltage kept in Q3, averaged over 8 steps
+#define OCV_SHIFT (3)
+
+// Drain is judged on the charge lost over windows of this many steps, 30s,
+// averaged over 8 windows so the flat middle of the curve does not swing it
+#define DRAIN_WINDOW (300)
+#define DRAIN_SHIFT (3)
+
+/*******************************************************************************
+ * PRIVATE VARIABLES
+ ******************************************************************************/
+
+// Open circuit mV at 0, 100, ... 1000 per mille charge. 3S LiFePO4 at rest,
+// the 9.9V pack MOTOR_NOMINAL_MV is set for. Retune for another pack
+static const uint16_t BatteryOcvTable[11] = {
+	9000, 9600, 9750, 9840, 9900, 9930, 9960, 9990, 10020, 10050, 10200
+};
+
+// Started by Battery_Init, initialized once the A/D has a battery sample
+static uint8_t isStarted = FALSE;
+static uint8_t isInitialized = FALSE;
+static uint32_t lastUpdate;
+
+// Exponential means in Q(STAT_SHIFT) and the load covariance terms
+static int32_t meanMv;
+static int32_t meanLoad;
+static int32_t covMvLoad;
+static int32_t varLoad;
+
+static int32_t openCircuitQ;
+static unsigned int drainSteps;
+static int windowCharge;
+static int32_t drainQ8;
+
+static BatteryState state;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES
+ ******************************************************************************/
+
+static void Reset(int mv);
+static int ReadMv(void);
+static int ReadLoad(void);
+static void Step(int mv, int load);
+static int ChargeFromOcv(int mv);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+void Battery_Init(void)
+{
+	int mv = ReadMv();
+
+	isStarted = TRUE;
+	isInitialized = FALSE;
+	if (mv > 0) {
+		Reset(mv);
+	}
+	lastUpdate = ES_Timer_GetTime();
+}
+
+uint8_t Battery_Update(void)
+{
+	uint32_t now;
+	int mv;
+
+	if (!isStarted) {
+		return FALSE;
+	}
+
+	now = ES_Timer_GetTime();
+	if ((now - lastUpdate) < BATTERY_PERIOD_MS) {
+		return FALSE;
+	}
+	lastUpdate = now;
+
+	mv = ReadMv();
+	if (mv <= 0) {
+		return FALSE;
+	}
+	if (!isInitialized) {
+		Reset(mv);
+	} else {
+		Step(mv, ReadLoad());
+	}
+	return FALSE;
+}
+
+int Battery_GetOpenCircuitMv(void)
+{
+	return isInitialized ? state.openCircuitMv : 0;
+}
+
+void Battery_GetState(BatteryState *out)
+{
+	*out = state;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+/**
+ * @Function Reset(int mv)
+ * @param mv - first battery reading, taken as open circuit
+ * @return None
+ * @author rcrobert */
+static void Reset(int mv)
+{
+	meanMv = (int32_t) mv << STAT_SHIFT;
+	meanLoad = (int32_t) ReadLoad() << STAT_SHIFT;
+	covMvLoad = 0;
+	varLoad = 0;
+
+	state.measuredMv = mv;
+	state.openCircuitMv = mv;
+	state.resistance = BATTERY_RESISTANCE_DEFAULT;
+	state.charge = ChargeFromOcv(mv);
+	state.runtime = BATTERY_RUNTIME_UNKNOWN;
+	state.fits = 0;
+	openCircuitQ = (int32_t) mv << OCV_SHIFT;
+
+	drainSteps = 0;
+	windowCharge = state.charge;
+	drainQ8 = 0;
+
+	isInitialized = TRUE;
+}
+
+/**
+ * @Function ReadMv(void)
+ * @return Average of the newest battery samples in mV, 0 if there are none
+ * @author rcrobert */
+static int ReadMv(void)
+{
+	uint16_t samples[BATTERY_SAMPLES];
+	unsigned int count;
+	unsigned int i;
+	uint32_t sum = 0;
+
+	count = AD_ReadLatestSamples(BAT_VOLTAGE, samples, NULL, BATTERY_SAMPLES);
+	if (count == 0) {
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		sum += samples[i];
+	}
+	return BATTERY_COUNTS_TO_MV(sum) / (int) count;
+}
+
+/**
+ * @Function ReadLoad(void)
+ * @return Sum of the duties on the two H bridge enables
+ * @author rcrobert */
+static int ReadLoad(void)
+{
+	int left;
+	int right;
+
+	Drive_GetDuty(&left, &right);
+	return left + right;
+}
+
+/**
+ * @Function Step(int mv, int load)
+ * @param mv - measured battery voltage
+ * @param load - motor load it was measured under
+ * @return None
+ * @brief Updates the running covariance of voltage against load, refits the
+ *        resistance when the load has moved enough to tell, then works out
+ *        open circuit voltage, charge and drain
+ * @author rcrobert */
+static void Step(int mv, int load)
+{
+	int32_t dMv;
+	int32_t dLoad;
+	int32_t fit;
+	int ocv;
+	int drop;
+	int32_t runtime;
+
+	// Deviations from the means before this step, the means move by them
+	dMv = mv - (meanMv >> STAT_SHIFT);
+	dLoad = load - (meanLoad >> STAT_SHIFT);
+	meanMv += dMv;
+	meanLoad += dLoad;
+	covMvLoad += (dMv * dLoad - covMvLoad) >> STAT_SHIFT;
+	varLoad += (dLoad * dLoad - varLoad) >> STAT_SHIFT;
+
+	// Voltage falls as load rises, so the fit is minus the slope
+	if (varLoad >= FIT_MIN_LOAD_VAR) {
+		fit = (int32_t) (-(int64_t) covMvLoad * 1000 / varLoad);
+		if (fit < 0) {
+			fit = 0;
+		} else if (fit > RESISTANCE_MAX) {
+			fit = RESISTANCE_MAX;
+		}
+		state.resistance += (fit - (int32_t) state.resistance) >> FIT_SHIFT;
+		state.fits++;
+	}
+
+	ocv = mv + (int32_t) state.resistance * load / 1000;
+	openCircuitQ += ocv - (openCircuitQ >> OCV_SHIFT);
+
+	state.measuredMv = mv;
+	state.openCircuitMv = openCircuitQ >> OCV_SHIFT;
+	state.charge = ChargeFromOcv(state.openCircuitMv);
+
+	// Run time from the charge lost per window, unknown while it is not falling
+	if (++drainSteps < DRAIN_WINDOW) {
+		return;
+	}
+	drop = windowCharge - (int) state.charge;
+	drainQ8 += (((int32_t) drop << 8) - drainQ8) >> DRAIN_SHIFT;
+	windowCharge = state.charge;
+	drainSteps = 0;
+
+	if (drainQ8 <= 0) {
+		state.runtime = BATTERY_RUNTIME_UNKNOWN;
+		return;
+	}
+	runtime = ((int32_t) state.charge * DRAIN_WINDOW * BATTERY_PERIOD_MS / 1000 *
+		256) / drainQ8;
+	state.runtime = (runtime >= BATTERY_RUNTIME_UNKNOWN) ?
+		(BATTERY_RUNTIME_UNKNOWN - 1) : runtime;
+}
+
+/**
+ * @Function ChargeFromOcv(int mv)
+ * @param mv - open circuit voltage
+ * @return Charge in per mille, interpolated in BatteryOcvTable
+ * @author rcrobert */
+static int ChargeFromOcv(int mv)
+{
+	int i;
+
+	if (mv <= BatteryOcvTable[0]) {
+		return 0;
+	}
+	for (i = 1; i < 11; i++) {
+		if (mv < BatteryOcvTable[i]) {
+			return (i - 1) * 100 + (mv - BatteryOcvTable[i - 1]) * 100 /
+				(BatteryOcvTable[i] - BatteryOcvTable[i - 1]);
+		}
+	}
+	return 1000;
+}
@@ -0,0 +1,91 @@
+/*
+ * File:   Battery.h
+ * Author: rcrobert
+ *
+ * Battery model on top of the A/D battery monitor. The pack is treated as an
+ * open circuit voltage behind a series resistance, with the motor duties
+ * standing in for current since nothing measures it:
+ *
+ *   measured = open circuit - resistance * load / 1000
+ *
+ * load is the sum of the duties MotorDriver has on the two H bridge enables,
+ * 0 to 2000. Reflexes and the ratio are already in them.
+ * Resistance is fitted from how the measured voltage moves against the load,
+ * the ratio of their covariance to the load's variance over the last couple
+ * of seconds. It only updates while the load is actually changing, so cruising
+ * or sitting still keeps the last fit. The open circuit voltage gives state of
+ * charge from BatteryOcvTable and its rate of fall gives the run time left.
+ *
+ * Units
+ * voltages     - mV
+ * resistance   - mV of sag at a load of 1000
+ * charge       - per mille
+ * run time     - s, BATTERY_RUNTIME_UNKNOWN until the charge has fallen
+ *
+ * Everything is integer and runs every BATTERY_PERIOD_MS from
+ * EVENT_CHECK_LIST.
+ *
+ * Created on December 13, 2014, 2:10 PM
+ */
+
+#ifndef BATTERY_H
+#define	BATTERY_H
+
+#include <inttypes.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES
+ ******************************************************************************/
+
+#define BATTERY_RUNTIME_UNKNOWN (0xFFFF)
+
+// Battery monitor A/D counts to mV, 33V full scale
+#define BATTERY_COUNTS_TO_MV(counts) ((int) ((counts) * 33000L / 1023))
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS
+ ******************************************************************************/
+
+typedef struct {
+	uint16_t measuredMv;	// average of the latest samples
+	uint16_t openCircuitMv;	// measured plus the sag the load explains
+	uint16_t resistance;	// mV at a load of 1000
+	uint16_t charge;	// per mille
+	uint16_t runtime;	// s left at the recent rate of drain
+	uint16_t fits;		// resistance updates since Battery_Init
+} BatteryState;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES
+ ******************************************************************************/
+
+/**
+ * @Function Battery_Init(void)
+ * @return None
+ * @brief Starts the model from the first battery reading, now or on a later
+ *        Battery_Update if the A/D has none yet. Call after Bot_Init
+ * @author rcrobert */
+void Battery_Init(void);
+
+/**
+ * @Function Battery_Update(void)
+ * @return FALSE, never posts
+ * @brief Runs one model step every BATTERY_PERIOD_MS, call as often as
+ *        wanted. Lives in EVENT_CHECK_LIST
+ * @author rcrobert */
+uint8_t Battery_Update(void);
+
+/**
+ * @Function Battery_GetOpenCircuitMv(void)
+ * @return Load corrected battery voltage in mV, 0 until the first reading
+ * @author rcrobert */
+int Battery_GetOpenCircuitMv(void);
+
+/**
+ * @Function Battery_GetState(BatteryState *state)
+ * @param state - filled with the model as of the last step
+ * @return None
+ * @author rcrobert */
+void Battery_GetState(BatteryState *state);
+
+#endif	/* BATTERY_H */
@@ -0,0 +1,128 @@
+/*
+ * File:   BlackBox.c
+ * Author: rcrobert
+ *
+ * Event and state history saved to flash. See BlackBox.h
+ *
+ * Created on December 12, 2014, 11:40 AM
+ */
+
+#include <xc.h>
+#include <BOARD.h>
+#include <AD.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "Nvm.h"
+#include "BlackBox.h"
+
+/*******************************************************************************
+ * PRIVATE TYPEDEFS                                                            *
+ ******************************************************************************/
+
+typedef struct {
+	uint16_t time;
+	uint16_t param;
+	uint8_t event;
+	uint8_t top;
+	uint8_t sub;
+	uint8_t unused;
+} BlackBoxEntry;
+
+// Saved as it sits in RAM, the header is only filled in on the way out
+typedef struct {
+	uint8_t version;
+	uint8_t reason;
+	uint16_t oldest;
+	uint32_t count;
+	uint32_t time;
+	uint32_t cause;
+	uint32_t epc;
+	BlackBoxEntry entries[BLACKBOX_ENTRIES];
+} BlackBoxImage;
+
+// Saved as one record
+typedef char BlackBoxFits[(sizeof (BlackBoxImage) <= NVM_RECORD_MAX) ? 1 : -1];
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+static BlackBoxImage box;
+
+// Entry the next event goes in, the oldest one once the ring is full
+static uint16_t next = 0;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static char SaveImage(BlackBoxReason_t reason, uint32_t cause, uint32_t epc);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void BlackBox_Init(void)
+{
+	next = 0;
+	box.count = 0;
+}
+
+void BlackBox_Record(ES_Event ThisEvent, uint8_t top, uint8_t sub)
+{
+	BlackBoxEntry *entry = &box.entries[next];
+
+	next = (next + 1) % BLACKBOX_ENTRIES;
+
+	entry->time = ES_Timer_GetTime();
+	entry->param = ThisEvent.EventParam;
+	entry->event = ThisEvent.EventType;
+	entry->top = top;
+	entry->sub = sub;
+	++box.count;
+}
+
+char BlackBox_Save(BlackBoxReason_t reason)
+{
+	return SaveImage(reason, 0, 0);
+}
+
+/**
+ * @Function AD_UndervoltageHook(void)
+ * @brief Replaces the empty one in AD.c, the ADC interrupt calls it once just
+ *        before putting the board to sleep for good
+ * @author rcrobert */
+void AD_UndervoltageHook(void)
+{
+	SaveImage(BLACKBOX_UNDERVOLTAGE, 0, 0);
+}
+
+#ifdef __PIC32MX__
+/**
+ * @Function _general_exception_handler(void)
+ * @brief Replaces the XC32 default, which only spins. Saves the black box
+ *        with the cause and address of the fault, then spins the same way
+ * @author rcrobert */
+void __attribute__((nomips16)) _general_exception_handler(void)
+{
+	SaveImage(BLACKBOX_EXCEPTION, _CP0_GET_CAUSE(), _CP0_GET_EPC());
+	while (1) {
+	}
+}
+#endif
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static char SaveImage(BlackBoxReason_t reason, uint32_t cause, uint32_t epc)
+{
+	box.version = BLACKBOX_VERSION;
+	box.reason = reason;
+	box.oldest = (box.count >= BLACKBOX_ENTRIES) ? next : 0;
+	box.time = ES_Timer_GetTime();
+	box.cause = cause;
+	box.epc = epc;
+
+	return Nvm_WriteNow(NVM_TYPE_BLACKBOX, &box, sizeof (box));
+}
@@ -0,0 +1,89 @@
+/*
+ * File:   BlackBox.h
+ * Author: rcrobert
+ *
+ * The last BLACKBOX_ENTRIES events RunTopHSM saw, with the top and sub state
+ * each one arrived in. Recording is a few stores into RAM. The ring is written
+ * to flash as an NVM_TYPE_BLACKBOX record on an exception, on undervoltage
+ * just before the board goes to sleep, or whenever BlackBox_Save is called.
+ *
+ * Saved record, little endian
+ *  0  u8   BLACKBOX_VERSION
+ *  1  u8   BlackBoxReason_t
+ *  2  u16  index of the oldest entry
+ *  4  u32  events recorded since BlackBox_Init, fewer than 256 leaves unused
+ *          entries at the end
+ *  8  u32  ES_Timer_GetTime when saved
+ * 12  u32  CP0 Cause, exceptions only
+ * 16  u32  CP0 EPC, address of the faulting instruction
+ * 20  BLACKBOX_ENTRIES entries of
+ *      u16 time in ms, low half
+ *      u16 event parameter
+ *      u8  event type
+ *      u8  TopHSM state
+ *      u8  state of the sub HSM that top state runs, 0 for none
+ *      u8  unused
+ *
+ * HostTools/nvm_dump.py prints it from a flash image.
+ *
+ * Created on December 12, 2014, 11:40 AM
+ */
+
+#ifndef BLACKBOX_H
+#define	BLACKBOX_H
+
+#include <stdint.h>
+#include "ES_Configure.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+#define BLACKBOX_VERSION 1
+
+// Ring size, any. The whole ring is saved at 8 bytes an entry and has to fit
+// one NVM record, which caps it near 500
+#define BLACKBOX_ENTRIES 256
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef enum {
+    BLACKBOX_REQUEST,
+    BLACKBOX_UNDERVOLTAGE,
+    BLACKBOX_EXCEPTION,
+} BlackBoxReason_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function BlackBox_Init(void)
+ * @return None
+ * @brief Empties the ring. Nvm_Init has to run first for anything to save
+ * @author rcrobert 2014.12.12
+ */
+void BlackBox_Init(void);
+
+/**
+ * @Function BlackBox_Record(ES_Event ThisEvent, uint8_t top, uint8_t sub)
+ * @param ThisEvent - Event as the HSM received it
+ * @param top - State it arrived in
+ * @param sub - State of the running sub HSM
+ * @return None
+ * @author rcrobert 2014.12.12
+ */
+void BlackBox_Record(ES_Event ThisEvent, uint8_t top, uint8_t sub);
+
+/**
+ * @Function BlackBox_Save(BlackBoxReason_t reason)
+ * @param reason - Kept in the record
+ * @return ERROR if it did not make it to flash
+ * @brief Blocks for a few ms, longer with a page change
+ * @author rcrobert 2014.12.12
+ */
+char BlackBox_Save(BlackBoxReason_t reason);
+
+#endif	/* BLACKBOX_H */
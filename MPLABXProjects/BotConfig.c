@@ -13,7 +13,7 @@ char Bot_Init(void)
     IO_PortsSetPortOutputs(MOTOR_PINS_PORT, MOTOR_PINS_LEFT_DIR |
 			    MOTOR_PINS_RIGHT_DIR | MOTOR_PINS_LIFT_DIR | MOTOR_PINS_LIFT_EN);
     IO_PortsSetPortOutputs(SENSOR_PINS_PORT, SENSOR_PINS_LEDS);
-    IO_PortsSetPortInputs(SENSOR_PINS_PORT, SENSOR_PINS_BUMP | SENSOR_PINS_TRACK);
+    IO_PortsSetPortInputs(SENSOR_PINS_PORT, SENSOR_PINS_BUMP);
 
 	// Init lift motor to off
 	IO_PortsClearPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_EN);
@@ -23,7 +23,10 @@ char Bot_Init(void)
 //    PWM_AddPins(MOTOR_PINS_LEFT_EN | MOTOR_PINS_RIGHT_EN);
 
     // Configure AD pins
-    AD_AddPins(SENSOR_PINS_BEACON | SENSOR_PINS_TAPE);
+    AD_AddPins(SENSOR_PINS_BEACON | SENSOR_PINS_TAPE | SENSOR_PINS_DIST |
+            SENSOR_PINS_TRACK);
+
+    // A/D free runs until InitEventCheckerService switches it to triggered
 
     return SUCCESS;
 }
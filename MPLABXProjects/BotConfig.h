@@ -53,6 +53,8 @@
 #define TIME_APPROACH_DRIVE (3000)
 #define TIME_APPROACH_LIFT (3600)
 #define TIME_APPROACH_BACKUP (800)
+#define TIME_APPROACH_TRACK_POLL (20)   // track strength sampled while sweeping
+#define APPROACH_TRACK_SWEEP (8192)     // binary angle each side, 45deg
 
 // Timers for Return
 #define TIME_RETURN_CROWN_BACKUP (160)
@@ -71,13 +73,33 @@
 
 #define TAPE_FRUSTRATION_TIMER (2000)
 
+// Bump reflexes, run from the sensor scan ahead of the BUMPER event
+#define REFLEX_BUMP_STOP_MASK (BUMP_LEFT | BUMP_CENTER | BUMP_RIGHT)
+#define REFLEX_BUMP_BACKOFF_MASK (0x00)
+#define TIME_REFLEX_HOLD (100)      // long enough for the HSM to handle BUMPER
+#define TIME_REFLEX_BACKOFF (150)
+
+// Core timer runs at SYSCLK/2, used for short timestamps
+#define CORE_TICKS_PER_US (40)
+#define CORE_TICKS_PER_MS (40000)
+
 // Motor settings
-#define MOTOR_RATIO (1.04)   // multiplier for left motor
+#define MOTOR_RATIO_Q10 (1065)   // multiplier for left motor, 1.04
 
 #define MOTOR_SPEED_CRAWL (200)
 #define MOTOR_SPEED_MEDIUM (300)
 #define MOTOR_SPEED_EXPLORE (400)
 #define MOTOR_SPEED_ALIGN (600)
+#define MOTOR_SPEED_REFLEX (-300)   // backoff reflex, both wheels
+#define MOTOR_SPEED_CONTACT (120)   // Ram and Approach once something is near
+
+// Duty is scaled so the motors see this much whatever the battery is at
+#define MOTOR_NOMINAL_MV (9900)
+#define DRIVE_REFRESH_MS (100)      // redone this often while the command holds
+
+// Battery model
+#define BATTERY_PERIOD_MS (100)
+#define BATTERY_RESISTANCE_DEFAULT (200)    // mV of sag at a load of 1000
 
 // PWM configs
 #define PWM_BOT_FREQUENCY (3000)
@@ -102,11 +124,18 @@
 #define BEACON_BACK 0x04
 #define BEACON_LEFT 0x01
 
+#define DIST_FRONT_LEFT 0x01
+#define DIST_FRONT_RIGHT 0x02
+
 // Sensor thresholds
 #define THRESHOLD_BEACON_HIGH 200
 #define THRESHOLD_BEACON_LOW 150
 #define THRESHOLD_TAPE_HIGH 250
 #define THRESHOLD_TAPE_LOW 200
+#define THRESHOLD_DIST_NEAR 150     // mm, closer posts DISTANCE near
+#define THRESHOLD_DIST_FAR 200      // mm, further posts DISTANCE clear
+#define THRESHOLD_TRACK_HIGH 150    // envelope counts, above posts TRACK_FOUND
+#define THRESHOLD_TRACK_LOW 100     // envelope counts, below posts TRACK_LOST
 
 // Sensor configs
 #define SENSORS_POLLING_DELAY (3)    // minimum delay in ms to settle
@@ -114,22 +143,48 @@
 #define NUM_LIGHT_SENSORS (4)
 #define NUM_TAPE_SENSORS (8)
 #define NUM_BUMP_SENSORS (7)
+#define NUM_DIST_SENSORS (2)
 
 #define MAX_MUX_SEL (0x08)
 
 // Mux pins
-#define MUX_PINS_PORT PORTZ         // any port works, all IO is digital here
+#define MUX_PINS_PORT PORTZ         // all 3 lines have to share a PIC32 port
 #define MUX_PINS_BIT0 PIN11
 #define MUX_PINS_BIT1 PIN9
 #define MUX_PINS_BIT2 PIN7
 #define MUX_PINS_OR (MUX_PINS_BIT0 | MUX_PINS_BIT1 | MUX_PINS_BIT2)
 
+// Select to A/D sampling, covers the sensor output filters
+#define MUX_SETTLE_US (500)
+
+// Tape oversampling, log2. 8x is ~4.3ms of A/D per mux step with 5 pins
+#define SENSOR_TAPE_OVERSAMPLE (3)
+
+// Scan the mux in Gray code, one select line moves per step. 0 counts up
+#define MUX_SCAN_GRAY 1
+
+// Drop sensor events the active state has not asked for, 0 posts them all
+#define EVENT_FILTER (1)
+
+// Sensor health, see SensorHealth.h
+#define HEALTH_STUCK_MS (5000)      // active and unchanging this long is stuck
+#define HEALTH_FAULT_MS (2000)      // saturated or dead this long is flagged
+#define HEALTH_DEAD_CONTRAST (20)   // tape LED on minus off never above is dead
+#define HEALTH_MASK (1)             // flagged channels post nothing, 0 reports only
+
+// Mux selects each sensor group is on, a scan profile only visits these
+#define SCAN_SELECTS_BUMP (BUMP_LEFT | BUMP_RIGHT | BUMP_CENTER | BUMP_LIMIT)
+#define SCAN_SELECTS_BEACON ((1 << NUM_LIGHT_SENSORS) - 1)
+#define SCAN_SELECTS_TAPE ((1 << NUM_TAPE_SENSORS) - 1)
+#define SCAN_SELECTS_DIST ((1 << NUM_DIST_SENSORS) - 1)
+
 // Sensor pins
 #define SENSOR_PINS_PORT        PORTW       // Port with analog, V also works
 #define SENSOR_PINS_BUMP        PIN5        // digital
 #define SENSOR_PINS_BEACON      AD_PORTW4   // analog
 #define SENSOR_PINS_TAPE        AD_PORTW3   // analog
-#define SENSOR_PINS_TRACK	PIN8        // digital
+#define SENSOR_PINS_DIST        AD_PORTW6   // analog, Sharp GP2Y0A21
+#define SENSOR_PINS_TRACK       AD_PORTW8   // analog, track wire amplifier
 #define SENSOR_PINS_LEDS        PIN7        // digital out
 
 // Motor pins
@@ -141,6 +196,36 @@
 #define MOTOR_PINS_LIFT_EN      PIN4            // digital
 #define MOTOR_PINS_LIFT_DIR     PIN6            // digital
 
+// Odometry pins, encoder defines are in MotorEncoder.h
+#define ODOM_ENCODER_LEFT_A     ENCODER_PORTX3
+#define ODOM_ENCODER_LEFT_B     ENCODER_PORTX4
+#define ODOM_ENCODER_RIGHT_A    ENCODER_PORTX12  // swapped so forward counts up
+#define ODOM_ENCODER_RIGHT_B    ENCODER_PORTX11
+#define ODOM_MOUSE_CLK          CN_4             // V3
+#define ODOM_MOUSE_DATA         PIN4             // V4, on SM_PORT
+
+// Odometry geometry, mouse sits on the axle centerline facing forward
+#define ODOM_PERIOD_MS (20)
+#define ODOM_UM_PER_COUNT (393)         // 60mm wheel, 480 quadrature counts
+#define ODOM_MOUSE_UM_PER_COUNT (250)   // SM_RESOLUTION of 4 per mm
+#define ODOM_WHEEL_BASE_UM (198000)
+#define ODOM_MOUSE_WEIGHT (128)         // Q8 share of the mouse in travel
+
+// Odometry noise, per mm of wheel travel
+#define ODOM_NOISE_ENCODER (13)         // mm^2 Q8, about 0.05
+#define ODOM_NOISE_MOUSE (3)            // mm^2 Q8, about 0.01
+#define ODOM_NOISE_HEADING (64)         // mrad^2 Q8
+
+// Slip and stall, judged over ODOM_SLIP_WINDOW updates
+#define ODOM_SLIP_WINDOW (5)
+#define ODOM_SLIP_MIN_UM (5000)         // encoder travel before slip is judged
+#define ODOM_SLIP_PERCENT (40)          // mouse under this % of encoders
+#define ODOM_STALL_COMMAND (150)        // average command that should move
+#define ODOM_STALL_MAX_UM (1000)        // travel under this is not moving
+
+// Telemetry frame rate, 0 starts with it off
+#define TELEMETRY_PERIOD_MS (50)
+
 char Bot_Init(void);
 
 #endif	/* BOTCONFIG_H */
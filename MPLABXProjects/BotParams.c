@@ -0,0 +1,293 @@
+/*
+ * File:   BotParams.c
+ * Author: rcrobert
+ *
+ * Runtime tuning table, serial console and flash copy. See BotParams.h
+ *
+ * Created on December 11, 2014, 4:05 PM
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <BOARD.h>
+#include <serial.h>
+#include "ES_Configure.h"
+#include "Crc16.h"
+#include "Flash.h"
+#include "BotParams.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+#define PARAMS_MAGIC 0x42505231     // "BPR1"
+
+#define CONSOLE_LINE 32
+
+// Longest reply, nothing is printed until this much fits in the UART buffer
+#define REPLY_MAX 80
+
+/*******************************************************************************
+ * PRIVATE TYPEDEFS                                                            *
+ ******************************************************************************/
+
+typedef struct {
+	const char *name;
+	int32_t min;
+	int32_t max;
+	int32_t def;
+} BotParamInfo;
+
+// What goes in flash, a whole number of words
+typedef struct {
+	uint32_t magic;
+	uint16_t layout;
+	uint16_t count;
+	int32_t values[NUM_BOT_PARAMS];
+	uint16_t crc;
+	uint16_t unused;
+} ParamImage;
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+#define BOT_PARAM_DEFAULT(name, min, max) name,
+#define BOT_PARAM_INFO(name, min, max) {#name, min, max, name},
+
+int32_t botParams[NUM_BOT_PARAMS] = {
+	BOT_PARAM_LIST(BOT_PARAM_DEFAULT)
+};
+
+static const BotParamInfo paramInfo[NUM_BOT_PARAMS] = {
+	BOT_PARAM_LIST(BOT_PARAM_INFO)
+};
+
+static FLASH_RESERVE(paramStore, 1);
+
+static char line[CONSOLE_LINE];
+static uint8_t lineLength = 0;
+
+// Next entry a list command still has to print
+static uint8_t listNext = NUM_BOT_PARAMS;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static uint16_t LayoutCheck(void);
+static void BuildImage(ParamImage *image);
+static void RunCommand(char *command);
+static void PrintParam(int id);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+char BotParams_Init(void)
+{
+	lineLength = 0;
+	listNext = NUM_BOT_PARAMS;
+	return BotParams_Load();
+}
+
+char BotParams_Set(BotParamId_t id, int32_t value)
+{
+	if (id >= NUM_BOT_PARAMS || value < paramInfo[id].min ||
+		value > paramInfo[id].max) {
+		return ERROR;
+	}
+
+	botParams[id] = value;
+	return SUCCESS;
+}
+
+int BotParams_Find(const char *name)
+{
+	char *end;
+	long id;
+	int i;
+
+	id = strtol(name, &end, 10);
+	if (end != name && *end == '\0') {
+		return (id >= 0 && id < NUM_BOT_PARAMS) ? (int) id : -1;
+	}
+
+	for (i = 0; i < NUM_BOT_PARAMS; i++) {
+		if (strcmp(name, paramInfo[i].name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+char BotParams_Save(void)
+{
+	ParamImage image;
+	ParamImage saved;
+
+	BuildImage(&image);
+	Flash_Read(&saved, paramStore, sizeof (saved));
+	if (memcmp(&image, &saved, sizeof (image)) == 0) {
+		return SUCCESS;
+	}
+
+	if (Flash_ErasePage(paramStore) == ERROR) {
+		return ERROR;
+	}
+	return Flash_Write(paramStore, &image, sizeof (image));
+}
+
+char BotParams_Load(void)
+{
+	ParamImage image;
+	int i;
+
+	Flash_Read(&image, paramStore, sizeof (image));
+
+	if (image.magic != PARAMS_MAGIC || image.layout != LayoutCheck() ||
+		image.count != NUM_BOT_PARAMS ||
+		image.crc != Crc16(CRC16_INIT, &image, offsetof(ParamImage, crc))) {
+		return ERROR;
+	}
+
+	// Ranges may have tightened since it was saved
+	for (i = 0; i < NUM_BOT_PARAMS; i++) {
+		if (image.values[i] < paramInfo[i].min ||
+			image.values[i] > paramInfo[i].max) {
+			return ERROR;
+		}
+	}
+
+	memcpy(botParams, image.values, sizeof (botParams));
+	return SUCCESS;
+}
+
+void BotParams_Defaults(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_BOT_PARAMS; i++) {
+		botParams[i] = paramInfo[i].def;
+	}
+}
+
+uint8_t BotParams_Update(void)
+{
+#ifndef USE_KEYBOARD_INPUT
+	char ch;
+
+	// A listing goes out a few lines per pass as the UART drains
+	if (listNext < NUM_BOT_PARAMS) {
+		while (listNext < NUM_BOT_PARAMS &&
+			SERIAL_TransmitSpace() >= REPLY_MAX) {
+			PrintParam(listNext++);
+		}
+		return FALSE;
+	}
+
+	// Leave input waiting until the reply to it can be sent whole
+	while (!IsReceiveEmpty() && SERIAL_TransmitSpace() >= REPLY_MAX) {
+		ch = GetChar();
+		if (ch == '\r' || ch == '\n' || ch == ';') {
+			line[lineLength] = '\0';
+			lineLength = 0;
+			if (line[0] != '\0') {
+				RunCommand(line);
+				break;
+			}
+		} else if (lineLength < (CONSOLE_LINE - 1)) {
+			line[lineLength++] = ch;
+		}
+	}
+#endif
+	return FALSE;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+/**
+ * @Function LayoutCheck(void)
+ * @return CRC of the version and every name in table order
+ * @author rcrobert */
+static uint16_t LayoutCheck(void)
+{
+	uint16_t crc;
+	uint16_t version = BOT_PARAMS_VERSION;
+	int i;
+
+	crc = Crc16(CRC16_INIT, &version, sizeof (version));
+	for (i = 0; i < NUM_BOT_PARAMS; i++) {
+		crc = Crc16(crc, paramInfo[i].name, strlen(paramInfo[i].name) + 1);
+	}
+	return crc;
+}
+
+static void BuildImage(ParamImage *image)
+{
+	memset(image, 0, sizeof (*image));
+	image->magic = PARAMS_MAGIC;
+	image->layout = LayoutCheck();
+	image->count = NUM_BOT_PARAMS;
+	memcpy(image->values, botParams, sizeof (botParams));
+	image->crc = Crc16(CRC16_INIT, image, offsetof(ParamImage, crc));
+}
+
+static void RunCommand(char *command)
+{
+	char *name;
+	char *value;
+	char *end;
+	long newValue;
+	int id;
+
+	command = strtok(command, " =");
+	name = strtok(NULL, " =");
+	value = strtok(NULL, " =");
+
+	if (command == NULL) {
+		return;
+	} else if (strcmp(command, "list") == 0) {
+		listNext = 0;
+	} else if (strcmp(command, "save") == 0) {
+		printf((BotParams_Save() == SUCCESS) ? "Saved\r\n" :
+			"Flash write failed\r\n");
+	} else if (strcmp(command, "load") == 0) {
+		printf((BotParams_Load() == SUCCESS) ? "Loaded\r\n" :
+			"No valid saved parameters\r\n");
+	} else if (strcmp(command, "defaults") == 0) {
+		BotParams_Defaults();
+		printf("Defaults restored\r\n");
+	} else if ((strcmp(command, "get") == 0 || strcmp(command, "set") == 0) &&
+		name != NULL) {
+		id = BotParams_Find(name);
+		if (id < 0) {
+			printf("No parameter %s\r\n", name);
+			return;
+		}
+
+		if (command[0] == 's') {
+			newValue = (value != NULL) ? strtol(value, &end, 0) : 0;
+			if (value == NULL || *end != '\0' ||
+				BotParams_Set(id, newValue) == ERROR) {
+				printf("%s takes %ld to %ld\r\n", paramInfo[id].name,
+					(long) paramInfo[id].min, (long) paramInfo[id].max);
+				return;
+			}
+		}
+		PrintParam(id);
+	} else {
+		printf("list, get <param>, set <param> <value>, save, load, defaults\r\n");
+	}
+}
+
+static void PrintParam(int id)
+{
+	printf("%2d %-24s %6ld  [%ld, %ld] default %ld\r\n", id, paramInfo[id].name,
+		(long) botParams[id], (long) paramInfo[id].min,
+		(long) paramInfo[id].max, (long) paramInfo[id].def);
+}
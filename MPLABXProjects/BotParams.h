@@ -0,0 +1,176 @@
+/*
+ * File:   BotParams.h
+ * Author: rcrobert
+ *
+ * Tuning parameters that can change without a rebuild. The defaults are the
+ * #defines of the same name in BotConfig.h and the table starts out holding
+ * them, so BotParam() is valid before BotParams_Init and in projects that
+ * never call it. Code reads the RAM copy with BotParam(TIME_RAM_WAIT), a
+ * single load.
+ *
+ * The serial console runs from BotParams_Update in EVENT_CHECK_LIST, a
+ * command ends with enter or ';'
+ *   list                   every parameter with its id and range
+ *   get <id|name>
+ *   set <id|name> <value>  takes effect the next time the value is read
+ *   save                   writes the table to flash, stalls ~20ms
+ *   load                   back to what is in flash
+ *   defaults               back to BotConfig.h
+ *
+ * The saved copy carries a CRC and a layout check made from
+ * BOT_PARAMS_VERSION and the names in the table. Adding, removing or
+ * reordering parameters throws an old copy away instead of loading values
+ * into the wrong slots.
+ *
+ * Created on December 11, 2014, 4:05 PM
+ */
+
+#ifndef BOTPARAMS_H
+#define	BOTPARAMS_H
+
+#include <stdint.h>
+#include "BotConfig.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// Bump when a parameter changes meaning without changing its name
+#define BOT_PARAMS_VERSION 1
+
+// name, min, max
+#define BOT_PARAM_LIST(PARAM) \
+    PARAM(MOTOR_TURN_CR_45, 0, 10000) \
+    PARAM(MOTOR_TURN_CR_90, 0, 10000) \
+    PARAM(MOTOR_TURN_EX_45, 0, 10000) \
+    PARAM(MOTOR_TURN_EX_90, 0, 10000) \
+    PARAM(MOTOR_TURN_EX_180, 0, 10000) \
+    PARAM(STALL_TIME_IN_MS, 0, 10000) \
+    PARAM(TIME_EXIT_OUTSIDE, 0, 30000) \
+    PARAM(TIME_EXIT_BACKUP, 0, 30000) \
+    PARAM(TIME_EXIT_STRAIGHTEN, 0, 30000) \
+    PARAM(TIME_EXIT_ALIGN, 0, 30000) \
+    PARAM(TIME_EXIT_FRUSTRATION, 0, 30000) \
+    PARAM(TIME_SEARCH_PRE_LEAVE, 0, 30000) \
+    PARAM(TIME_SEARCH_OBSTACLE, 0, 30000) \
+    PARAM(TIME_SEARCH_TOCENTER, 0, 30000) \
+    PARAM(TIME_SEARCH_HALL, 0, 30000) \
+    PARAM(TIME_SEARCH_BACKUP, 0, 30000) \
+    PARAM(TIME_SEARCH_ENTER, 0, 30000) \
+    PARAM(TIME_APPROACH_DRIVE, 0, 30000) \
+    PARAM(TIME_APPROACH_LIFT, 0, 30000) \
+    PARAM(TIME_APPROACH_BACKUP, 0, 30000) \
+    PARAM(TIME_RETURN_CROWN_BACKUP, 0, 30000) \
+    PARAM(TIME_RETURN_RECOVERY, 0, 30000) \
+    PARAM(TIME_RETURN_MINIBACK, 0, 30000) \
+    PARAM(TIME_RAM_WAIT, 0, 30000) \
+    PARAM(TIME_RAM_STRAIGHTEN, 0, 30000) \
+    PARAM(TIME_RAM_ALIGN, 0, 30000) \
+    PARAM(TIME_RAM_TAPE, 0, 30000) \
+    PARAM(TIME_RAM_EVADE, 0, 30000) \
+    PARAM(TIME_RAM_BACKUP, 0, 30000) \
+    PARAM(FRUSTRATION_TIMEOUT, 0, 30000) \
+    PARAM(TAPE_FRUSTRATION_TIMER, 0, 30000) \
+    PARAM(TIME_REFLEX_HOLD, 0, 5000) \
+    PARAM(TIME_REFLEX_BACKOFF, 0, 5000) \
+    PARAM(MOTOR_RATIO_Q10, 512, 2048) \
+    PARAM(MOTOR_SPEED_CRAWL, 0, 1000) \
+    PARAM(MOTOR_SPEED_MEDIUM, 0, 1000) \
+    PARAM(MOTOR_SPEED_EXPLORE, 0, 1000) \
+    PARAM(MOTOR_SPEED_ALIGN, 0, 1000) \
+    PARAM(MOTOR_SPEED_REFLEX, -1000, 1000) \
+    PARAM(MOTOR_SPEED_CONTACT, 0, 1000) \
+    PARAM(THRESHOLD_BEACON_HIGH, 0, 1023) \
+    PARAM(THRESHOLD_BEACON_LOW, 0, 1023) \
+    PARAM(THRESHOLD_TAPE_HIGH, -1023, 1023) \
+    PARAM(THRESHOLD_TAPE_LOW, -1023, 1023) \
+    PARAM(THRESHOLD_DIST_NEAR, 0, 1000) \
+    PARAM(THRESHOLD_DIST_FAR, 0, 1000) \
+    PARAM(THRESHOLD_TRACK_HIGH, 0, 1023) \
+    PARAM(THRESHOLD_TRACK_LOW, 0, 1023) \
+    PARAM(EVENT_FILTER, 0, 1) \
+    PARAM(HEALTH_STUCK_MS, 0, 30000) \
+    PARAM(HEALTH_FAULT_MS, 0, 30000) \
+    PARAM(HEALTH_DEAD_CONTRAST, 0, 1023) \
+    PARAM(HEALTH_MASK, 0, 1)
+
+// Current value, e.g. ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, BotParam(TIME_RAM_WAIT))
+#define BotParam(name) (botParams[PARAM_##name])
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+#define BOT_PARAM_ENUM(name, min, max) PARAM_##name,
+typedef enum {
+    BOT_PARAM_LIST(BOT_PARAM_ENUM)
+    NUM_BOT_PARAMS
+} BotParamId_t;
+
+/*******************************************************************************
+ * PUBLIC VARIABLES                                                            *
+ ******************************************************************************/
+
+// Read through BotParam(), write through BotParams_Set
+extern int32_t botParams[NUM_BOT_PARAMS];
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function BotParams_Init(void)
+ * @return SUCCESS if the saved copy was loaded, ERROR if there was no valid
+ * one and the defaults are in use
+ * @author rcrobert 2014.12.11
+ */
+char BotParams_Init(void);
+
+/**
+ * @Function BotParams_Set(BotParamId_t id, int32_t value)
+ * @return ERROR if the id or value is out of range, nothing changes then
+ * @author rcrobert 2014.12.11
+ */
+char BotParams_Set(BotParamId_t id, int32_t value);
+
+/**
+ * @Function BotParams_Find(const char *name)
+ * @param name - Parameter name as in BOT_PARAM_LIST or its id as a number
+ * @return The id, -1 if there is no such parameter
+ * @author rcrobert 2014.12.11
+ */
+int BotParams_Find(const char *name);
+
+/**
+ * @Function BotParams_Save(void)
+ * @return ERROR if flash did not program
+ * @brief Skips the write when flash already holds the same values
+ * @author rcrobert 2014.12.11
+ */
+char BotParams_Save(void);
+
+/**
+ * @Function BotParams_Load(void)
+ * @return ERROR if there is no valid saved copy, the table is unchanged then
+ * @author rcrobert 2014.12.11
+ */
+char BotParams_Load(void);
+
+/**
+ * @Function BotParams_Defaults(void)
+ * @return None
+ * @brief Back to the BotConfig.h values, flash is not touched
+ * @author rcrobert 2014.12.11
+ */
+void BotParams_Defaults(void);
+
+/**
+ * @Function BotParams_Update(void)
+ * @return FALSE, never posts
+ * @brief Serial console, lives in EVENT_CHECK_LIST. Does nothing when
+ *        USE_KEYBOARD_INPUT owns the receive side
+ * @author rcrobert 2014.12.11
+ */
+uint8_t BotParams_Update(void);
+
+#endif	/* BOTPARAMS_H */
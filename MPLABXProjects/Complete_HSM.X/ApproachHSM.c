@@ -31,7 +31,9 @@
 #include "ES_Framework.h"
 #include "BOARD.h"
 #include "BotConfig.h"
+#include "BotParams.h"
 #include "MotorDriver.h"
+#include "Odometry.h"
 #include "ApproachHSM.h"
 #include "RamSubHSM.h"
 
@@ -45,6 +47,7 @@
         STATE(Approach_Drive)           \
         STATE(Approach_Check_Right)     \
         STATE(Approach_Check_Left)      \
+        STATE(Approach_Home_Track)      \
         STATE(Approach_Lifting)         \
         STATE(Approach_Turn180)         \
         STATE(Approach_Align)           \
@@ -69,6 +72,10 @@ static const char *StateNames[] = {
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
 
+static int ApproachSpeed(void);
+static uint16_t StartSweep(void);
+static char SweepTrack(int16_t stopAt, char turningLeft);
+
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
  ******************************************************************************/
@@ -78,6 +85,30 @@ static const char *StateNames[] = {
 static ApproachState_t CurrentState = Approach_Init; // <- change name to match ENUM
 static uint8_t MyPriority;
 
+// Driving in ends on the bumpers and slows on the distance sensors, the
+// track wire sweeps read the track every step anyway and take no sensor events
+static const ScanProfile driveScan = {
+	SCAN_GROUP_BUMP | SCAN_GROUP_DIST, SCAN_GROUP_BEACON | SCAN_GROUP_TAPE, 4,
+	EVENT_BIT(BUMPER) | EVENT_BIT(DISTANCE)
+};
+static const ScanProfile sweepScan = {
+	SCAN_GROUP_BUMP, SCAN_GROUP_ALL & ~SCAN_GROUP_BUMP, 4, 0
+};
+// Lowering the arm stops on the limit bumper
+static const ScanProfile limitScan = {
+	SCAN_GROUP_BUMP, SCAN_GROUP_ALL & ~SCAN_GROUP_BUMP, 4, EVENT_BIT(BUMPER)
+};
+// Turns and backups run on timers, sensors only keep the snapshot current
+static const ScanProfile timedScan = {
+	SCAN_GROUP_ALL, 0, 0, 0
+};
+
+// Track wire sweep, headings are Odometry binary angles
+static uint16_t sweepCenter;
+static uint16_t sweepPeakTheta;
+static uint16_t sweepPeak;
+static uint32_t sweepStartTime;
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -105,6 +136,18 @@ uint8_t InitApproachHSM(void)
 	return FALSE;
 }
 
+/**
+ * @Function QueryApproachHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since ApproachState_t is private to ApproachHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryApproachHSM(void)
+{
+	return (CurrentState);
+}
+
 /**
  * @Function RunApproachHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -155,19 +198,23 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 	case Approach_Backup:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_Straight(-BotParam(MOTOR_SPEED_CRAWL));
 
-			ES_Timer_InitTimer(APPROACH_HSM_TIMER, TIME_APPROACH_BACKUP);
+			ES_Timer_InitTimer(APPROACH_HSM_TIMER, BotParam(TIME_APPROACH_BACKUP));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -186,11 +233,15 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 		if (ThisEvent.EventType != ES_NO_EVENT) {
 			switch (ThisEvent.EventType) {
 			case ES_ENTRY:
+				EventChecker_SetScanProfile(&limitScan);
+
 				// Start lift motor
 				Drive_LiftDown();
 				break;
 
 			case ES_EXIT:
+				EventChecker_SetScanProfile(NULL);
+
 				// Stop lift motor
 				Drive_LiftStop();
 				break;
@@ -213,21 +264,34 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 	case Approach_Drive:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&driveScan);
+
 			// Drive
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			Drive_Straight(ApproachSpeed());
 
-			ES_Timer_InitTimer(APPROACH_HSM_TIMER, TIME_APPROACH_DRIVE);
+			ES_Timer_InitTimer(APPROACH_HSM_TIMER, BotParam(TIME_APPROACH_DRIVE));
+			break;
+
+		case DISTANCE:
+			// Slow down before the throne instead of hitting it at crawl
+			Drive_Straight(ApproachSpeed());
+
+			// Consume
+			ThisEvent.EventType = ES_NO_EVENT;
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
-				// Took to long, back off and retry
-				// Implement this later
+				// Took to long, find the strongest track wire heading
+				nextState = Approach_Check_Right;
+				makeTransition = TRUE;
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
@@ -253,17 +317,120 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 		}
 		break;
 
+	case Approach_Check_Right:
+		switch (ThisEvent.EventType) {
+		case ES_ENTRY:
+			EventChecker_SetScanProfile(&sweepScan);
+
+			// Sweep starts where the drive was pointing
+			sweepCenter = StartSweep();
+			sweepPeakTheta = sweepCenter;
+			sweepPeak = EventChecker_GetTrackStrength();
+
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
+			break;
+
+		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
+			Drive_Stop();
+			break;
+
+		case ES_TIMEOUT:
+			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
+				if (SweepTrack(-APPROACH_TRACK_SWEEP, FALSE)) {
+					nextState = Approach_Check_Left;
+					makeTransition = TRUE;
+				}
+
+				ThisEvent.EventType = ES_NO_EVENT;
+			}
+			break;
+
+		default:
+			break;
+		}
+		break;
+
+	case Approach_Check_Left:
+		switch (ThisEvent.EventType) {
+		case ES_ENTRY:
+			EventChecker_SetScanProfile(&sweepScan);
+
+			StartSweep();
+			Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
+			break;
+
+		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
+			Drive_Stop();
+			break;
+
+		case ES_TIMEOUT:
+			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
+				if (SweepTrack(APPROACH_TRACK_SWEEP, TRUE)) {
+					nextState = Approach_Home_Track;
+					makeTransition = TRUE;
+				}
+
+				ThisEvent.EventType = ES_NO_EVENT;
+			}
+			break;
+
+		default:
+			break;
+		}
+		break;
+
+	case Approach_Home_Track:
+		switch (ThisEvent.EventType) {
+		case ES_ENTRY:
+			EventChecker_SetScanProfile(&sweepScan);
+
+			// Back right to the strongest heading seen, then drive again
+			sweepCenter = sweepPeakTheta;
+			StartSweep();
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
+			break;
+
+		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
+			Drive_Stop();
+			break;
+
+		case ES_TIMEOUT:
+			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
+				if (SweepTrack(0, FALSE)) {
+					nextState = Approach_Drive;
+					makeTransition = TRUE;
+				}
+
+				ThisEvent.EventType = ES_NO_EVENT;
+			}
+			break;
+
+		default:
+			break;
+		}
+		break;
+
 	case Approach_Lifting:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Start lift motor raising
 			Drive_LiftUp();
 
 			// Set timer
-			ES_Timer_InitTimer(APPROACH_HSM_TIMER, TIME_APPROACH_LIFT);
+			ES_Timer_InitTimer(APPROACH_HSM_TIMER, BotParam(TIME_APPROACH_LIFT));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop lift motor
 			Drive_LiftStop();
 			break;
@@ -287,13 +454,17 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 	case Approach_Turn180:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin turning 180 CW
-			Drive_TankLeft(MOTOR_SPEED_EXPLORE);
+			Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(APPROACH_HSM_TIMER, MOTOR_TURN_EX_180);
+			ES_Timer_InitTimer(APPROACH_HSM_TIMER, BotParam(MOTOR_TURN_EX_180));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			break;
 
@@ -301,7 +472,7 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
 				Drive_Stop();
 
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -346,13 +517,17 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 	case Approach_Face_Out:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Turn 90deg CCW
-			Drive_TankLeft(MOTOR_SPEED_EXPLORE);
+			Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(APPROACH_HSM_TIMER, MOTOR_TURN_EX_90);
+			ES_Timer_InitTimer(APPROACH_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 			break;
@@ -361,7 +536,7 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
 			if (ThisEvent.EventParam == APPROACH_HSM_TIMER) {
 				Drive_Stop();
 
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
 				nextState = Approach_Done_State;
 				makeTransition = TRUE;
@@ -413,6 +588,67 @@ ES_Event RunApproachHSM(ES_Event ThisEvent)
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+/**
+ * @Function StartSweep(void)
+ * @return Current heading
+ * @brief Starts the poll timer and the time limit of a sweep state
+ * @author rcrobert */
+static uint16_t StartSweep(void)
+{
+	OdomPose pose;
+
+	Odometry_GetPose(&pose, NULL);
+	sweepStartTime = ES_Timer_GetTime();
+	ES_Timer_InitTimer(APPROACH_HSM_TIMER, TIME_APPROACH_TRACK_POLL);
+	return pose.theta;
+}
+
+/**
+ * @Function SweepTrack(int16_t stopAt, char turningLeft)
+ * @param stopAt - heading relative to sweepCenter the turn ends at, counter
+ *                 clockwise positive
+ * @param turningLeft - TRUE if the state turns counter clockwise
+ * @return TRUE once the heading is past stopAt, or twice the time of a 90deg
+ *         turn has gone by so a stalled turn still moves on
+ * @brief Keeps the heading with the strongest track wire while sweeping,
+ *        polls again if not done
+ * @author rcrobert */
+static char SweepTrack(int16_t stopAt, char turningLeft)
+{
+	OdomPose pose;
+	uint16_t strength = EventChecker_GetTrackStrength();
+	int16_t turned;
+
+	Odometry_GetPose(&pose, NULL);
+	if ((CurrentState != Approach_Home_Track) && (strength > sweepPeak)) {
+		sweepPeak = strength;
+		sweepPeakTheta = pose.theta;
+	}
+
+	turned = (int16_t) (pose.theta - sweepCenter);
+	if ((turningLeft ? (turned >= stopAt) : (turned <= stopAt)) ||
+		((ES_Timer_GetTime() - sweepStartTime) > 2 * BotParam(MOTOR_TURN_EX_90))) {
+		return TRUE;
+	}
+
+	ES_Timer_InitTimer(APPROACH_HSM_TIMER, TIME_APPROACH_TRACK_POLL);
+	return FALSE;
+}
+
+/**
+ * @Function ApproachSpeed(void)
+ * @return MOTOR_SPEED_CONTACT while a distance sensor reads near, otherwise
+ *         MOTOR_SPEED_CRAWL
+ * @author rcrobert */
+static int ApproachSpeed(void)
+{
+	SensorSnapshot sensors;
+
+	EventChecker_GetSnapshot(&sensors);
+	return sensors.near ? BotParam(MOTOR_SPEED_CONTACT) :
+		BotParam(MOTOR_SPEED_CRAWL);
+}
+
 
 /*******************************************************************************
  * TEST HARNESS                                                                *
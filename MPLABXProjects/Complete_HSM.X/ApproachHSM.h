@@ -53,6 +53,15 @@
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t InitApproachHSM(void);
 
+/**
+ * @Function QueryApproachHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since ApproachState_t is private to ApproachHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryApproachHSM(void);
+
 /**
  * @Function RunApproachHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -31,6 +31,7 @@
 #include "ES_Framework.h"
 #include "BOARD.h"
 #include "BotConfig.h"
+#include "BotParams.h"
 #include "MotorDriver.h"
 #include "ExitHSM.h"
 
@@ -76,6 +77,21 @@ static const char *StateNames[] = {
 static ExitState_t CurrentState = Exit_Init; // <- change name to match ENUM
 static uint8_t MyPriority;
 
+// Driving out only stops on the bumpers, the rest is kept roughly current
+static const ScanProfile bumpScan = {
+	SCAN_GROUP_BUMP, SCAN_GROUP_ALL & ~SCAN_GROUP_BUMP, 4,
+	EVENT_BIT(BUMPER) | EVENT_BIT(TRACK_FOUND)
+};
+// Straightening pushes into the wall, the stop reflex would fight it
+static const ScanProfile straightenScan = {
+	SCAN_GROUP_BUMP, SCAN_GROUP_ALL & ~SCAN_GROUP_BUMP, 4,
+	EVENT_BIT(BUMPER) | EVENT_BIT(TRACK_FOUND), REFLEX_BUMP_STOP_MASK
+};
+// Turns and backups run on timers, sensors only keep the snapshot current
+static const ScanProfile timedScan = {
+	SCAN_GROUP_ALL, 0, 0, 0
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -103,6 +119,18 @@ uint8_t InitExitHSM(void)
 	return FALSE;
 }
 
+/**
+ * @Function QueryExitHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since ExitState_t is private to ExitHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryExitHSM(void)
+{
+	return (CurrentState);
+}
+
 /**
  * @Function RunExitHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -152,14 +180,18 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Drive:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&bumpScan);
+
 			// Drive forward
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 
 			// Start timer for checking when we have driven far enough to have left the castle
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, TIME_EXIT_OUTSIDE);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(TIME_EXIT_OUTSIDE));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop the timer while we handle turns etc, it will restart on entry
 			ES_Timer_StopTimer(EXIT_HSM_TIMER);
 
@@ -220,8 +252,10 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Straighten:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&straightenScan);
+
 			// Drive straight to recheck bumps
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 
 			++bounceCount;
 
@@ -231,10 +265,12 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 			}
 
 			// Set the timeout
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, TIME_EXIT_STRAIGHTEN);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(TIME_EXIT_STRAIGHTEN));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 
 			// Stop timer on exit
@@ -291,13 +327,17 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Align_Left:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Turn into the wall to align
-			Drive_Right(-MOTOR_SPEED_MEDIUM);
+			Drive_Right(-BotParam(MOTOR_SPEED_MEDIUM));
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, TIME_EXIT_ALIGN);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(TIME_EXIT_ALIGN));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 
@@ -321,13 +361,17 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Align_Right:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Turn into the wall to align
-			Drive_Left(-MOTOR_SPEED_MEDIUM);
+			Drive_Left(-BotParam(MOTOR_SPEED_MEDIUM));
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, TIME_EXIT_ALIGN);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(TIME_EXIT_ALIGN));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 
@@ -351,12 +395,16 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Backup:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_Straight(-BotParam(MOTOR_SPEED_CRAWL));
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, TIME_EXIT_BACKUP);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(TIME_EXIT_BACKUP));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 
 			ES_Timer_StopTimer(EXIT_HSM_TIMER);
@@ -380,12 +428,16 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Turn90:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, MOTOR_TURN_EX_90);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 
 			ES_Timer_StopTimer(EXIT_HSM_TIMER);
@@ -408,15 +460,19 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 	case Exit_Turn180:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Set 180 turn flag true, don't do this state twice
 			turnedFlag = TRUE;
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, MOTOR_TURN_EX_180);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(MOTOR_TURN_EX_180));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 
 			ES_Timer_StopTimer(EXIT_HSM_TIMER);
@@ -440,9 +496,9 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
 			// Reverse
-			Drive_Straight(-MOTOR_SPEED_MEDIUM);
+			Drive_Straight(-BotParam(MOTOR_SPEED_MEDIUM));
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, TIME_EXIT_BACKUP);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(TIME_EXIT_BACKUP));
 			break;
 
 		case ES_EXIT:
@@ -452,7 +508,7 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 			if (ThisEvent.EventParam == EXIT_HSM_TIMER) {
 				Drive_Stop();
 
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -472,9 +528,9 @@ ES_Event RunExitHSM(ES_Event ThisEvent)
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
 			// Turn 180
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(EXIT_HSM_TIMER, MOTOR_TURN_EX_180);
+			ES_Timer_InitTimer(EXIT_HSM_TIMER, BotParam(MOTOR_TURN_EX_180));
 			break;
 
 		case ES_EXIT:
@@ -53,6 +53,15 @@
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t InitExitHSM(void);
 
+/**
+ * @Function QueryExitHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since ExitState_t is private to ExitHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryExitHSM(void);
+
 /**
  * @Function RunExitHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
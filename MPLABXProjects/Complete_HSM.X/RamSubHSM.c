@@ -31,7 +31,9 @@
 #include "ES_Framework.h"
 #include "BOARD.h"
 #include "BotConfig.h"
+#include "BotParams.h"
 #include "MotorDriver.h"
+#include "Odometry.h"
 #include "SearchHSM.h"
 #include "RamSubHSM.h"
 
@@ -67,6 +69,8 @@ static const char *StateNames[] = {
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
 
+static int RamSpeed(void);
+
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
  ******************************************************************************/
@@ -76,6 +80,19 @@ static const char *StateNames[] = {
 static RamState_t CurrentState = Ram_Init; // <- change name to match ENUM
 static uint8_t MyPriority;
 
+// Ramming takes the tape as the edge of the room, straightening also on a bump
+static const ScanProfile driveScan = {
+	SCAN_GROUP_ALL, 0, 0, EVENT_BIT(BUMPER) | EVENT_BIT(DISTANCE) | EVENT_BIT(TAPE)
+};
+// Straightening pushes into the wall, the stop reflex would fight it
+static const ScanProfile straightenScan = {
+	SCAN_GROUP_ALL, 0, 0, EVENT_BIT(BUMPER) | EVENT_BIT(TAPE),
+	REFLEX_BUMP_STOP_MASK
+};
+// Turns and backups run on timers, sensors only keep the snapshot current
+static const ScanProfile timedScan = {
+	SCAN_GROUP_ALL, 0, 0, 0
+};
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -103,6 +120,18 @@ uint8_t InitRamSubHSM(void)
 	return FALSE;
 }
 
+/**
+ * @Function QueryRamSubHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since RamState_t is private to RamSubHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryRamSubHSM(void)
+{
+	return (CurrentState);
+}
+
 /**
  * @Function RunRamSubHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -148,11 +177,21 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 	case Ram_Drive:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&driveScan);
+
 			// Start driving
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			Drive_Straight(RamSpeed());
+			break;
+
+		case DISTANCE:
+			// Slow down for the contact, back up to speed if it moved away
+			Drive_Straight(RamSpeed());
+
+			ThisEvent.EventType = ES_NO_EVENT;
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
 			break;
 
 		case BUMPER:
@@ -207,7 +246,9 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 	case Ram_Straighten:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&straightenScan);
+
+			Drive_Straight(RamSpeed());
 
 			// Keep track of iterations to avoid locking in a loop
 			if (bounceCount == 8) {
@@ -219,10 +260,12 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 				++bounceCount;
 			}
 
-			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, TIME_RAM_STRAIGHTEN);
+			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, BotParam(TIME_RAM_STRAIGHTEN));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop timer on exit
 			ES_Timer_StopTimer(RAM_SUB_HSM_TIMER);
 			break;
@@ -260,6 +303,19 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 			}
 			break;
 
+		case WHEEL_SLIP:
+			args.val = ThisEvent.EventParam;
+
+			// Square against the wall once the wheels stop gaining ground
+			if (args.bits.type & (ODOM_FLAG_SLIP | ODOM_FLAG_STALL)) {
+				nextState = Ram_Done;
+				makeTransition = TRUE;
+
+				// Finished early
+				ThisEvent.EventType = CHILD_DONE;
+			}
+			break;
+
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RAM_SUB_HSM_TIMER) {
 				nextState = Ram_Done;
@@ -278,12 +334,16 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 	case Ram_Align_Left:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Right(-MOTOR_SPEED_MEDIUM);
+			EventChecker_SetScanProfile(&timedScan);
 
-			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, TIME_RAM_ALIGN);
+			Drive_Right(-BotParam(MOTOR_SPEED_MEDIUM));
+
+			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, BotParam(TIME_RAM_ALIGN));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 
@@ -307,12 +367,16 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 	case Ram_Align_Right:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Left(-MOTOR_SPEED_MEDIUM);
+			EventChecker_SetScanProfile(&timedScan);
 
-			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, TIME_RAM_ALIGN);
+			Drive_Left(-BotParam(MOTOR_SPEED_MEDIUM));
+
+			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, BotParam(TIME_RAM_ALIGN));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 
@@ -337,19 +401,22 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
 	case Ram_Backup:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_MEDIUM);
+			EventChecker_SetScanProfile(&timedScan);
 
-			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, TIME_RAM_BACKUP);
+			Drive_Straight(-BotParam(MOTOR_SPEED_MEDIUM));
+
+			ES_Timer_InitTimer(RAM_SUB_HSM_TIMER, BotParam(TIME_RAM_BACKUP));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RAM_SUB_HSM_TIMER) {
 				Drive_Stop();
 
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
 				nextState = Ram_Done;
 				makeTransition = TRUE;
@@ -400,6 +467,20 @@ ES_Event RunRamSubHSM(ES_Event ThisEvent)
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+/**
+ * @Function RamSpeed(void)
+ * @return MOTOR_SPEED_CONTACT while a distance sensor reads near, otherwise
+ *         MOTOR_SPEED_CRAWL
+ * @author rcrobert */
+static int RamSpeed(void)
+{
+	SensorSnapshot sensors;
+
+	EventChecker_GetSnapshot(&sensors);
+	return sensors.near ? BotParam(MOTOR_SPEED_CONTACT) :
+		BotParam(MOTOR_SPEED_CRAWL);
+}
+
 
 /*******************************************************************************
  * TEST HARNESS                                                                *
@@ -53,6 +53,15 @@
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t InitRamSubHSM(void);
 
+/**
+ * @Function QueryRamSubHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since RamState_t is private to RamSubHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryRamSubHSM(void);
+
 /**
  * @Function RunRamSubHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -31,6 +31,7 @@
 #include "ES_Framework.h"
 #include "BOARD.h"
 #include "BotConfig.h"
+#include "BotParams.h"
 #include "MotorDriver.h"
 #include "ReturnHSM.h"
 #include "SearchHSM.h"
@@ -89,6 +90,23 @@ static const char *StateNames[] = {
 static ReturnState_t CurrentState = Return_Init; // <- change name to match ENUM
 static uint8_t MyPriority;
 
+// Entering the castle and placing the crown only end on the bumpers
+static const ScanProfile bumpScan = {
+	SCAN_GROUP_BUMP, SCAN_GROUP_ALL & ~SCAN_GROUP_BUMP, 4,
+	EVENT_BIT(BUMPER)
+};
+// Wall following and the run to the hall stop on a bump or the next tape line
+static const ScanProfile roomScan = {
+	SCAN_GROUP_ALL, 0, 0, EVENT_BIT(BUMPER) | EVENT_BIT(TAPE)
+};
+static const ScanProfile tapeScan = {
+	SCAN_GROUP_ALL, 0, 0, EVENT_BIT(TAPE)
+};
+// Turns and backups run on timers, sensors only keep the snapshot current
+static const ScanProfile timedScan = {
+	SCAN_GROUP_ALL, 0, 0, 0
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -116,6 +134,18 @@ uint8_t InitReturnHSM(void)
 	return FALSE;
 }
 
+/**
+ * @Function QueryReturnHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since ReturnState_t is private to ReturnHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryReturnHSM(void)
+{
+	return (CurrentState);
+}
+
 /**
  * @Function RunReturnHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -170,17 +200,21 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Leave_Room:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&roomScan);
+
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			ES_Timer_StopTimer(EVADE_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == EVADE_TIMER) {
-				Drive_Straight(MOTOR_SPEED_CRAWL);
+				Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			}
 			break;
 
@@ -197,16 +231,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankRight(MOTOR_SPEED_CRAWL);
+				Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankLeft(MOTOR_SPEED_CRAWL);
+				Drive_TankLeft(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
@@ -263,19 +297,23 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Backup:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_Straight(-BotParam(MOTOR_SPEED_CRAWL));
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_SEARCH_BACKUP);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_SEARCH_BACKUP));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -293,11 +331,15 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Obstacle:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Allow 'caller' to set the initial behavior
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_SEARCH_OBSTACLE);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			break;
 
@@ -320,13 +362,17 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Turn_First_Wall:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin turning CW
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, MOTOR_TURN_EX_90);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 
 			ES_Timer_StopTimer(RETURN_HSM_TIMER);
@@ -377,14 +423,18 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Face_Center:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin tank turning CCW
-			Drive_TankLeft(MOTOR_SPEED_EXPLORE);
+			Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Init timer for 90deg turn
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, MOTOR_TURN_EX_180);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(MOTOR_TURN_EX_180));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop motors
 			Drive_Stop();
 			break;
@@ -392,7 +442,7 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -411,21 +461,25 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Goto_Center:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&tapeScan);
+
 			// Begin driving straight
-			Drive_Straight(MOTOR_SPEED_MEDIUM);
+			Drive_Straight(BotParam(MOTOR_SPEED_MEDIUM));
 
 			// Init timer to get to center, timeRemaining is set in the previous state
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_SEARCH_TOCENTER);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_SEARCH_TOCENTER));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			ES_Timer_StopTimer(RETURN_HSM_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -440,13 +494,13 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 			args.val = ThisEvent.EventParam;
 
 			if (args.bits.type & TAPE_FAR_RIGHT) {
-				Drive_Left(MOTOR_SPEED_MEDIUM);
+				Drive_Left(BotParam(MOTOR_SPEED_MEDIUM));
 
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 			} else if (args.bits.type & TAPE_FAR_LEFT) {
-				Drive_Right(MOTOR_SPEED_MEDIUM);
+				Drive_Right(BotParam(MOTOR_SPEED_MEDIUM));
 
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 			}
 			break;
 
@@ -458,21 +512,25 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Face_Hall:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Decide here which castle to return to
 			if (SearchCount == 0) {
-				Drive_TankRight(MOTOR_SPEED_EXPLORE);
+				Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
-				ES_Timer_InitTimer(RETURN_HSM_TIMER, MOTOR_TURN_EX_90 + 35);
+				ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(MOTOR_TURN_EX_90) + 35);
 			} else if (SearchCount == 1) {
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 			} else if (SearchCount == 2) {
-				Drive_TankLeft(MOTOR_SPEED_EXPLORE);
+				Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
 
-				ES_Timer_InitTimer(RETURN_HSM_TIMER, MOTOR_TURN_EX_90);
+				ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			}
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop motors
 			Drive_Stop();
 			break;
@@ -480,7 +538,7 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -499,17 +557,21 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Goto_Hall:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&roomScan);
+
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			ES_Timer_StopTimer(EVADE_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == EVADE_TIMER) {
-				Drive_Straight(MOTOR_SPEED_CRAWL);
+				Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			}
 			break;
 
@@ -526,16 +588,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankRight(MOTOR_SPEED_CRAWL);
+				Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankLeft(MOTOR_SPEED_CRAWL);
+				Drive_TankLeft(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
@@ -547,13 +609,13 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 
 
 			if (args.bits.event & args.bits.type & TAPE_FAR_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_Right(MOTOR_SPEED_MEDIUM);
+				Drive_Right(BotParam(MOTOR_SPEED_MEDIUM));
 			} else if (args.bits.event & args.bits.type & TAPE_FAR_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_Left(MOTOR_SPEED_MEDIUM);
+				Drive_Left(BotParam(MOTOR_SPEED_MEDIUM));
 			}
 			break;
 
@@ -593,14 +655,18 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Face_Door:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin tank turning CW
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Init timer for 90deg turn
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, MOTOR_TURN_EX_90 + 35);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(MOTOR_TURN_EX_90) + 35);
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 			break;
@@ -608,7 +674,7 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -627,16 +693,20 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Enter_Castle:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&bumpScan);
+
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			ES_Timer_StopTimer(EVADE_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == EVADE_TIMER) {
-				Drive_Straight(MOTOR_SPEED_CRAWL);
+				Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			}
 			break;
 
@@ -653,16 +723,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankRight(MOTOR_SPEED_CRAWL);
+				Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankLeft(MOTOR_SPEED_CRAWL);
+				Drive_TankLeft(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
@@ -706,12 +776,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Backup_Throne:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_Straight(-BotParam(MOTOR_SPEED_CRAWL));
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_RETURN_CROWN_BACKUP);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_RETURN_CROWN_BACKUP));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			break;
 
@@ -719,7 +793,7 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
 
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
 				nextState = Return_Face_Throne;
 				makeTransition = TRUE;
@@ -734,12 +808,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Face_Throne:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			EventChecker_SetScanProfile(&timedScan);
+
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, MOTOR_TURN_EX_90 + 25);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(MOTOR_TURN_EX_90) + 25);
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			break;
 
@@ -747,7 +825,7 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 			if (ThisEvent.EventParam == RETURN_HSM_TIMER) {
 				Drive_Stop();
 
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
 				nextState = Return_Goto_Throne;
 				makeTransition = TRUE;
@@ -791,12 +869,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Place_Crown:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&bumpScan);
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_RETURN_MINIBACK);
+			Drive_Straight(-BotParam(MOTOR_SPEED_CRAWL));
+
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_RETURN_MINIBACK));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			ES_Timer_StopTimer(RETURN_HSM_TIMER);
 			break;
 
@@ -827,11 +909,15 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Wiggly:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			ES_Timer_InitTimer(STALL_TIMER, 250);
 			ES_Timer_InitTimer(RETURN_HSM_TIMER, 3000);
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			ES_Timer_StopTimer(STALL_TIMER);
 			break;
@@ -846,9 +932,9 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventType == STALL_TIMER) {
 				if (wiggleDir) {
-					Drive_TankRight(MOTOR_SPEED_CRAWL);
+					Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 				} else {
-					Drive_TankLeft(MOTOR_SPEED_CRAWL);
+					Drive_TankLeft(BotParam(MOTOR_SPEED_CRAWL));
 				}
 
 				wiggleDir = (wiggleDir) ? 0 : 1;
@@ -868,12 +954,16 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 	case Return_Recovery:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&timedScan);
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_RETURN_RECOVERY);
+			Drive_Straight(-BotParam(MOTOR_SPEED_CRAWL));
+
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_RETURN_RECOVERY));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			break;
 
@@ -896,7 +986,7 @@ ES_Event RunReturnHSM(ES_Event ThisEvent)
 		case ES_ENTRY:
 			Drive_LiftUp();
 
-			ES_Timer_InitTimer(RETURN_HSM_TIMER, TIME_APPROACH_LIFT);
+			ES_Timer_InitTimer(RETURN_HSM_TIMER, BotParam(TIME_APPROACH_LIFT));
 			break;
 
 		case ES_EXIT:
@@ -53,6 +53,15 @@
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t InitReturnHSM(void);
 
+/**
+ * @Function QueryReturnHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since ReturnState_t is private to ReturnHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QueryReturnHSM(void);
+
 /**
  * @Function RunReturnHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
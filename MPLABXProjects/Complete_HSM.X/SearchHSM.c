@@ -31,6 +31,7 @@
 #include "ES_Framework.h"
 #include "BOARD.h"
 #include "BotConfig.h"
+#include "BotParams.h"
 #include "MotorDriver.h"
 #include "SearchHSM.h"
 #include "RamSubHSM.h"
@@ -89,6 +90,23 @@ int SearchCount = 0;
 static SearchState_t CurrentState = Search_Init; // <- change name to match ENUM
 static uint8_t MyPriority;
 
+// Turning for the beacon, half the selects so the beacons come twice as often
+static const ScanProfile beaconScan = {
+	SCAN_GROUP_BEACON, SCAN_GROUP_ALL & ~SCAN_GROUP_BEACON, 4,
+	EVENT_BIT(BEACON_FOUND)
+};
+// Wall following and the run to the hall stop on a bump or the next tape line
+static const ScanProfile roomScan = {
+	SCAN_GROUP_ALL, 0, 0, EVENT_BIT(BUMPER) | EVENT_BIT(TAPE)
+};
+static const ScanProfile tapeScan = {
+	SCAN_GROUP_ALL, 0, 0, EVENT_BIT(TAPE)
+};
+// Turns and backups run on timers, sensors only keep the snapshot current
+static const ScanProfile timedScan = {
+	SCAN_GROUP_ALL, 0, 0, 0
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -116,6 +134,18 @@ uint8_t InitSearchHSM(void)
 	return FALSE;
 }
 
+/**
+ * @Function QuerySearchHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since SearchState_t is private to SearchHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QuerySearchHSM(void)
+{
+	return (CurrentState);
+}
+
 /**
  * @Function RunSearchHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -169,17 +199,21 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Leave_Room:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&roomScan);
+
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			ES_Timer_StopTimer(EVADE_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == EVADE_TIMER) {
-				Drive_Straight(MOTOR_SPEED_CRAWL);
+				Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			}
 			break;
 
@@ -196,16 +230,16 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankRight(MOTOR_SPEED_CRAWL);
+				Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankLeft(MOTOR_SPEED_CRAWL);
+				Drive_TankLeft(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
@@ -262,19 +296,23 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Backup:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(-MOTOR_SPEED_MEDIUM);
+			EventChecker_SetScanProfile(&timedScan);
 
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, TIME_SEARCH_BACKUP);
+			Drive_Straight(-BotParam(MOTOR_SPEED_MEDIUM));
+
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(TIME_SEARCH_BACKUP));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -292,15 +330,19 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Obstacle:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Allow 'caller' to set the initial behavior
-			ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
-			timeRemaining = timeRemaining - TIME_SEARCH_OBSTACLE;
+			ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
+			timeRemaining = timeRemaining - BotParam(TIME_SEARCH_OBSTACLE);
 
 			// Keep it positive
 			timeRemaining = (timeRemaining < 0) ? 0 : timeRemaining;
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 			break;
 
@@ -323,13 +365,17 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Turn_First_Wall:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin turning CW
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, MOTOR_TURN_EX_90);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			Drive_Stop();
 
 			ES_Timer_StopTimer(SEARCH_HSM_TIMER);
@@ -380,14 +426,18 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Face_Center:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin tank turning CCW
-			Drive_TankLeft(MOTOR_SPEED_EXPLORE);
+			Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Init timer for 90deg turn
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, MOTOR_TURN_EX_180);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(MOTOR_TURN_EX_180));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop motors
 			Drive_Stop();
 			break;
@@ -395,7 +445,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -414,21 +464,25 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Goto_Center:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&tapeScan);
+
 			// Begin driving straight
-			Drive_Straight(MOTOR_SPEED_MEDIUM);
+			Drive_Straight(BotParam(MOTOR_SPEED_MEDIUM));
 
 			// Init timer to get to center, timeRemaining is set in the previous state
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, TIME_SEARCH_TOCENTER);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(TIME_SEARCH_TOCENTER));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			ES_Timer_StopTimer(SEARCH_HSM_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -443,13 +497,13 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 			args.val = ThisEvent.EventParam;
 
 			if (args.bits.type & TAPE_FAR_RIGHT) {
-				Drive_Left(MOTOR_SPEED_MEDIUM);
+				Drive_Left(BotParam(MOTOR_SPEED_MEDIUM));
 
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 			} else if (args.bits.type & TAPE_FAR_LEFT) {
-				Drive_Right(MOTOR_SPEED_MEDIUM);
+				Drive_Right(BotParam(MOTOR_SPEED_MEDIUM));
 
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 			}
 			break;
 
@@ -461,14 +515,18 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Face_Hall:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin tank turning CCW
-			Drive_TankLeft(MOTOR_SPEED_EXPLORE);
+			Drive_TankLeft(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Init timer for 90deg turn
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, MOTOR_TURN_EX_90);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop motors
 			Drive_Stop();
 			break;
@@ -476,7 +534,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -484,7 +542,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 				makeTransition = TRUE;
 
 				// Update remaining time on transition
-				timeRemaining = TIME_SEARCH_HALL;
+				timeRemaining = BotParam(TIME_SEARCH_HALL);
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			}
@@ -498,17 +556,21 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Goto_Hall:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
-			Drive_Straight(MOTOR_SPEED_CRAWL);
+			EventChecker_SetScanProfile(&roomScan);
+
+			Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Do nothing
 			ES_Timer_StopTimer(EVADE_TIMER);
 			break;
 
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == EVADE_TIMER) {
-				Drive_Straight(MOTOR_SPEED_CRAWL);
+				Drive_Straight(BotParam(MOTOR_SPEED_CRAWL));
 			}
 			break;
 
@@ -525,16 +587,16 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankRight(MOTOR_SPEED_CRAWL);
+				Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (args.bits.event & args.bits.type & BUMP_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_TankLeft(MOTOR_SPEED_CRAWL);
+				Drive_TankLeft(BotParam(MOTOR_SPEED_CRAWL));
 
 				// Consume
 				ThisEvent.EventType = ES_NO_EVENT;
@@ -546,13 +608,13 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 
 
 			if (args.bits.event & args.bits.type & TAPE_FAR_LEFT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_Right(MOTOR_SPEED_MEDIUM);
+				Drive_Right(BotParam(MOTOR_SPEED_MEDIUM));
 			} else if (args.bits.event & args.bits.type & TAPE_FAR_RIGHT) {
-				ES_Timer_InitTimer(EVADE_TIMER, TIME_SEARCH_OBSTACLE);
+				ES_Timer_InitTimer(EVADE_TIMER, BotParam(TIME_SEARCH_OBSTACLE));
 
-				Drive_Left(MOTOR_SPEED_MEDIUM);
+				Drive_Left(BotParam(MOTOR_SPEED_MEDIUM));
 			}
 			break;
 
@@ -597,14 +659,18 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Face_Door:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin tank turning CW
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Init timer for 90deg turn
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, MOTOR_TURN_EX_90 + 20);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(MOTOR_TURN_EX_90) + 20);
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 			break;
@@ -612,7 +678,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -631,14 +697,18 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Enter_Castle:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Begin driving
-			Drive_Straight(MOTOR_SPEED_MEDIUM);
+			Drive_Straight(BotParam(MOTOR_SPEED_MEDIUM));
 
 			// Init timer to enter
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, TIME_SEARCH_ENTER);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(TIME_SEARCH_ENTER));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 			break;
@@ -646,7 +716,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -665,14 +735,18 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Check_Beacon:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&beaconScan);
+
 			// Begin tank turning CW
-			Drive_TankRight(MOTOR_SPEED_CRAWL);
+			Drive_TankRight(BotParam(MOTOR_SPEED_CRAWL));
 
 			// Init timer to enter
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, MOTOR_TURN_CR_90);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(MOTOR_TURN_CR_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 
@@ -700,7 +774,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
@@ -719,17 +793,21 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 	case Search_Turn_Around:
 		switch (ThisEvent.EventType) {
 		case ES_ENTRY:
+			EventChecker_SetScanProfile(&timedScan);
+
 			// Increment global count
 			++SearchCount;
 
 			// Begin tank turning CW
-			Drive_TankRight(MOTOR_SPEED_EXPLORE);
+			Drive_TankRight(BotParam(MOTOR_SPEED_EXPLORE));
 
 			// Init timer for 90deg turn
-			ES_Timer_InitTimer(SEARCH_HSM_TIMER, MOTOR_TURN_EX_90);
+			ES_Timer_InitTimer(SEARCH_HSM_TIMER, BotParam(MOTOR_TURN_EX_90));
 			break;
 
 		case ES_EXIT:
+			EventChecker_SetScanProfile(NULL);
+
 			// Stop
 			Drive_Stop();
 			break;
@@ -737,7 +815,7 @@ ES_Event RunSearchHSM(ES_Event ThisEvent)
 		case ES_TIMEOUT:
 			if (ThisEvent.EventParam == SEARCH_HSM_TIMER) {
 				Drive_Stop();
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 
 				ThisEvent.EventType = ES_NO_EVENT;
 			} else if (ThisEvent.EventParam == STALL_TIMER) {
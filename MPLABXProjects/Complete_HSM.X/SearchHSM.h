@@ -61,6 +61,15 @@ extern int SearchCount;
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t InitSearchHSM(void);
 
+/**
+ * @Function QuerySearchHSM(void)
+ * @param none
+ * @return Current state of the state machine
+ * @brief Returned as a byte since SearchState_t is private to SearchHSM.c, used
+ *        by telemetry
+ * @author rcrobert */
+uint8_t QuerySearchHSM(void);
+
 /**
  * @Function RunSearchHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
@@ -32,7 +32,15 @@
 #include "ES_Framework.h"
 #include "BOARD.h"
 #include "BotConfig.h"
+#include "BotParams.h"
+#include "BlackBox.h"
+#include "Nvm.h"
 #include "MotorDriver.h"
+#include "Odometry.h"
+#include "Battery.h"
+#include "Telemetry.h"
+#include "DebugLog.h"
+#include "ES_QueueStats.h"
 #include "TopHSM.h"
 #include "ExitHSM.h"
 #include "SearchHSM.h"
@@ -66,6 +74,12 @@ static const char *StateNames[] = {
 static TopState_t CurrentState = Top_Init;
 static uint8_t MyPriority;
 
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static uint8_t QueryActiveSubHSM(void);
+static void LogMissionStats(void);
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -143,6 +157,7 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 	TopState_t nextState;
 
 	ES_Tattle(); // trace call stack
+	BlackBox_Record(ThisEvent, CurrentState, QueryActiveSubHSM());
 
 	switch (CurrentState) {
 	case Top_Init: // If current state is initial Pseudo State
@@ -154,6 +169,10 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 			InitApproachHSM();
 			InitReturnHSM();
 
+			// Event counts cover the mission only
+			ES_ClearQueueStats();
+			EventChecker_ClearEventStats();
+
 			// Move to real state
 			nextState = Top_Exit;
 			makeTransition = TRUE;
@@ -174,7 +193,7 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 				break;
 
 			case CHILD_DONE:
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 				break;
 
 			case ES_TIMEOUT:
@@ -204,7 +223,7 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 				break;
 
 			case CHILD_DONE:
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 				break;
 
 			case ES_TIMEOUT:
@@ -234,7 +253,7 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 				break;
 
 			case CHILD_DONE:
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 				break;
 
 			case ES_TIMEOUT:
@@ -265,7 +284,7 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 				break;
 
 			case CHILD_DONE:
-				ES_Timer_InitTimer(STALL_TIMER, STALL_TIME_IN_MS);
+				ES_Timer_InitTimer(STALL_TIMER, BotParam(STALL_TIME_IN_MS));
 				break;
 
 			case ES_TIMEOUT:
@@ -287,6 +306,7 @@ ES_Event RunTopHSM(ES_Event ThisEvent)
 		if (ThisEvent.EventType != ES_NO_EVENT) {
 			switch (ThisEvent.EventType) {
 			case ES_ENTRY:
+				LogMissionStats();
 				break;
 
 			case ES_EXIT:
@@ -329,6 +349,48 @@ Example:
  * Lots of code here
  * } */
 
+/**
+ * @Function QueryActiveSubHSM(void)
+ * @return State of the sub HSM the current top state runs, 0 when it has none
+ * @author rcrobert */
+static uint8_t QueryActiveSubHSM(void)
+{
+	switch (CurrentState) {
+	case Top_Exit:
+		return QueryExitHSM();
+	case Top_Search:
+		return QuerySearchHSM();
+	case Top_Approach:
+		return QueryApproachHSM();
+	case Top_Return:
+		return QueryReturnHSM();
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @Function LogMissionStats(void)
+ * @return None
+ * @brief Logs how many sensor events the states' interest masks held back and
+ *        what reached this queue over the mission, compare runs with
+ *        EVENT_FILTER on and off
+ * @author rcrobert */
+static void LogMissionStats(void)
+{
+	SensorEventStats events;
+	ES_QueueStats queue;
+
+	EventChecker_GetEventStats(&events);
+	ES_GetQueueStats(MyPriority, &queue);
+
+	DLOG("Sensor events: %u posted, %u suppressed, %u masked, %u failed\r\n",
+		events.posted, events.suppressed, events.masked, events.failed);
+	DLOG("Top queue: %u posts, %u dispatched, %u drops, depth max %u mean %u/100\r\n",
+		queue.posts, queue.dispatches, queue.drops, queue.maxDepth,
+		queue.posts ? (queue.depthSum * 100 / queue.posts) : 0);
+}
+
 /*******************************************************************************
  * TEST HARNESS                                                                *
  ******************************************************************************/
@@ -350,7 +412,13 @@ void main(void)
 
 	// Your hardware initialization function calls go here
 	Bot_Init();
+	BotParams_Init();
+	Nvm_Init();
+	BlackBox_Init();
 	Drive_Init();
+	Odometry_Init();
+	Battery_Init();
+	Telemetry_Init();
 
 	// now initialize the Events and Services Framework and start it running
 	ErrorType = ES_Initialize();
@@ -0,0 +1,36 @@
+/*
+ * File:   Crc16.c
+ * Author: rcrobert
+ *
+ * CRC-16/CCITT-FALSE. See Crc16.h
+ *
+ * Created on December 11, 2014, 4:05 PM
+ */
+
+#include "Crc16.h"
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+// A nibble at a time, small enough to keep in flash
+static const uint16_t CrcTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+uint16_t Crc16(uint16_t crc, const void *data, unsigned int length)
+{
+	const uint8_t *in = data;
+
+	while (length--) {
+		crc = (crc << 4) ^ CrcTable[(crc >> 12) ^ (*in >> 4)];
+		crc = (crc << 4) ^ CrcTable[(crc >> 12) ^ (*in & 0x0F)];
+		++in;
+	}
+	return crc;
+}
@@ -0,0 +1,28 @@
+/*
+ * File:   Crc16.h
+ * Author: rcrobert
+ *
+ * CRC-16/CCITT-FALSE, poly 0x1021. Start from CRC16_INIT and feed any number
+ * of pieces through Crc16, the host tools compute the same thing.
+ *
+ * Created on December 11, 2014, 4:05 PM
+ */
+
+#ifndef CRC16_H
+#define	CRC16_H
+
+#include <stdint.h>
+
+#define CRC16_INIT 0xFFFF
+
+/**
+ * @Function Crc16(uint16_t crc, const void *data, unsigned int length)
+ * @param crc - CRC16_INIT or the result of the previous piece
+ * @param data - Bytes to add
+ * @param length - Number of bytes
+ * @return Updated CRC
+ * @author rcrobert 2014.12.11
+ */
+uint16_t Crc16(uint16_t crc, const void *data, unsigned int length);
+
+#endif	/* CRC16_H */
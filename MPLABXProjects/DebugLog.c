@@ -0,0 +1,142 @@
+/*
+ * File:   DebugLog.c
+ * Author: rcrobert
+ *
+ * Binary debug log. See DebugLog.h
+ *
+ * Created on December 10, 2014, 3:30 PM
+ */
+
+#include <xc.h>
+#include <plib.h>
+#include <stdarg.h>
+#include <BOARD.h>
+#include <serial.h>
+#include "RingBuffer.h"
+#include "DebugLog.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+#define RECORD_MAX (1 + 4 + (4 * DLOG_MAX_ARGS))
+
+// Largest piece handed to the UART per update
+#define DRAIN_CHUNK 64
+
+#define RecordLength(marker) (1 + 4 + (4 * ((marker) & 0x0F)))
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+static uint8_t logStorage[DLOG_QUEUESIZE];
+
+// Valid before DebugLog_Init so logging from any init function works
+static RingBuffer logBuffer = {logStorage, DLOG_QUEUESIZE - 1, 0, 0};
+static unsigned int logDrops = 0;
+
+// Every update can move at least one record
+typedef char DebugLogChunkFits[(DRAIN_CHUNK >= RECORD_MAX) ? 1 : -1];
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static uint8_t *PutWord(uint8_t *out, uint32_t word);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void DebugLog_Init(void)
+{
+	unsigned int intStatus;
+
+	intStatus = INTDisableInterrupts();
+	RingBuffer_Init(&logBuffer, logStorage, DLOG_QUEUESIZE);
+	logDrops = 0;
+	INTRestoreInterrupts(intStatus);
+}
+
+char DebugLog_Write(const char *fmt, int argc, ...)
+{
+	uint8_t record[RECORD_MAX];
+	uint8_t *out = record;
+	unsigned int intStatus;
+	char result = SUCCESS;
+	va_list args;
+	int i;
+
+	if (argc > DLOG_MAX_ARGS) {
+		argc = DLOG_MAX_ARGS;
+	}
+
+	// Build the whole record first, only the copy needs the lock
+	*out++ = DLOG_MARKER | argc;
+	out = PutWord(out, (uint32_t) fmt);
+	va_start(args, argc);
+	for (i = 0; i < argc; ++i) {
+		out = PutWord(out, va_arg(args, uint32_t));
+	}
+	va_end(args);
+
+	// Main code and ISRs can both log, the ring only takes one writer at a time
+	intStatus = INTDisableInterrupts();
+	if (RingBuffer_Space(&logBuffer) >= (out - record)) {
+		RingBuffer_Write(&logBuffer, record, out - record);
+	} else {
+		++logDrops;
+		result = ERROR;
+	}
+	INTRestoreInterrupts(intStatus);
+
+	return result;
+}
+
+uint8_t DebugLog_Update(void)
+{
+	uint8_t chunk[DRAIN_CHUNK];
+	unsigned int space;
+	unsigned int length = 0;
+	uint8_t marker;
+
+	// Only take what the UART can hold right now, nothing is lost in between
+	space = SERIAL_TransmitSpace();
+	if (space > DRAIN_CHUNK) {
+		space = DRAIN_CHUNK;
+	}
+
+	// Whole records only, one split across updates would interleave with
+	// anything else written to the UART meanwhile. Records go in whole so
+	// the rest is there once the marker is
+	while (RingBuffer_Peek(&logBuffer, &marker) != ERROR &&
+		(length + RecordLength(marker)) <= space) {
+		length += RingBuffer_Read(&logBuffer, &chunk[length],
+			RecordLength(marker));
+	}
+
+	if (length != 0) {
+		SERIAL_Write((const char *) chunk, length);
+	}
+
+	return FALSE;
+}
+
+unsigned int DebugLog_GetDropCount(void)
+{
+	return logDrops;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static uint8_t *PutWord(uint8_t *out, uint32_t word)
+{
+	*out++ = word;
+	*out++ = word >> 8;
+	*out++ = word >> 16;
+	*out++ = word >> 24;
+	return out;
+}
@@ -0,0 +1,88 @@
+/*
+ * File:   DebugLog.h
+ * Author: rcrobert
+ *
+ * Binary debug log. DLOG("Beacon read: %d\r\n", value) does no formatting on
+ * the PIC, the format string goes into its own flash section and its address
+ * is the log ID. Only the ID and the raw argument words go out the UART,
+ * HostTools/dlog_decode.py looks the strings back up in the .elf and prints
+ * the text.
+ *
+ * Record, little endian
+ * DLOG_MARKER | argc, 4 byte format address, argc 4 byte arguments
+ *
+ * Each argument is sent as one 32 bit word. Ints, chars and pointers to const
+ * strings (string literals, __FUNCTION__) work, floats and 64 bit values do
+ * not. %s is resolved from the .elf so strings built in RAM print as an
+ * address.
+ *
+ * Records are buffered and sent from DebugLog_Update in EVENT_CHECK_LIST, a
+ * record that does not fit is dropped whole and counted. Safe from ISRs.
+ *
+ * Created on December 10, 2014, 3:30 PM
+ */
+
+#ifndef DEBUGLOG_H
+#define	DEBUGLOG_H
+
+#include <inttypes.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+#define DLOG_QUEUESIZE 512	// power of two
+#define DLOG_MAX_ARGS 8
+
+// First byte of a record, low nibble is the argument count
+#define DLOG_MARKER 0xD0
+#define DLOG_SECTION ".dlog_fmt"
+
+// Counts up to DLOG_MAX_ARGS arguments at compile time
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+#define DLOG(fmt, ...) do { \
+    static const char __attribute__((section(DLOG_SECTION))) dlogFmt[] = fmt; \
+    DebugLog_Write(dlogFmt, DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+} while (0)
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function DebugLog_Init(void)
+ * @return None
+ * @brief Empties the log and clears the drop count
+ * @author rcrobert 2014.12.10
+ */
+void DebugLog_Init(void);
+
+/**
+ * @Function DebugLog_Write(const char *fmt, int argc, ...)
+ * @param fmt - Format string, must live in DLOG_SECTION
+ * @param argc - Number of 32 bit arguments that follow
+ * @return ERROR if the record was dropped
+ * @brief Use the DLOG macro instead
+ * @author rcrobert 2014.12.10
+ */
+char DebugLog_Write(const char *fmt, int argc, ...);
+
+/**
+ * @Function DebugLog_Update(void)
+ * @return FALSE, never posts
+ * @brief Moves whatever fits from the log into the UART transmit buffer.
+ *        Lives in EVENT_CHECK_LIST
+ * @author rcrobert 2014.12.10
+ */
+uint8_t DebugLog_Update(void);
+
+/**
+ * @Function DebugLog_GetDropCount(void)
+ * @return Records dropped since DebugLog_Init
+ * @author rcrobert 2014.12.10
+ */
+unsigned int DebugLog_GetDropCount(void);
+
+#endif	/* DEBUGLOG_H */
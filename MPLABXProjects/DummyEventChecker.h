@@ -10,6 +10,15 @@
 
 #include <inttypes.h>
 
+// Idle-time hooks listed in EVENT_CHECK_LIST
+#include "MotorDriver.h"
+#include "Odometry.h"
+#include "Battery.h"
+#include "DebugLog.h"
+#include "Telemetry.h"
+#include "BotParams.h"
+#include "Nvm.h"
+
 //typedef union {
 //    struct {
 //        unsigned char type : 8;
@@ -1,5 +1,6 @@
 #include <ES_Configure.h>
 #include "ES_Framework.h"
+#include "ES_QueueStats.h"
 /****************************************************************************
  Module
      ES_Queue.c
@@ -850,6 +851,11 @@ static ES_QueueDesc_t const EventQueues[NUM_SERVICES] = {
 
 uint8_t Ready;
 
+/****************************************************************************/
+// Per service traffic since the last ES_ClearQueueStats, see ES_QueueStats.h
+
+static ES_QueueStats QueueStats[NUM_SERVICES];
+
 /*------------------------------ Module Code ------------------------------*/
 
 /****************************************************************************
@@ -926,6 +932,7 @@ ES_Return_t ES_Run(void) {
                     if (ES_DeQueue(EventQueues[CurService].pMem, &ThisEvent) == 0) {
                         Ready &= ~CurServiceMask; // mark queue as now empty
                     }
+                    QueueStats[CurService].dispatches++;
                     if (ServDescList[CurService].RunFunc(ThisEvent).EventType == ES_ERROR) {
                         return FailedRun;
                     }
@@ -991,13 +998,89 @@ uint8_t ES_PostAll(ES_Event ThisEvent) {
    J. Edward Carryer, 01/16/12,
  ****************************************************************************/
 uint8_t ES_PostToService(uint8_t WhichService, ES_Event TheEvent) {
-    if ((WhichService < ARRAY_SIZE(EventQueues)) &&
-            (ES_EnQueueFIFO(EventQueues[WhichService].pMem, TheEvent) ==
-            TRUE)) {
+    uint8_t depth;
+
+    if (WhichService >= ARRAY_SIZE(EventQueues)) {
+        return FALSE;
+    }
+    if (ES_EnQueueFIFO(EventQueues[WhichService].pMem, TheEvent) == TRUE) {
         Ready |= (1 << WhichService); // show queue as non-empty
+        depth = ((pQueue_t) EventQueues[WhichService].pMem)->NumEntries;
+        QueueStats[WhichService].posts++;
+        QueueStats[WhichService].depthSum += depth;
+        if (depth > QueueStats[WhichService].maxDepth) {
+            QueueStats[WhichService].maxDepth = depth;
+        }
         return TRUE;
-    } else
+    } else {
+        QueueStats[WhichService].drops++;
         return FALSE;
+    }
+}
+
+/****************************************************************************
+ Function
+   ES_GetQueueDepth
+ Parameters
+   uint8_t : Which service's queue (index into ServDescList)
+ Returns
+   uint8_t : number of events waiting, 0 for a service that does not exist
+ Description
+   lets telemetry watch how far behind each service is
+ Notes
+   a single byte read, safe from idle time while ISRs post
+ Author
+   rcrobert, 12/11/14
+ ****************************************************************************/
+uint8_t ES_GetQueueDepth(uint8_t WhichService) {
+    if (WhichService >= ARRAY_SIZE(EventQueues)) {
+        return 0;
+    }
+    return ((pQueue_t) EventQueues[WhichService].pMem)->NumEntries;
+}
+
+/****************************************************************************
+ Function
+   ES_GetQueueStats
+ Parameters
+   uint8_t : Which service's queue (index into ServDescList)
+   ES_QueueStats * : filled with its counters, zeros for no such service
+ Returns
+   nothing
+ Description
+   posts, dispatches and how deep the queue ran since ES_ClearQueueStats
+ Notes
+   copied field by field, a post from an ISR in between can make them
+   disagree by one
+ Author
+   rcrobert, 12/14/14
+ ****************************************************************************/
+void ES_GetQueueStats(uint8_t WhichService, ES_QueueStats *Stats) {
+    static const ES_QueueStats none;
+
+    *Stats = (WhichService < ARRAY_SIZE(EventQueues)) ?
+            QueueStats[WhichService] : none;
+}
+
+/****************************************************************************
+ Function
+   ES_ClearQueueStats
+ Parameters
+   None
+ Returns
+   nothing
+ Description
+   starts every service's counters over, e.g. at the start of a mission
+ Author
+   rcrobert, 12/14/14
+ ****************************************************************************/
+void ES_ClearQueueStats(void) {
+    static const ES_QueueStats none;
+    unsigned char i;
+
+    for (i = 0; i < ARRAY_SIZE(QueueStats); i++) {
+        QueueStats[i] = none;
+    }
 }
 
 
@@ -1137,7 +1220,6 @@ void ES_TattleTaleDump(void)
             } else {
                 printf(";");
             }
-            while (!IsTransmitEmpty());
 #ifdef SUPPRESS_EXIT_ENTRY_IN_TATTLE
         }
 #endif
@@ -1712,9 +1794,7 @@ ES_Event RunKeyboardInput(ES_Event ThisEvent)
             CommandString[stringPos] = 0;
         }
         curCommandLength = 0;
-        while (!IsTransmitEmpty());
         KeyboardInput_PrintEvents();
-        while (!IsTransmitEmpty());
         printf("Keyboard input is active,\
              no other events except timer activations will be processed. \
                 You can redisplay the event list by sending a %d event.\r\n \
@@ -0,0 +1,52 @@
+/*
+ * File:   ES_QueueStats.h
+ * Author: rcrobert
+ *
+ * Framework additions that read the service queues. They live in
+ * ES_Framework.c, this header exists because ES_Framework.h is the course copy
+ * in C:\CMPE118\include.
+ *
+ * Created on December 11, 2014, 10:20 AM
+ */
+
+#ifndef ES_QUEUESTATS_H
+#define	ES_QUEUESTATS_H
+
+#include <stdint.h>
+
+// Traffic through one service queue
+typedef struct {
+    uint32_t posts;         // events queued
+    uint32_t drops;         // posts refused, the queue was full
+    uint32_t dispatches;    // events handed to the run function
+    uint32_t depthSum;      // queue depth just after each post, for the mean
+    uint8_t maxDepth;
+} ES_QueueStats;
+
+/**
+ * @Function ES_GetQueueDepth(uint8_t WhichService)
+ * @param WhichService - service priority, same index as ES_PostToService
+ * @return Events waiting in that service's queue, 0 if there is no such service
+ * @author rcrobert 2014.12.11
+ */
+uint8_t ES_GetQueueDepth(uint8_t WhichService);
+
+/**
+ * @Function ES_GetQueueStats(uint8_t WhichService, ES_QueueStats *Stats)
+ * @param WhichService - service priority, same index as ES_PostToService
+ * @param Stats - filled with the counters since ES_ClearQueueStats, zeros if
+ *                there is no such service
+ * @return None
+ * @author rcrobert 2014.12.14
+ */
+void ES_GetQueueStats(uint8_t WhichService, ES_QueueStats *Stats);
+
+/**
+ * @Function ES_ClearQueueStats(void)
+ * @return None
+ * @brief Starts the counters of every service over
+ * @author rcrobert 2014.12.14
+ */
+void ES_ClearQueueStats(void);
+
+#endif	/* ES_QUEUESTATS_H */
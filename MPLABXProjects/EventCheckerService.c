@@ -21,21 +21,67 @@
 #include "ES_Configure.h"
 #include "ES_Framework.h"
 #include "EventCheckerService.h"
+#include "BotParams.h"
+#include "IO_Pins.h"
+#include "SensorHealth.h"
+#include <xc.h>
 #include <stdio.h>
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
  ******************************************************************************/
 
-// Be careful with this, seems to lock up a lot since it is blocking
+// Binary log, decode with HostTools/dlog_decode.py
 //#define EVENTCHECKERSERVICE_VERBOSE
 #ifdef EVENTCHECKERSERVICE_VERBOSE
-#include "serial.h"
-#define dbprintf(...) while(!IsTransmitEmpty()); printf(__VA_ARGS__)
+#include "DebugLog.h"
+#define dbprintf(...) DLOG(__VA_ARGS__)
 #else
 #define dbprintf(...)
 #endif
 
+/*
+ * Mux select lines, driven through one LAT register so a step never shows
+ * the 74HC4051 an address that is half old and half new
+ */
+#define MUX_LINE(pin) IO_PINS_BITS(MUX_PINS_PORT, pin)
+#define MUX_LAT_INV IO_PINS_LAT(MUX_PINS_PORT, MUX_PINS_OR, INV)
+
+// Lines are inverted, a 1 in the select drives its line low
+#define MUX_LAT_FOR(sel) \
+	((((sel) & 0x01) ? 0 : MUX_LINE(MUX_PINS_BIT0)) | \
+	 (((sel) & 0x02) ? 0 : MUX_LINE(MUX_PINS_BIT1)) | \
+	 (((sel) & 0x04) ? 0 : MUX_LINE(MUX_PINS_BIT2)))
+
+/*
+ * Analog sensors read together with AD_ReadADPins, indexes follow the
+ * AD_PORTxxx order so a pin's index is the number of pins below it
+ */
+#define ANALOG_PINS (SENSOR_PINS_BEACON | SENSOR_PINS_TAPE | SENSOR_PINS_DIST)
+#define ANALOG_COUNT 3
+#define ANALOG_INDEX(pin) __builtin_popcount(ANALOG_PINS & ((pin) - 1))
+#define ANALOG_TAPE ANALOG_INDEX(SENSOR_PINS_TAPE)
+#define ANALOG_BEACON ANALOG_INDEX(SENSOR_PINS_BEACON)
+#define ANALOG_DIST ANALOG_INDEX(SENSOR_PINS_DIST)
+
+// Raw distance readings kept per sensor for the median
+#define DIST_HISTORY 3
+
+/*
+ * Track wire envelope. The detector output is the carrier riding on a bias,
+ * bias is a slow mean and the envelope follows |sample - bias| with a fast
+ * attack and slow decay, Q4. A step takes at most TRACK_SAMPLES new ones
+ */
+#define TRACK_SAMPLES 16
+#define TRACK_BIAS_SHIFT 8
+#define TRACK_ENV_Q 4
+#define TRACK_ATTACK_SHIFT 1
+#define TRACK_DECAY_SHIFT 5
+
+// Fails to compile if BotConfig.h spreads the lines over two PIC32 ports
+typedef char MuxLinesShareAPort[
+	(IO_PINS_PORTS(MUX_PINS_PORT, MUX_PINS_OR) == 1) ? 1 : -1];
+
 /*
 #define STRING_FORM(STATE) #STATE, //Strings are stringified and comma'd
 static const char *StateNames[] = {
@@ -49,6 +95,19 @@ static const char *StateNames[] = {
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
 
+static void RunBumpReflex(uint8_t bumper, uint32_t detectTick);
+static void ReadDistance(uint8_t sensor, unsigned int counts);
+static unsigned int Median3(unsigned int a, unsigned int b, unsigned int c);
+static uint16_t CountsToMm(unsigned int counts);
+static void ReadTrack(void);
+static void StepMux(uint8_t *endedGroups);
+static void StartPass(void);
+static void PostSensorEvent(ES_Event ThisEvent);
+static char MaskEvent(ES_Event *ThisEvent);
+static void SelectMux(uint8_t sel);
+static void TriggerMuxScan(void);
+static char MuxScanReady(void);
+
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                    *
  ******************************************************************************/
@@ -65,6 +124,79 @@ enum {
 
 static uint8_t MyPriority;
 
+// Reflex per bumper, index matches the mux select
+static DriveReflex_t reflexAction[NUM_BUMP_SENSORS];
+static unsigned int reflexHoldMs[NUM_BUMP_SENSORS];
+
+// Last time each bumper was read open, for latency bounds
+static uint32_t lastClearSample[NUM_BUMP_SENSORS];
+static BumpReflexStats reflexStats;
+
+// Debounced state of every sensor as of the last posted edge
+static SensorSnapshot sensorState;
+
+// LAT bits of the select lines for each mux select
+static const uint32_t muxLat[MAX_MUX_SEL] = {
+	MUX_LAT_FOR(0), MUX_LAT_FOR(1), MUX_LAT_FOR(2), MUX_LAT_FOR(3),
+	MUX_LAT_FOR(4), MUX_LAT_FOR(5), MUX_LAT_FOR(6), MUX_LAT_FOR(7)
+};
+
+// Order the selects are scanned in, every select still comes once a pass
+#if MUX_SCAN_GRAY
+static const uint8_t muxOrder[MAX_MUX_SEL] = {0, 1, 3, 2, 6, 7, 5, 4};
+#else
+static const uint8_t muxOrder[MAX_MUX_SEL] = {0, 1, 2, 3, 4, 5, 6, 7};
+#endif
+
+// Select the lines are driving now, and where it is in muxOrder
+static uint8_t muxSel;
+static uint8_t muxStep;
+static MuxStats muxStats;
+
+// Scan profile, groups and selects of the pass being scanned
+static const ScanProfile fullScan = {SCAN_GROUP_ALL, 0, 0, EVENT_ALL, 0};
+static const ScanProfile *scanProfile = &fullScan;
+static uint8_t passGroups;
+static uint8_t passSelects;
+static uint8_t passSteps;
+
+static SensorEventStats eventStats;
+
+// Every event EventCheckerService posts has to fit in ScanProfile events
+typedef char SensorEventsFitInterest[(DISTANCE < 32) ? 1 : -1];
+
+/*
+ * A/D counts to mm for the GP2Y0A21 at 3.3V full scale, from its datasheet
+ * curve. Falling counts, rising mm. Output folds back under 100mm, anything
+ * brighter than the first point reads as it
+ */
+typedef struct {
+	uint16_t counts;
+	uint16_t mm;
+} DistPoint;
+
+static const DistPoint distTable[] = {
+	{713, 100}, {512, 150}, {403, 200}, {335, 250}, {285, 300},
+	{233, 400}, {186, 500}, {155, 600}, {124, DIST_MM_MAX}
+};
+
+#define DIST_TABLE_SIZE (sizeof (distTable) / sizeof (distTable[0]))
+
+// Raw history and filtered distance per sensor
+static unsigned int distRaw[NUM_DIST_SENSORS][DIST_HISTORY];
+static uint8_t distPrimed[NUM_DIST_SENSORS];
+static uint16_t distMm[NUM_DIST_SENSORS];
+
+// Track wire bias in Q(TRACK_BIAS_SHIFT), envelope, end of the last sample
+static char trackPrimed = FALSE;
+static int32_t trackBias;
+static int32_t trackEnv;
+static uint32_t trackLastTime;
+
+// A/D scan started after the last select, muxScan is the sequence it carries
+static char muxScanTriggered = FALSE;
+static uint16_t muxScan;
+
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
  ******************************************************************************/
@@ -82,10 +214,33 @@ static uint8_t MyPriority;
 uint8_t InitEventCheckerService(uint8_t Priority)
 {
 	ES_Event ThisEvent;
+	int i;
 
 	MyPriority = Priority;
 
-
+	for (i = 0; i < NUM_DIST_SENSORS; i++) {
+		distPrimed[i] = FALSE;
+		distMm[i] = DIST_MM_MAX;
+	}
+	SensorHealth_Init();
+
+	// Scans start once the mux has settled, nothing else triggers them
+	AD_SetTriggered(TRUE);
+	AD_SetOversample(SENSOR_PINS_TAPE, SENSOR_TAPE_OVERSAMPLE);
+
+	// LAT comes out of reset low, select 7, put the lines where the scan starts
+	IO_PinsSet(MUX_PINS_PORT, MUX_PINS_OR);
+	muxStep = 0;
+	muxSel = muxOrder[0];
+	StartPass();
+	TriggerMuxScan();
+
+	// Default reflexes, backoff wins if a bumper is in both masks
+	EventChecker_SetBumpReflex(0xFF, DRIVE_REFLEX_NONE, 0);
+	EventChecker_SetBumpReflex(REFLEX_BUMP_STOP_MASK, DRIVE_REFLEX_STOP,
+		REFLEX_HOLD_PARAM);
+	EventChecker_SetBumpReflex(REFLEX_BUMP_BACKOFF_MASK, DRIVE_REFLEX_BACKOFF,
+		REFLEX_HOLD_PARAM);
 
 	// Set up first timer call
 	ES_Timer_InitTimer(EVENT_CHECKER_TIMER, SENSORS_POLLING_DELAY);
@@ -127,6 +282,7 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 	int i;
 	static char CurrentState;
 	static uint8_t muxCnt = 0x00;
+	uint8_t endedGroups;
 
 	static uint8_t oldBumpState = 0x00; // init to no bumps, active low
 	static uint8_t newBumpState = 0x00;
@@ -134,11 +290,9 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 
 	static uint16_t oldBeaconVals[] = {1023, 1023, 1023, 1023}; // active low
 	uint16_t newADVal;
-
-	static uint8_t oldTrackState = 0;
-	uint8_t newTrackState;
-	static uint8_t newTrack[3];
-	uint8_t trackSum;
+	char scanReady;
+	unsigned int analog[ANALOG_COUNT];
+	unsigned int analogHiRes[ANALOG_COUNT];
 
 	static char tapeReadType = LEDS_OFF;
 	int newTapeVal;
@@ -180,6 +334,10 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 			EVENT_CHECKER_TIMER) {
 			// Timer has expired
 
+			// Analog reads skip a step rather than use another select's values
+			scanReady = MuxScanReady() &&
+				(AD_ReadADPinsBoth(ANALOG_PINS, analog, analogHiRes) == SUCCESS);
+
 			/*
 			 * Read bump sensor and post events
 			 * Bump sensors are inverted, active LOW
@@ -190,13 +348,23 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 				mask = 1 << muxCnt;
 
 				// If non zero, write bit shifted equivalent into the temp state
-				newBumpState = (IO_PortsReadPort(SENSOR_PINS_PORT) &
-					SENSOR_PINS_BUMP) ? 0x00 : mask;
+				newBumpState = IO_PinsRead(SENSOR_PINS_PORT, SENSOR_PINS_BUMP) ?
+					0x00 : mask;
+
+				// Reflex goes out before the event is even queued, not for a
+				// bumper SensorHealth has masked
+				if ((newBumpState & ~oldBumpState) & ~HEALTH_GROUP(
+					SensorHealth_GetMasked(), HEALTH_BUMP, NUM_BUMP_SENSORS)) {
+					RunBumpReflex(muxCnt, _CP0_GET_COUNT());
+				} else if (newBumpState == 0x00) {
+					lastClearSample[muxCnt] = _CP0_GET_COUNT();
+				}
 
 				// If new is different than old at the bit shifted mask value
 				if ((newBumpState ^ oldBumpState) & mask) {
 					// Update old value, flip corresponding bit
 					oldBumpState ^= mask;
+					sensorState.bump = oldBumpState;
 
 					// Configure the event to be posted
 					// bumpStates shows the current state of all bumpers
@@ -207,119 +375,105 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 					PostEvent.EventParam = EventData.val;
 
 					// Post it
-					PostToMainHSM(PostEvent);
+					PostSensorEvent(PostEvent);
 				}
+
+				SensorHealth_Sample(HEALTH_BUMP + muxCnt, newBumpState ? 1 : 0,
+					newBumpState != 0x00, FALSE);
 			}
 
 			/*
 			 * Read beacon sensor and post events
 			 */
-			if (muxCnt < NUM_LIGHT_SENSORS) {
-				newADVal = AD_ReadADPin(SENSOR_PINS_BEACON);
+			if (scanReady && (muxCnt < NUM_LIGHT_SENSORS)) {
+				newADVal = analog[ANALOG_BEACON];
 
 				// Hysteresis
 				// Rising edge
-				if ((newADVal > THRESHOLD_BEACON_HIGH) &&
-					(oldBeaconVals[muxCnt] < THRESHOLD_BEACON_HIGH)) {
+				if ((newADVal > BotParam(THRESHOLD_BEACON_HIGH)) &&
+					(oldBeaconVals[muxCnt] < BotParam(THRESHOLD_BEACON_HIGH))) {
 					// BEACON LOST, RISING EDGE
 					PostEvent.EventType = BEACON_LOST;
 					EventData.val = 1 << muxCnt;
+					sensorState.beacon &= ~(1 << muxCnt);
 					PostEvent.EventParam = EventData.val;
 
 					// Post it
 					dbprintf("Beacon read: %d\r\n", newADVal);
-					PostToMainHSM(PostEvent);
+					PostSensorEvent(PostEvent);
 				}
 				// Falling edge
-				else if ((newADVal < THRESHOLD_BEACON_LOW) &&
-					(oldBeaconVals[muxCnt] > THRESHOLD_BEACON_LOW)) {
+				else if ((newADVal < BotParam(THRESHOLD_BEACON_LOW)) &&
+					(oldBeaconVals[muxCnt] > BotParam(THRESHOLD_BEACON_LOW))) {
 					// BEACON FOUND, FALLING EDGE
 					PostEvent.EventType = BEACON_FOUND;
 					EventData.val = 1 << muxCnt;
+					sensorState.beacon |= 1 << muxCnt;
 					PostEvent.EventParam = EventData.val;
 
 					// Post it
 					dbprintf("Beacon read: %d\r\n", newADVal);
-					PostToMainHSM(PostEvent);
+					PostSensorEvent(PostEvent);
 				}
 
 				// Update old vals
 				oldBeaconVals[muxCnt] = newADVal;
+
+				SensorHealth_Sample(HEALTH_BEACON + muxCnt, newADVal,
+					(sensorState.beacon >> muxCnt) & 1, HEALTH_RAILED(newADVal));
+			}
+
+			/*
+			 * Read distance sensors, posts on the thresholds
+			 */
+			if (scanReady && (muxCnt < NUM_DIST_SENSORS)) {
+				ReadDistance(muxCnt, analog[ANALOG_DIST]);
+
+				SensorHealth_Sample(HEALTH_DIST + muxCnt, analog[ANALOG_DIST],
+					(sensorState.near >> muxCnt) & 1,
+					HEALTH_RAILED(analog[ANALOG_DIST]));
 			}
 
 			/*
 			 * Read tape sensor, does not post events
 			 */
-			if (muxCnt < NUM_TAPE_SENSORS) {
+			if (scanReady && (muxCnt < NUM_TAPE_SENSORS) &&
+				(passGroups & SCAN_GROUP_TAPE)) {
 				switch (tapeReadType) {
 				case LEDS_OFF:
-					tapeValsOff[muxCnt] = (int) AD_ReadADPin(SENSOR_PINS_TAPE);
+					tapeValsOff[muxCnt] = (int) analogHiRes[ANALOG_TAPE];
 					break;
 
 				case LEDS_ON:
-					tapeValsOn[muxCnt] = (int) AD_ReadADPin(SENSOR_PINS_TAPE);
+					tapeValsOn[muxCnt] = (int) analogHiRes[ANALOG_TAPE];
 					break;
 				}
 			}
 
 			/*
-			 * Read track wire and post events
+			 * Read track wire and post events, not on the mux so every
+			 * step takes all the samples since the last one
 			 */
-			// Take 3 samples
-			if ((muxCnt % 3) == 0) {
-				newTrack[muxCnt / 3] = (IO_PortsReadPort(SENSOR_PINS_PORT) & SENSOR_PINS_TRACK) ?
-										1 : 0;
-
-				// On 3rd sample, take a best of 3
-				if (muxCnt == 6) {
-					trackSum = newTrack[0] + newTrack[1] + newTrack[2];
-
-					newTrackState = (trackSum >= 2) ? 1 : 0;
-
-					// if change in state
-					if (newTrackState != oldTrackState) {
-						if (newTrackState) {
-							PostEvent.EventType = TRACK_FOUND;
-						} else {
-							PostEvent.EventType = TRACK_LOST;
-						}
-
-						oldTrackState = newTrackState;
-
-						PostToMainHSM(PostEvent);
-					}
-				}
-			}
+			ReadTrack();
 
 
 			/*
-			 * Increment mux, hardcoded for 3-bit mux
-			 */;
-			muxCnt = (muxCnt + 1) % MAX_MUX_SEL;
-
-			for (i = 0; i < 3; i++) {
-				mask = 1 << i;
-
-				if (mask & muxCnt) { // that bit == 1
-					// Set that bit, pins must be adjacent, BIT0 lowest pin
-					// The pins are on consecutive odd pins, this may need to be adjusted
-					IO_PortsClearPortBits(MUX_PINS_PORT, (MUX_PINS_BIT0 >> (2 * i)));
-				} else { // that bit == 0
-					// Clear that bit, make it viable for non-adjacent pins
-					// The pins are on consecutive odd pins, this may need to be adjusted
-					IO_PortsSetPortBits(MUX_PINS_PORT, (MUX_PINS_BIT0 >> (2 * i)));
-				}
-			}
+			 * Step the mux, muxCnt stays the select being read
+			 */
+			StepMux(&endedGroups);
+			muxCnt = muxOrder[muxStep];
+			SelectMux(muxCnt);
+			TriggerMuxScan();
 
 			/*
-			 * Switch tape sensor state when muxCnt rolls over, post events
+			 * Switch tape sensor state after a pass with the tape, post events
 			 */
-			if (muxCnt == 0x00) {
+			if (endedGroups & SCAN_GROUP_TAPE) {
 				// Change state
 				switch (tapeReadType) {
 				case LEDS_OFF:
 					// Turn on LEDs
-					IO_PortsSetPortBits(SENSOR_PINS_PORT, SENSOR_PINS_LEDS);
+					IO_PinsSet(SENSOR_PINS_PORT, SENSOR_PINS_LEDS);
 
 					// Change states
 					tapeReadType = LEDS_ON;
@@ -327,7 +481,7 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 
 				case LEDS_ON:
 					// Turn off LEDs
-					IO_PortsClearPortBits(SENSOR_PINS_PORT, SENSOR_PINS_LEDS);
+					IO_PinsClear(SENSOR_PINS_PORT, SENSOR_PINS_LEDS);
 
 					// Change states
 					tapeReadType = LEDS_OFF;
@@ -340,16 +494,16 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 					for (i = 0; i < NUM_TAPE_SENSORS; i++) {
 						newTapeVal = tapeValsOn[i] - tapeValsOff[i];
 
-						// Hysteresis
+						// Hysteresis, tape values are in AD_HIRES_SCALE counts
 						// Rising edge
-						if ((newTapeVal > THRESHOLD_TAPE_HIGH) &&
-							(oldTapeVals[i] < THRESHOLD_TAPE_HIGH)) {
+						if ((newTapeVal > BotParam(THRESHOLD_TAPE_HIGH) * AD_HIRES_SCALE) &&
+							(oldTapeVals[i] < BotParam(THRESHOLD_TAPE_HIGH) * AD_HIRES_SCALE)) {
 							// LEAVING TAPE, RISING EDGE
 							EventData.bits.event |= 0x01 << i; // Set event flag
 							// Leave type flag clear
 						}							// Falling edge
-						else if ((newTapeVal < THRESHOLD_TAPE_LOW) &&
-							(oldTapeVals[i] > THRESHOLD_TAPE_LOW)) {
+						else if ((newTapeVal < BotParam(THRESHOLD_TAPE_LOW) * AD_HIRES_SCALE) &&
+							(oldTapeVals[i] > BotParam(THRESHOLD_TAPE_LOW) * AD_HIRES_SCALE)) {
 							// ON TAPE, FALLING EDGE
 							EventData.bits.event |= 0x01 << i; // Set event flag
 							EventData.bits.type |= 0x01 << i; // Set type flag
@@ -361,11 +515,24 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 
 					// Post it, if an event was detected
 					if (EventData.bits.event != 0x00) {
+						sensorState.tape = (sensorState.tape &
+							~EventData.bits.event) |
+							(EventData.bits.type & EventData.bits.event);
+
 						PostEvent.EventType = TAPE;
 						PostEvent.EventParam = EventData.val;
-						PostToMainHSM(PostEvent);
+						PostSensorEvent(PostEvent);
 					}
 					//*/
+
+					// Health sees the contrast, a dead LED has none
+					for (i = 0; i < NUM_TAPE_SENSORS; i++) {
+						SensorHealth_Sample(HEALTH_TAPE + i,
+							oldTapeVals[i] / AD_HIRES_SCALE,
+							(sensorState.tape >> i) & 1,
+							HEALTH_RAILED(tapeValsOn[i] / AD_HIRES_SCALE) ||
+							HEALTH_RAILED(tapeValsOff[i] / AD_HIRES_SCALE));
+					}
 				}
 
 
@@ -393,10 +560,475 @@ ES_Event RunEventCheckerService(ES_Event ThisEvent)
 	return ReturnEvent;
 }
 
+void EventChecker_SetBumpReflex(uint8_t bumpMask, DriveReflex_t action,
+	unsigned int holdMs)
+{
+	int i;
+
+	for (i = 0; i < NUM_BUMP_SENSORS; i++) {
+		if (bumpMask & (1 << i)) {
+			reflexAction[i] = action;
+			reflexHoldMs[i] = holdMs;
+		}
+	}
+}
+
+void EventChecker_GetReflexStats(BumpReflexStats *stats)
+{
+	*stats = reflexStats;
+}
+
+void EventChecker_GetSnapshot(SensorSnapshot *snapshot)
+{
+	uint32_t masked = SensorHealth_GetMasked();
+
+	*snapshot = sensorState;
+	snapshot->bump &= ~HEALTH_GROUP(masked, HEALTH_BUMP, NUM_BUMP_SENSORS);
+	snapshot->tape &= ~HEALTH_GROUP(masked, HEALTH_TAPE, NUM_TAPE_SENSORS);
+	snapshot->beacon &= ~HEALTH_GROUP(masked, HEALTH_BEACON, NUM_LIGHT_SENSORS);
+	snapshot->near &= ~HEALTH_GROUP(masked, HEALTH_DIST, NUM_DIST_SENSORS);
+	if (masked & (1UL << HEALTH_TRACK)) {
+		snapshot->track = 0;
+	}
+}
+
+void EventChecker_GetMuxStats(MuxStats *stats)
+{
+	*stats = muxStats;
+}
+
+void EventChecker_SetScanProfile(const ScanProfile *profile)
+{
+	scanProfile = (profile != NULL) ? profile : &fullScan;
+}
+
+void EventChecker_GetEventStats(SensorEventStats *stats)
+{
+	*stats = eventStats;
+}
+
+void EventChecker_ClearEventStats(void)
+{
+	eventStats.posted = 0;
+	eventStats.suppressed = 0;
+	eventStats.masked = 0;
+	eventStats.failed = 0;
+}
+
+uint16_t EventChecker_GetTrackStrength(void)
+{
+	return trackEnv >> TRACK_ENV_Q;
+}
+
+void EventChecker_GetDistances(uint16_t *mm)
+{
+	int i;
+
+	for (i = 0; i < NUM_DIST_SENSORS; i++) {
+		mm[i] = distMm[i];
+	}
+}
+
 /*******************************************************************************
  * PRIVATE FUNCTIONs                                                           *
  ******************************************************************************/
 
+/**
+ * @Function RunBumpReflex(uint8_t bumper, uint32_t detectTick)
+ * @param bumper - mux select of the bumper that just closed
+ * @param detectTick - core timer when the closed bumper was read
+ * @return None
+ * @brief Fires the configured reflex and logs how long the motors took to
+ *        see it. The bump happened somewhere after the last clear sample so
+ *        that gives the worst case
+ * @author rcrobert */
+static void RunBumpReflex(uint8_t bumper, uint32_t detectTick)
+{
+	uint32_t stopTick;
+	uint32_t detectToStop;
+	uint32_t bumpToStop;
+	unsigned int holdMs;
+
+	if (reflexAction[bumper] == DRIVE_REFLEX_NONE ||
+		(scanProfile->noReflex & (1 << bumper))) {
+		return;
+	}
+
+	// Parameters can be tuned over the link after init
+	holdMs = reflexHoldMs[bumper];
+	if (holdMs == REFLEX_HOLD_PARAM) {
+		holdMs = (reflexAction[bumper] == DRIVE_REFLEX_BACKOFF) ?
+			BotParam(TIME_REFLEX_BACKOFF) : BotParam(TIME_REFLEX_HOLD);
+	}
+
+	Drive_Reflex(reflexAction[bumper], holdMs);
+	stopTick = _CP0_GET_COUNT();
+
+	detectToStop = (stopTick - detectTick) / CORE_TICKS_PER_US;
+	bumpToStop = (stopTick - lastClearSample[bumper]) / CORE_TICKS_PER_US;
+
+	reflexStats.trips++;
+	reflexStats.lastDetectToStop = detectToStop;
+	reflexStats.lastBumpToStop = bumpToStop;
+	if (detectToStop > reflexStats.maxDetectToStop) {
+		reflexStats.maxDetectToStop = detectToStop;
+	}
+	if (bumpToStop > reflexStats.maxBumpToStop) {
+		reflexStats.maxBumpToStop = bumpToStop;
+	}
+
+	dbprintf("Reflex %d: %luus detect, %luus bound\r\n", bumper, detectToStop,
+		bumpToStop);
+}
+
+/**
+ * @Function ReadDistance(uint8_t sensor, unsigned int counts)
+ * @param sensor - mux select of the distance sensor
+ * @param counts - its A/D reading this pass
+ * @return None
+ * @brief Median of the last 3 readings through distTable, then hysteresis on
+ *        THRESHOLD_DIST_NEAR and THRESHOLD_DIST_FAR. Posts DISTANCE with
+ *        every near sensor in type and this one in event
+ * @author rcrobert */
+static void ReadDistance(uint8_t sensor, unsigned int counts)
+{
+	unsigned int *raw = distRaw[sensor];
+	uint8_t mask = 1 << sensor;
+	ES_Event PostEvent;
+	EventStorage EventData;
+
+	// The first reading fills the history so the median starts from it
+	if (!distPrimed[sensor]) {
+		raw[1] = raw[2] = counts;
+		distPrimed[sensor] = TRUE;
+	}
+	raw[0] = raw[1];
+	raw[1] = raw[2];
+	raw[2] = counts;
+
+	distMm[sensor] = CountsToMm(Median3(raw[0], raw[1], raw[2]));
+
+	// Hysteresis
+	if (!(sensorState.near & mask) &&
+		(distMm[sensor] < BotParam(THRESHOLD_DIST_NEAR))) {
+		sensorState.near |= mask;
+	} else if ((sensorState.near & mask) &&
+		(distMm[sensor] > BotParam(THRESHOLD_DIST_FAR))) {
+		sensorState.near &= ~mask;
+	} else {
+		return;
+	}
+
+	PostEvent.EventType = DISTANCE;
+	EventData.bits.type = sensorState.near;
+	EventData.bits.event = mask;
+	PostEvent.EventParam = EventData.val;
+
+	dbprintf("Distance %d: %dmm\r\n", sensor, distMm[sensor]);
+	PostSensorEvent(PostEvent);
+}
+
+/**
+ * @Function Median3(unsigned int a, unsigned int b, unsigned int c)
+ * @return The middle one, a single bad reading never gets through
+ * @author rcrobert */
+static unsigned int Median3(unsigned int a, unsigned int b, unsigned int c)
+{
+	if (a > b) {
+		unsigned int t = a;
+		a = b;
+		b = t;
+	}
+	// a <= b, the median is b clamped to [a, c] when c is above a
+	if (c <= a) {
+		return a;
+	}
+	return (c < b) ? c : b;
+}
+
+/**
+ * @Function CountsToMm(unsigned int counts)
+ * @param counts - distance sensor A/D reading
+ * @return mm, interpolated between the distTable points around counts
+ * @author rcrobert */
+static uint16_t CountsToMm(unsigned int counts)
+{
+	unsigned int i;
+	const DistPoint *near;
+	const DistPoint *far;
+
+	if (counts >= distTable[0].counts) {
+		return distTable[0].mm;
+	}
+	for (i = 1; i < DIST_TABLE_SIZE; i++) {
+		if (counts > distTable[i].counts) {
+			near = &distTable[i - 1];
+			far = &distTable[i];
+			return far->mm - (uint32_t) (far->mm - near->mm) *
+				(counts - far->counts) / (near->counts - far->counts);
+		}
+	}
+	return DIST_MM_MAX;
+}
+
+/**
+ * @Function ReadTrack(void)
+ * @return None
+ * @brief Runs the envelope over every track wire sample newer than the last
+ *        step, then hysteresis on THRESHOLD_TRACK_HIGH and
+ *        THRESHOLD_TRACK_LOW. TRACK_FOUND and TRACK_LOST carry the strength
+ * @author rcrobert */
+static void ReadTrack(void)
+{
+	uint16_t samples[TRACK_SAMPLES];
+	uint32_t times[TRACK_SAMPLES];
+	unsigned int count;
+	unsigned int i;
+	int32_t mag;
+	uint16_t strength;
+	ES_Event PostEvent;
+
+	count = AD_ReadLatestSamples(SENSOR_PINS_TRACK, samples, times,
+		TRACK_SAMPLES);
+	if (count == 0) {
+		return;
+	}
+	if (!trackPrimed) {
+		trackBias = (int32_t) samples[0] << TRACK_BIAS_SHIFT;
+		trackEnv = 0;
+		trackLastTime = times[0] - 1;
+		trackPrimed = TRUE;
+	}
+
+	for (i = 0; i < count; i++) {
+		// Oldest first, skip what the last step already took
+		if ((int32_t) (times[i] - trackLastTime) <= 0) {
+			continue;
+		}
+		trackLastTime = times[i];
+
+		trackBias += samples[i] - (trackBias >> TRACK_BIAS_SHIFT);
+		mag = ((int32_t) samples[i] << TRACK_BIAS_SHIFT) - trackBias;
+		mag = ((mag < 0) ? -mag : mag) >> (TRACK_BIAS_SHIFT - TRACK_ENV_Q);
+
+		if (mag > trackEnv) {
+			trackEnv += (mag - trackEnv) >> TRACK_ATTACK_SHIFT;
+		} else {
+			trackEnv -= (trackEnv - mag) >> TRACK_DECAY_SHIFT;
+		}
+	}
+
+	strength = trackEnv >> TRACK_ENV_Q;
+	SensorHealth_Sample(HEALTH_TRACK, strength, sensorState.track, FALSE);
+
+	// Hysteresis
+	if (!sensorState.track && (strength > BotParam(THRESHOLD_TRACK_HIGH))) {
+		PostEvent.EventType = TRACK_FOUND;
+		sensorState.track = 1;
+	} else if (sensorState.track &&
+		(strength < BotParam(THRESHOLD_TRACK_LOW))) {
+		PostEvent.EventType = TRACK_LOST;
+		sensorState.track = 0;
+	} else {
+		return;
+	}
+
+	PostEvent.EventParam = strength;
+	dbprintf("Track: %d\r\n", strength);
+	PostSensorEvent(PostEvent);
+}
+
+/**
+ * @Function SelectMux(uint8_t sel)
+ * @param sel - mux select to drive next
+ * @return None
+ * @brief Flips every line that differs in a single LATxINV store, all of
+ *        them change on the same clock. Counts the lines moved and times the
+ *        store for MuxStats
+ * @author rcrobert */
+static void SelectMux(uint8_t sel)
+{
+	uint8_t moved = muxSel ^ sel;
+	uint32_t change = muxLat[muxSel] ^ muxLat[sel];
+	uint32_t start;
+	uint32_t ticks;
+
+	start = _CP0_GET_COUNT();
+	MUX_LAT_INV = change;
+	ticks = _CP0_GET_COUNT() - start;
+
+	muxSel = sel;
+
+	moved = (moved & 0x01) + ((moved >> 1) & 0x01) + ((moved >> 2) & 0x01);
+	muxStats.steps++;
+	muxStats.lineToggles += moved;
+	if (moved > 1) {
+		muxStats.multiLineSteps++;
+	}
+	muxStats.lastTicks = ticks;
+	if (ticks > muxStats.maxTicks) {
+		muxStats.maxTicks = ticks;
+	}
+}
+
+/**
+ * @Function PostSensorEvent(ES_Event ThisEvent)
+ * @param ThisEvent - sensor event, the snapshot already holds its change
+ * @return None
+ * @brief Posts to the main HSM if the scan profile's events has it and it
+ *        is not only from channels SensorHealth has masked
+ * @author rcrobert */
+static void PostSensorEvent(ES_Event ThisEvent)
+{
+	if (!MaskEvent(&ThisEvent)) {
+		eventStats.masked++;
+		return;
+	}
+	if (BotParam(EVENT_FILTER) &&
+		!(scanProfile->events & EVENT_BIT(ThisEvent.EventType))) {
+		eventStats.suppressed++;
+		return;
+	}
+	if (PostToMainHSM(ThisEvent) == TRUE) {
+		eventStats.posted++;
+	} else {
+		eventStats.failed++;
+	}
+}
+
+/**
+ * @Function MaskEvent(ES_Event *ThisEvent)
+ * @param ThisEvent - sensor event, masked channels are taken out of its bits
+ * @return FALSE if it came only from masked channels and should not go out
+ * @brief Bit params carry this sensor in event and every active one in type,
+ *        beacons carry the one sensor alone
+ * @author rcrobert */
+static char MaskEvent(ES_Event *ThisEvent)
+{
+	uint32_t masked = SensorHealth_GetMasked();
+	EventStorage EventData;
+	uint8_t bits;
+
+	if (masked == 0) {
+		return TRUE;
+	}
+
+	EventData.val = ThisEvent->EventParam;
+	switch (ThisEvent->EventType) {
+	case BUMPER:
+		bits = HEALTH_GROUP(masked, HEALTH_BUMP, NUM_BUMP_SENSORS);
+		break;
+
+	case TAPE:
+		bits = HEALTH_GROUP(masked, HEALTH_TAPE, NUM_TAPE_SENSORS);
+		break;
+
+	case DISTANCE:
+		bits = HEALTH_GROUP(masked, HEALTH_DIST, NUM_DIST_SENSORS);
+		break;
+
+	case BEACON_FOUND:
+	case BEACON_LOST:
+		return !(EventData.val & HEALTH_GROUP(masked, HEALTH_BEACON,
+			NUM_LIGHT_SENSORS));
+
+	case TRACK_FOUND:
+	case TRACK_LOST:
+		return !(masked & (1UL << HEALTH_TRACK));
+
+	default:
+		return TRUE;
+	}
+
+	EventData.bits.event &= ~bits;
+	EventData.bits.type &= ~bits;
+	ThisEvent->EventParam = EventData.val;
+	return EventData.bits.event != 0x00;
+}
+
+/**
+ * @Function StepMux(uint8_t *endedGroups)
+ * @param endedGroups - set to the groups of the pass that just ended, 0 if
+ *                      the step stays in the same pass
+ * @return None
+ * @brief Moves muxStep on to the next select in muxOrder the pass needs
+ * @author rcrobert */
+static void StepMux(uint8_t *endedGroups)
+{
+	*endedGroups = 0x00;
+	++passSteps;
+	do {
+		if (++muxStep >= MAX_MUX_SEL) {
+			muxStep = 0;
+			*endedGroups = passGroups;
+			StartPass();
+		}
+	} while (!(passSelects & (1 << muxOrder[muxStep])));
+}
+
+/**
+ * @Function StartPass(void)
+ * @return None
+ * @brief Picks the groups and selects of the next pass from scanProfile
+ * @author rcrobert */
+static void StartPass(void)
+{
+	const ScanProfile *profile = scanProfile;
+	uint8_t selects = 0x00;
+
+	muxStats.passes++;
+	muxStats.lastPassSteps = passSteps;
+	passSteps = 0;
+
+	passGroups = profile->groups;
+	if (profile->slowEvery &&
+		(((muxStats.passes >> 1) % profile->slowEvery) == 0)) {
+		passGroups |= profile->slowGroups;
+	}
+
+	if (passGroups & SCAN_GROUP_BUMP) {
+		selects |= SCAN_SELECTS_BUMP;
+	}
+	if (passGroups & SCAN_GROUP_BEACON) {
+		selects |= SCAN_SELECTS_BEACON;
+	}
+	if (passGroups & SCAN_GROUP_TAPE) {
+		selects |= SCAN_SELECTS_TAPE;
+	}
+	if (passGroups & SCAN_GROUP_DIST) {
+		selects |= SCAN_SELECTS_DIST;
+	}
+
+	// Nothing on the mux wanted, keep stepping one select for the A/D
+	passSelects = selects ? selects : (1 << muxOrder[0]);
+	muxStats.skippedSelects += MAX_MUX_SEL - __builtin_popcount(passSelects);
+}
+
+/**
+ * @Function TriggerMuxScan(void)
+ * @return None
+ * @brief Starts the A/D on the new select once it has settled. Fails quietly
+ *        when the A/D is free running, the reads then take what is there
+ * @author rcrobert */
+static void TriggerMuxScan(void)
+{
+	muxScan = AD_ReadSequence() + 1;
+	muxScanTriggered = (AD_TriggerScan(MUX_SETTLE_US) == SUCCESS);
+}
+
+/**
+ * @Function MuxScanReady(void)
+ * @return TRUE if the A/D values are from the select being read
+ * @author rcrobert */
+static char MuxScanReady(void)
+{
+	if (!muxScanTriggered || (AD_ReadSequence() == muxScan)) {
+		return TRUE;
+	}
+	muxStats.staleScans++;
+	return FALSE;
+}
+
 
 /*******************************************************************************
  * TEST HARNESS                                                                *
@@ -24,6 +24,7 @@
 
 #include "BotConfig.h"
 #include "ES_Configure.h"
+#include "MotorDriver.h"
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                             *
@@ -32,6 +33,24 @@
 // Possibly change to a real function wrapper to be type safe
 #define PostToMainHSM(x) (PostTopHSM(x))
 
+// Distance sensors read as nothing at all further than this, mm
+#define DIST_MM_MAX 800
+
+// Bit of an ES_EventTyp_t in ScanProfile events
+#define EVENT_BIT(type) (1UL << (type))
+#define EVENT_ALL 0xFFFFFFFFUL
+
+// Sensor groups for scan profiles. The track wire is off the mux and is read
+// every step whatever the profile
+#define SCAN_GROUP_BUMP 0x01
+#define SCAN_GROUP_BEACON 0x02
+#define SCAN_GROUP_TAPE 0x04
+#define SCAN_GROUP_DIST 0x08
+#define SCAN_GROUP_ALL 0x0F
+
+// Reflex hold that follows TIME_REFLEX_HOLD or TIME_REFLEX_BACKOFF
+#define REFLEX_HOLD_PARAM 0xFFFFFFFFU
+
 /*******************************************************************************
  * PUBLIC VARIABLES
  ******************************************************************************/
@@ -50,6 +69,66 @@ typedef union {
     uint16_t val;
 } EventStorage;
 
+// Bump reflex timing, all in microseconds
+typedef struct {
+    uint32_t trips;
+    uint32_t lastDetectToStop;  // edge seen in the scan to motors written
+    uint32_t maxDetectToStop;
+    uint32_t lastBumpToStop;    // last clear sample to motors written, upper
+    uint32_t maxBumpToStop;     // bound on the real bump to stop latency
+} BumpReflexStats;
+
+// Sensor state as the HSMs have been told it, one bit per sensor
+typedef struct {
+    uint8_t bump;       // closed
+    uint8_t tape;       // on tape
+    uint8_t beacon;     // beacon seen
+    uint8_t track;      // track wire found
+    uint8_t near;       // distance sensor under THRESHOLD_DIST_NEAR
+} SensorSnapshot;
+
+// Mux stepping, ticks are core timer ticks of the select write alone
+typedef struct {
+    uint32_t steps;
+    uint32_t lineToggles;       // select lines moved, 8 a pass in Gray order
+    uint32_t multiLineSteps;    // steps that moved more than one line at once
+    uint32_t lastTicks;
+    uint32_t maxTicks;
+    uint32_t staleScans;        // reads skipped, the triggered scan was late
+    uint32_t passes;            // times through the scan order
+    uint32_t skippedSelects;    // selects a scan profile left out of a pass
+    uint8_t lastPassSteps;      // steps the last pass took, 8 for a full scan
+} MuxStats;
+
+/*
+ * What a state needs from the sensor scan. groups are scanned every pass,
+ * slowGroups come along on a pair of passes out of every slowEvery pairs,
+ * the pair gives the tape an LED off and an LED on pass. Selects no group
+ * in the pass needs are skipped, so a pass over the bumpers alone is half
+ * as long as the full scan.
+ *
+ * events are the EVENT_BIT()s of the sensor events the state handles, the
+ * rest only update the snapshot and are never queued
+ *
+ * noReflex are the BUMP_* bits whose bump reflex is off, for states that push
+ * into a wall on purpose. Left out of an initializer it is 0, every reflex on
+ */
+typedef struct {
+    uint8_t groups;
+    uint8_t slowGroups;
+    uint8_t slowEvery;
+    uint32_t events;
+    uint8_t noReflex;
+} ScanProfile;
+
+// Sensor events since EventChecker_ClearEventStats
+typedef struct {
+    uint32_t posted;
+    uint32_t suppressed;    // left out by the state's events
+    uint32_t masked;        // only from channels SensorHealth flagged
+    uint32_t failed;        // the HSM queue was full
+} SensorEventStats;
+
 /*
 #define LIST_OF_EVENT_STATES(STATE) \
         STATE(NOT_READY_TO_READ)    \
@@ -101,6 +180,91 @@ uint8_t PostEventCheckerService(ES_Event ThisEvent);
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 ES_Event RunEventCheckerService(ES_Event ThisEvent);
 
+/**
+ * @Function EventChecker_SetBumpReflex(uint8_t bumpMask, DriveReflex_t action,
+ *           unsigned int holdMs)
+ * @param bumpMask - bumpers to configure, BUMP_* bits
+ * @param action - reflex to run when one of them closes
+ * @param holdMs - time the reflex holds the motors, see Drive_Reflex.
+ *                 REFLEX_HOLD_PARAM reads the action's parameter each time it
+ *                 fires
+ * @return None
+ * @brief Reflexes run inside the scan step that sees the bump, before BUMPER
+ *        is posted. Defaults come from REFLEX_BUMP_* in BotConfig.h
+ * @author rcrobert */
+void EventChecker_SetBumpReflex(uint8_t bumpMask, DriveReflex_t action,
+        unsigned int holdMs);
+
+/**
+ * @Function EventChecker_GetReflexStats(BumpReflexStats *stats)
+ * @param stats - filled with the latency counters
+ * @return None
+ * @brief Bump to motor stop latency of the reflex path
+ * @author rcrobert */
+void EventChecker_GetReflexStats(BumpReflexStats *stats);
+
+/**
+ * @Function EventChecker_GetSnapshot(SensorSnapshot *snapshot)
+ * @param snapshot - filled with the current sensor bits
+ * @return None
+ * @brief Updated on the same edges that post BUMPER, TAPE, BEACON_*,
+ *        TRACK_* and DISTANCE, so it always agrees with the events already
+ *        sent. Channels SensorHealth has masked read inactive
+ * @author rcrobert */
+void EventChecker_GetSnapshot(SensorSnapshot *snapshot);
+
+/**
+ * @Function EventChecker_GetMuxStats(MuxStats *stats)
+ * @param stats - filled with the mux step counters
+ * @return None
+ * @brief Every step is one store, multiLineSteps only counts how often more
+ *        than one line had to move, binary order does it on half the steps
+ * @author rcrobert */
+void EventChecker_GetMuxStats(MuxStats *stats);
+
+/**
+ * @Function EventChecker_SetScanProfile(const ScanProfile *profile)
+ * @param profile - scan wanted from the next pass on, NULL for the full scan.
+ *                  Kept by pointer, so it has to stay put
+ * @return None
+ * @brief States set theirs on ES_ENTRY and NULL on ES_EXIT, a state that
+ *        declares nothing then gets the full scan and every event. Sensors
+ *        left out of a pass keep their last state and post nothing until
+ *        scanned again. An edge the state filters out is not sent later,
+ *        the next state reads it from the snapshot if it needs it
+ * @author rcrobert */
+void EventChecker_SetScanProfile(const ScanProfile *profile);
+
+/**
+ * @Function EventChecker_GetEventStats(SensorEventStats *stats)
+ * @param stats - filled with the posted and suppressed counts
+ * @return None
+ * @author rcrobert */
+void EventChecker_GetEventStats(SensorEventStats *stats);
+
+/**
+ * @Function EventChecker_ClearEventStats(void)
+ * @return None
+ * @author rcrobert */
+void EventChecker_ClearEventStats(void);
+
+/**
+ * @Function EventChecker_GetTrackStrength(void)
+ * @return Track wire envelope in A/D counts of carrier amplitude, updated
+ *         every scan step. TRACK_FOUND and TRACK_LOST carry it as the param
+ * @author rcrobert */
+uint16_t EventChecker_GetTrackStrength(void);
+
+/**
+ * @Function EventChecker_GetDistances(uint16_t *mm)
+ * @param mm - NUM_DIST_SENSORS entries, filled with the filtered distance of
+ *             each sensor, indexed by mux select
+ * @return None
+ * @brief Each sensor updates once a mux pass. DIST_MM_MAX means nothing in
+ *        range. DISTANCE events only go out on the thresholds
+ * @author rcrobert */
+void EventChecker_GetDistances(uint16_t *mm);
+
 
 
 #endif /* EVENTCHECKERSERVICE_H */
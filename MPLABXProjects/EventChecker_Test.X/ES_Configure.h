@@ -52,6 +52,7 @@
     EVENT(TAPE) /* Tape sensors changed */ \
     EVENT(TRACK_FOUND) /* Track wire found signal */ \
     EVENT(TRACK_LOST) /* Track wire lost signal */ \
+    EVENT(DISTANCE) /* Distance sensors crossed near or far */ \
     EVENT(CHILD_DONE) /* Sub state machine completed its task */ \
     
 // This turns the EVENT_NAMES list into an enum statement
@@ -75,7 +76,7 @@ static const char *EventNames[] = {
 
 /****************************************************************************/
 // This is the list of event checking functions
-#define EVENT_CHECK_LIST
+#define EVENT_CHECK_LIST Drive_Update, BotParams_Update, DebugLog_Update
 
 /****************************************************************************/
 // These are the definitions for the post functions to be executed when the
@@ -276,6 +276,7 @@ Example:
 #include <xc.h>
 #include <serial.h>
 #include "BotConfig.h"
+#include "BotParams.h"
 
 void main(void)
 {
@@ -289,6 +290,7 @@ void main(void)
 
 	// Your hardware initialization function calls go here
 	Bot_Init();
+	BotParams_Init();
 	Drive_Init();
 	Drive_LiftStop();
 
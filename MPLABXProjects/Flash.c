@@ -0,0 +1,132 @@
+/*
+ * File:   Flash.c
+ * Author: rcrobert
+ *
+ * Program flash self programming. See Flash.h
+ *
+ * Created on December 11, 2014, 4:05 PM
+ */
+
+#include <string.h>
+#include "Flash.h"
+
+#ifdef FLASH_HOST
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef SUCCESS
+#define SUCCESS 1
+#define ERROR -1
+#endif
+#else
+#include <xc.h>
+#include <plib.h>
+#include <BOARD.h>
+#endif
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+char Flash_ErasePage(const void *page)
+{
+	if (((uintptr_t) page & (FLASH_PAGE_SIZE - 1)) != 0) {
+		return ERROR;
+	}
+
+#ifdef FLASH_HOST
+	memset((void *) page, 0xFF, FLASH_PAGE_SIZE);
+#else
+	// Nonzero is one of the NVMCON error bits
+	if (NVMErasePage((void *) page) != 0) {
+		return ERROR;
+	}
+#endif
+	return SUCCESS;
+}
+
+char Flash_Write(const void *address, const void *data, unsigned int length)
+{
+	const uint8_t *in = data;
+	uint32_t *out = (uint32_t *) address;
+	uint32_t word;
+
+	if ((((uintptr_t) address | length) & 0x03) != 0) {
+		return ERROR;
+	}
+
+	for (; length != 0; length -= 4) {
+		// Source may be unaligned, the destination never is
+		memcpy(&word, in, 4);
+#ifdef FLASH_HOST
+		// Programming only ever pulls bits low
+		*out &= word;
+#else
+		if (NVMWriteWord(out, word) != 0) {
+			return ERROR;
+		}
+#endif
+		if (Flash_ReadWord(out) != word) {
+			return ERROR;
+		}
+		in += 4;
+		++out;
+	}
+	return SUCCESS;
+}
+
+void Flash_Read(void *data, const void *address, unsigned int length)
+{
+	const volatile uint32_t *in = address;
+	uint8_t *out = data;
+	uint32_t word;
+
+	for (; length >= 4; length -= 4) {
+		word = *in++;
+		memcpy(out, &word, 4);
+		out += 4;
+	}
+}
+
+uint32_t Flash_ReadWord(const void *address)
+{
+	return *(const volatile uint32_t *) address;
+}
+
+#ifdef FLASH_HOST
+
+void *Flash_HostMap(const char *path, unsigned int pages)
+{
+	static const uint8_t erased[FLASH_PAGE_SIZE] = {[0 ... FLASH_PAGE_SIZE - 1] = 0xFF};
+	size_t size = (size_t) pages * FLASH_PAGE_SIZE;
+	struct stat info;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	// A new or short file is grown with erased pages, not zeros
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return NULL;
+	}
+	while ((size_t) info.st_size < size) {
+		if (pwrite(fd, erased, FLASH_PAGE_SIZE, info.st_size) != FLASH_PAGE_SIZE) {
+			close(fd);
+			return NULL;
+		}
+		info.st_size += FLASH_PAGE_SIZE;
+	}
+
+	// mmap hands back page aligned memory, the same alignment FLASH_RESERVE has
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return (map == MAP_FAILED) ? NULL : map;
+}
+
+#endif
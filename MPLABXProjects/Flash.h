@@ -0,0 +1,109 @@
+/*
+ * File:   Flash.h
+ * Author: rcrobert
+ *
+ * Self programming of the PIC32 program flash. Storage is reserved with
+ * FLASH_RESERVE so the linker keeps code out of it, it reads like any const
+ * array and is changed through Flash_ErasePage and Flash_Write.
+ *
+ * Erasing a page takes about 20ms and writing a word about 20us, the CPU
+ * stalls for the whole time since it runs from the same flash. Interrupts are
+ * held off for the unlock sequence only, anything that fires during the stall
+ * runs late. Only program flash while the bot is stopped.
+ *
+ * Building with FLASH_HOST swaps in a PC emulation with the same rules: an
+ * erase sets a page to all ones, a write can only clear bits and fails if the
+ * word does not read back. Flash_HostMap backs the storage with a file so it
+ * survives between runs and can be inspected afterwards.
+ *
+ * Created on December 11, 2014, 4:05 PM
+ */
+
+#ifndef FLASH_H
+#define	FLASH_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// PIC32MX3xx erase unit
+#define FLASH_PAGE_SIZE 4096
+#define FLASH_PAGE_WORDS (FLASH_PAGE_SIZE / 4)
+
+// Erased flash reads as all ones
+#define FLASH_ERASED 0xFFFFFFFF
+
+// The emulation writes to the storage, the real thing lives in const flash
+#ifdef FLASH_HOST
+#define FLASH_CONST
+#else
+#define FLASH_CONST const
+#endif
+
+/*
+ * Declares page aligned, erased storage in program flash:
+ * FLASH_RESERVE(paramStore, 1);
+ * Reads must go through Flash_Read or Flash_ReadWord, otherwise the compiler
+ * is free to assume the array still holds FLASH_ERASED.
+ */
+#define FLASH_RESERVE(name, pages) \
+    FLASH_CONST uint32_t __attribute__((aligned(FLASH_PAGE_SIZE))) \
+    name[(pages) * FLASH_PAGE_WORDS] = \
+    {[0 ... ((pages) * FLASH_PAGE_WORDS) - 1] = FLASH_ERASED}
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function Flash_ErasePage(const void *page)
+ * @param page - Start of a page inside FLASH_RESERVE storage
+ * @return ERROR if the page is not aligned or the erase failed
+ * @author rcrobert 2014.12.11
+ */
+char Flash_ErasePage(const void *page);
+
+/**
+ * @Function Flash_Write(const void *address, const void *data, unsigned int length)
+ * @param address - Word aligned destination in erased flash
+ * @param data - Bytes to program
+ * @param length - Multiple of 4
+ * @return ERROR if anything is misaligned or a word did not verify
+ * @brief Bits can only be cleared, write each word once per erase
+ * @author rcrobert 2014.12.11
+ */
+char Flash_Write(const void *address, const void *data, unsigned int length);
+
+/**
+ * @Function Flash_Read(void *data, const void *address, unsigned int length)
+ * @param data - Filled with length bytes
+ * @param address - Word aligned source in flash
+ * @param length - Multiple of 4
+ * @return None
+ * @author rcrobert 2014.12.11
+ */
+void Flash_Read(void *data, const void *address, unsigned int length);
+
+/**
+ * @Function Flash_ReadWord(const void *address)
+ * @param address - Word aligned
+ * @return The word as it is in flash now
+ * @author rcrobert 2014.12.11
+ */
+uint32_t Flash_ReadWord(const void *address);
+
+#ifdef FLASH_HOST
+/**
+ * @Function Flash_HostMap(const char *path, unsigned int pages)
+ * @param path - File holding the emulated flash, created erased if missing
+ * @param pages - Size of the file in pages
+ * @return Page aligned start of the mapping, NULL if it could not be opened
+ * @brief PC builds only. Writes go straight to the file
+ * @author rcrobert 2014.12.12
+ */
+void *Flash_HostMap(const char *path, unsigned int pages);
+#endif
+
+#endif	/* FLASH_H */
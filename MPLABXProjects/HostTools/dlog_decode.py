@@ -0,0 +1,201 @@
+#!/usr/bin/env python
+"""
+dlog_decode.py - turns DebugLog records from the bot back into text
+
+The bot only sends the flash address of each format string and the raw
+argument words, see DebugLog.h. The strings are looked up in the .elf that
+was flashed, so always pass the matching build.
+
+Anything that is not a valid record is passed through as plain text, so
+regular printf output on the same UART still shows up.
+
+    python dlog_decode.py dist/default/production/Complete_HSM.X.production.elf capture.bin
+    python dlog_decode.py Complete_HSM.X.production.elf --port COM4
+
+Reading a serial port needs pyserial, files and stdin ("-") need nothing
+extra.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+DLOG_MARKER = 0xD0
+DLOG_MAX_ARGS = 8
+DLOG_SECTION = ".dlog_fmt"
+
+SHF_ALLOC = 0x2
+SHT_PROGBITS = 1
+
+CONVERSION = re.compile(
+    r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf(object):
+    """Just enough ELF to find initialized sections by address"""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+
+        if data[:4] != b"\x7fELF":
+            raise ValueError("%s is not an ELF file" % path)
+
+        is64 = (data[4] == 2)
+        endian = "<" if data[5] == 1 else ">"
+        if is64:
+            shoff, = struct.unpack_from(endian + "Q", data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", data, 0x3A)
+            layout = endian + "IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from(endian + "I", data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", data, 0x2E)
+            layout = endian + "IIIIIIIIII"
+
+        headers = [struct.unpack_from(layout, data, shoff + i * shentsize)
+                   for i in range(shnum)]
+        names = headers[shstrndx]
+        names = data[names[4]:names[4] + names[5]]
+
+        # name, flags, address, contents for every section loaded to memory
+        self.sections = []
+        for h in headers:
+            name_off, sh_type, flags, addr, offset, size = h[:6]
+            if sh_type != SHT_PROGBITS or not (flags & SHF_ALLOC) or size == 0:
+                continue
+            name = names[name_off:names.index(b"\0", name_off)].decode()
+            self.sections.append((name, addr, data[offset:offset + size]))
+
+    def read_string(self, address):
+        for _, start, contents in self.sections:
+            if start <= address < start + len(contents):
+                off = address - start
+                end = contents.find(b"\0", off)
+                if end < 0:
+                    end = len(contents)
+                return contents[off:end].decode("latin-1")
+        return None
+
+    def formats(self):
+        """Address of every string in the format section"""
+        table = {}
+        for name, start, contents in self.sections:
+            if name != DLOG_SECTION:
+                continue
+            # Strings can be padded for alignment, skip the gaps
+            off = 0
+            while off < len(contents):
+                if contents[off] == 0:
+                    off += 1
+                    continue
+                end = contents.find(b"\0", off)
+                if end < 0:
+                    end = len(contents)
+                table[start + off] = contents[off:end].decode("latin-1")
+                off = end + 1
+        return table
+
+
+def render(fmt, args, elf):
+    """printf with the arguments as 32 bit words"""
+    args = list(args)
+
+    def take():
+        return args.pop(0) if args else 0
+
+    def convert(match):
+        flags, width, precision, conv = match.groups()
+        if conv == "%":
+            return "%"
+        if width == "*":
+            width = str(struct.unpack("<i", struct.pack("<I", take()))[0])
+        if precision == "*":
+            precision = str(take())
+        spec = "%" + flags + (width or "") + ("." + precision if precision else "")
+
+        word = take()
+        if conv in "di":
+            return (spec + "d") % struct.unpack("<i", struct.pack("<I", word))[0]
+        if conv in "ouxX":
+            return (spec + conv) % word
+        if conv == "c":
+            return (spec + "c") % chr(word & 0xFF)
+        if conv == "p":
+            return "0x%08x" % word
+        text = elf.read_string(word)
+        return (spec + "s") % (text if text is not None else "<0x%08x>" % word)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+class Decoder(object):
+    def __init__(self, elf):
+        self.elf = elf
+        self.formats = elf.formats()
+        self.pending = bytearray()
+
+    def feed(self, data):
+        """Returns the text for every complete record or plain byte in data"""
+        self.pending.extend(data)
+        out = []
+        i = 0
+        buf = self.pending
+
+        while i < len(buf):
+            b = buf[i]
+            argc = b & 0x0F
+            if (b & 0xF0) == DLOG_MARKER and argc <= DLOG_MAX_ARGS:
+                size = 5 + 4 * argc
+                if len(buf) - i < size:
+                    break   # rest of the record is still on the way
+                address, = struct.unpack_from("<I", buf, i + 1)
+                fmt = self.formats.get(address)
+                if fmt is not None:
+                    words = struct.unpack_from("<%dI" % argc, buf, i + 5)
+                    out.append(render(fmt, words, self.elf))
+                    i += size
+                    continue
+            out.append(chr(b))
+            i += 1
+
+        del buf[:i]
+        return "".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("elf", help="firmware the bot is running")
+    parser.add_argument("capture", nargs="?", default="-",
+                        help="raw capture file, - for stdin")
+    parser.add_argument("--port", help="read a serial port instead")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf))
+    if not decoder.formats:
+        sys.stderr.write("No %s section, was DLOG used in this build?\n" % DLOG_SECTION)
+
+    if args.port:
+        import serial
+        source = serial.Serial(args.port, args.baud, timeout=0.1)
+    elif args.capture == "-":
+        source = getattr(sys.stdin, "buffer", sys.stdin)
+    else:
+        source = open(args.capture, "rb")
+
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if args.port:
+                    continue
+                break
+            sys.stdout.write(decoder.feed(data))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
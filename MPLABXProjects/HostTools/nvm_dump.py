@@ -0,0 +1,196 @@
+#!/usr/bin/env python
+"""
+nvm_dump.py - lists the Nvm records in a flash image and prints black boxes
+
+Takes the file a FLASH_HOST build maps, or an Intel HEX read back from the
+bot with the programmer. Any page aligned page that starts with the Nvm magic
+is used, so a read of the whole program flash works without knowing where
+the linker put the storage. See Nvm.h and BlackBox.h for the layouts.
+
+    python nvm_dump.py readback.hex
+    python nvm_dump.py readback.hex --names Complete_HSM.X/ES_Configure.h
+    python nvm_dump.py nvm_test.bin --all
+
+--names reads EVENT_NAMES from ES_Configure.h so events print by name, and
+LIST_OF_TOP_STATES from the TopHSM.h next to it.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+PAGE_SIZE = 4096
+NVM_MAGIC = 0x314D564E
+ERASED = 0xFFFFFFFF
+TYPE_BLACKBOX = 0x80
+
+TYPE_NAMES = {
+    0x01: "CAL_TAPE",
+    0x02: "CAL_BEACON",
+    0x03: "CAL_ODOMETRY",
+    TYPE_BLACKBOX: "BLACKBOX",
+}
+
+REASONS = ["request", "undervoltage", "exception"]
+
+BLACKBOX_VERSION = 1
+BLACKBOX_HEADER = struct.Struct("<BBHIIII")
+BLACKBOX_ENTRY = struct.Struct("<HHBBBx")
+BLACKBOX_ENTRIES = 256
+
+# MIPS Cause.ExcCode
+EXCEPTIONS = {
+    0: "interrupt", 1: "TLB modify", 2: "TLB load", 3: "TLB store",
+    4: "address error on load", 5: "address error on store",
+    6: "bus error on fetch", 7: "bus error on data", 8: "syscall",
+    9: "breakpoint", 10: "reserved instruction", 11: "coprocessor unusable",
+    12: "arithmetic overflow", 13: "trap",
+}
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, same as the bot"""
+    for b in bytearray(data):
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def read_hex(path):
+    """Returns {page address: bytearray}, unprogrammed bytes read as 0xFF"""
+    pages = {}
+    base = 0
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith(":"):
+                continue
+            raw = bytearray.fromhex(line[1:])
+            count, address, kind = raw[0], (raw[1] << 8) | raw[2], raw[3]
+            data = raw[4:4 + count]
+            if kind == 0x04:
+                base = ((data[0] << 8) | data[1]) << 16
+            elif kind == 0x02:
+                base = ((data[0] << 8) | data[1]) << 4
+            elif kind == 0x00:
+                for i, b in enumerate(data):
+                    where = base + address + i
+                    page = where & ~(PAGE_SIZE - 1)
+                    if page not in pages:
+                        pages[page] = bytearray(b"\xff" * PAGE_SIZE)
+                    pages[page][where - page] = b
+    return pages
+
+
+def read_raw(path):
+    with open(path, "rb") as f:
+        data = bytearray(f.read())
+    return dict((i, data[i:i + PAGE_SIZE])
+                for i in range(0, len(data) - PAGE_SIZE + 1, PAGE_SIZE))
+
+
+def records(page):
+    """Yields (offset, type, data, crc ok) for each record in a page"""
+    offset = 8
+    while offset + 8 <= PAGE_SIZE:
+        first, second = struct.unpack_from("<II", page, offset)
+        if first == ERASED:
+            return
+        kind, length = first & 0xFFFF, first >> 16
+        words = 2 + (length + 3) // 4
+        if ((second >> 16) ^ 0xFFFF) != length or offset + words * 4 > PAGE_SIZE:
+            return
+        data = bytes(page[offset + 8:offset + 8 + length])
+        ok = crc16(data, crc16(page[offset:offset + 4])) == (second & 0xFFFF)
+        yield offset, kind, data, ok
+        offset += words * 4
+
+
+def load_names(configure):
+    """Event and top state names from the project headers, empty if missing"""
+    events, states = [], []
+    try:
+        with open(configure) as f:
+            text = f.read()
+        block = text[text.index("#define EVENT_NAMES"):]
+        block = block[:block.index("\n\n")]
+        events = re.findall(r"EVENT\((\w+)\)", block)
+        with open(os.path.join(os.path.dirname(configure), "TopHSM.h")) as f:
+            text = f.read()
+        block = text[text.index("#define LIST_OF_TOP_STATES"):]
+        block = block[:block.index("\n\n")]
+        states = re.findall(r"STATE\((\w+)\)", block)
+    except (IOError, ValueError):
+        pass
+    return events, states
+
+
+def name(names, index):
+    return names[index] if index < len(names) else str(index)
+
+
+def print_blackbox(data, events, states):
+    if len(data) < BLACKBOX_HEADER.size or data[0] != BLACKBOX_VERSION:
+        print("    not a version %d black box" % BLACKBOX_VERSION)
+        return
+    version, reason, oldest, count, saved, cause, epc = \
+        BLACKBOX_HEADER.unpack_from(data)
+    print("    saved at %u ms, %s, %u events recorded" %
+          (saved, REASONS[reason] if reason < len(REASONS) else reason, count))
+    if reason == 2:
+        code = (cause >> 2) & 0x1F
+        print("    cause 0x%08X (%s), EPC 0x%08X" %
+              (cause, EXCEPTIONS.get(code, "code %d" % code), epc))
+
+    used = min(count, BLACKBOX_ENTRIES)
+    for i in range(used):
+        index = (oldest + i) % BLACKBOX_ENTRIES
+        time, param, event, top, sub = BLACKBOX_ENTRY.unpack_from(
+            data, BLACKBOX_HEADER.size + index * BLACKBOX_ENTRY.size)
+        print("    %5u  %-16s 0x%04X  %-14s %u" %
+              (time, name(events, event), param, name(states, top), sub))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("image", help="Intel HEX or raw flash image")
+    parser.add_argument("--names", help="ES_Configure.h for event names")
+    parser.add_argument("--all", action="store_true",
+                        help="print every black box, not just the newest")
+    args = parser.parse_args()
+
+    if args.image.lower().endswith(".hex"):
+        pages = read_hex(args.image)
+    else:
+        pages = read_raw(args.image)
+    events, states = load_names(args.names) if args.names else ([], [])
+
+    found = []
+    for address in sorted(pages):
+        magic, generation = struct.unpack_from("<II", pages[address])
+        if magic == NVM_MAGIC:
+            found.append((generation, address))
+    if not found:
+        sys.exit("no Nvm pages in %s" % args.image)
+
+    boxes = []
+    for generation, address in sorted(found):
+        print("page 0x%08X generation %u" % (address, generation))
+        for offset, kind, data, ok in records(pages[address]):
+            print("  +%04X %-12s %5u bytes%s" % (
+                offset, TYPE_NAMES.get(kind, "type 0x%02X" % kind), len(data),
+                "" if ok else "  BAD CRC"))
+            if kind == TYPE_BLACKBOX and ok:
+                boxes.append(data)
+
+    for data in (boxes if args.all else boxes[-1:]):
+        print("\nblack box")
+        print_blackbox(data, events, states)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,257 @@
+#!/usr/bin/env python
+"""
+telemetry_record.py - records Telemetry frames from the bot into columns
+
+Each field of the frame goes into its own memory mapped file in the output
+directory, one fixed size little endian value per frame, so a run can be
+loaded straight into numpy without parsing anything:
+
+    import json, numpy
+    meta = json.load(open("run1/columns.json"))
+    cols = {c["name"]: numpy.memmap("run1/" + c["file"], dtype=c["dtype"],
+                                    mode="r", shape=(meta["rows"],))
+            for c in meta["columns"]}
+
+columns.json is rewritten every second, so a recording can be read while it
+is still running. host_time is seconds since the epoch when the frame was
+decoded. See Telemetry.h for the frame format.
+
+    python telemetry_record.py run1 --port COM4
+    python telemetry_record.py run1 capture.bin
+
+Reading a serial port needs pyserial, files and stdin ("-") need nothing
+extra.
+"""
+
+import argparse
+import json
+import mmap
+import os
+import struct
+import sys
+import time
+
+TELEMETRY_VERSION = 2
+
+# name, struct code, numpy dtype, in payload order
+FIELDS = [
+    ("version", "B", "u1"),
+    ("sequence", "B", "u1"),
+    ("time_ms", "I", "<u4"),
+    ("bump", "B", "u1"),
+    ("tape", "B", "u1"),
+    ("beacon", "B", "u1"),
+    ("track", "B", "u1"),
+    ("left_command", "h", "<i2"),
+    ("right_command", "h", "<i2"),
+    ("battery", "H", "<u2"),
+    ("top_state", "B", "u1"),
+    ("exit_state", "B", "u1"),
+    ("search_state", "B", "u1"),
+    ("approach_state", "B", "u1"),
+    ("return_state", "B", "u1"),
+    ("ram_state", "B", "u1"),
+    ("queue0", "B", "u1"),
+    ("queue1", "B", "u1"),
+    ("queue2", "B", "u1"),
+    ("queue3", "B", "u1"),
+    ("skipped", "H", "<u2"),
+    ("health_stuck", "I", "<u4"),
+    ("health_saturated", "I", "<u4"),
+    ("health_dead", "I", "<u4"),
+    ("health_channel", "B", "u1"),
+    ("health_flags", "B", "u1"),
+    ("health_mean", "h", "<i2"),
+    ("health_variance", "H", "<u2"),
+    ("health_edges", "B", "u1"),
+    ("health_window_ms", "H", "<u2"),
+]
+PAYLOAD = struct.Struct("<" + "".join(code for _, code, _ in FIELDS))
+HOST_TIME = ("host_time", "d", "<f8")
+
+# Rows added to every column file each time one fills up
+GROW_ROWS = 4096
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, same as the bot"""
+    crc = 0xFFFF
+    for b in bytearray(data):
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """Returns the decoded bytes, None if the encoding is broken"""
+    out = bytearray()
+    i = 0
+    data = bytearray(data)
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out.extend(data[i + 1:i + code])
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Column(object):
+    def __init__(self, directory, name, code, dtype):
+        self.name = name
+        self.dtype = dtype
+        self.file = name + ".bin"
+        self.format = struct.Struct("<" + code)
+        self.handle = open(os.path.join(directory, self.file), "w+b")
+        self.capacity = 0
+        self.map = None
+
+    def put(self, row, value):
+        if row >= self.capacity:
+            self.grow(row + GROW_ROWS)
+        self.format.pack_into(self.map, row * self.format.size, value)
+
+    def grow(self, rows):
+        if self.map is not None:
+            self.map.close()
+        self.handle.truncate(rows * self.format.size)
+        self.map = mmap.mmap(self.handle.fileno(), rows * self.format.size)
+        self.capacity = rows
+
+    def close(self, rows):
+        if self.map is not None:
+            self.map.close()
+        # Trim the unused tail so the file is exactly the data
+        self.handle.truncate(rows * self.format.size)
+        self.handle.close()
+
+
+class Recorder(object):
+    def __init__(self, directory):
+        if not os.path.isdir(directory):
+            os.makedirs(directory)
+        self.directory = directory
+        self.columns = [Column(directory, *field) for field in FIELDS]
+        self.columns.append(Column(directory, *HOST_TIME))
+        self.rows = 0
+        self.bad = 0
+        self.lost = 0
+        self.last_sequence = None
+        self.last_meta = 0
+
+    def add(self, body):
+        """Takes one decoded frame, payload plus CRC"""
+        if len(body) != PAYLOAD.size + 2:
+            self.bad += 1
+            return False
+        payload = body[:-2]
+        crc, = struct.unpack("<H", body[-2:])
+        if crc16(payload) != crc or bytearray(payload)[0] != TELEMETRY_VERSION:
+            self.bad += 1
+            return False
+
+        values = PAYLOAD.unpack(payload)
+        sequence = values[1]
+        if self.last_sequence is not None:
+            self.lost += (sequence - self.last_sequence - 1) & 0xFF
+        self.last_sequence = sequence
+
+        for column, value in zip(self.columns, values + (time.time(),)):
+            column.put(self.rows, value)
+        self.rows += 1
+
+        if time.time() - self.last_meta > 1.0:
+            self.write_meta()
+        return True
+
+    def write_meta(self):
+        meta = {
+            "version": TELEMETRY_VERSION,
+            "rows": self.rows,
+            "bad_frames": self.bad,
+            "lost_frames": self.lost,
+            "columns": [{"name": c.name, "file": c.file, "dtype": c.dtype}
+                        for c in self.columns],
+        }
+        path = os.path.join(self.directory, "columns.json")
+        with open(path + ".tmp", "w") as f:
+            json.dump(meta, f, indent=1)
+        # Windows will not rename over an existing file
+        if os.name == "nt" and os.path.exists(path):
+            os.remove(path)
+        os.rename(path + ".tmp", path)
+        self.last_meta = time.time()
+
+    def close(self):
+        self.write_meta()
+        for column in self.columns:
+            column.close(self.rows)
+
+
+class Deframer(object):
+    """Splits the byte stream on zeros, anything that is not a frame is dropped"""
+
+    def __init__(self, recorder):
+        self.recorder = recorder
+        self.pending = bytearray()
+
+    def feed(self, data):
+        self.pending.extend(data)
+        while True:
+            end = self.pending.find(b"\0")
+            if end < 0:
+                break
+            chunk = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if not chunk:
+                continue    # back to back delimiters
+            body = cobs_decode(chunk)
+            if body is None:
+                self.recorder.bad += 1
+            else:
+                self.recorder.add(body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("output", help="directory for the column files")
+    parser.add_argument("capture", nargs="?", default="-",
+                        help="raw capture file, - for stdin")
+    parser.add_argument("--port", help="read a serial port instead")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    recorder = Recorder(args.output)
+    deframer = Deframer(recorder)
+
+    if args.port:
+        import serial
+        source = serial.Serial(args.port, args.baud, timeout=0.1)
+    elif args.capture == "-":
+        source = getattr(sys.stdin, "buffer", sys.stdin)
+    else:
+        source = open(args.capture, "rb")
+
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if args.port:
+                    continue
+                break
+            deframer.feed(data)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        recorder.close()
+
+    sys.stderr.write("%d frames, %d bad, %d lost on the bot\n" %
+                     (recorder.rows, recorder.bad, recorder.lost))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,161 @@
+/*
+ * File:   IO_Pins.h
+ * Author: rcrobert
+ *
+ * Compile time versions of the IO_Ports calls, for pins that never move like
+ * the ones in BotConfig.h. The port and pattern have to be constants. Each
+ * write then becomes one store to LATxSET, LATxCLR or LATxINV for every PIC32
+ * port the pins land on, and a read is one load of PORTx per pin. Nothing is
+ * looked up at run time. IO_Ports.c stays for ports only known at run time.
+ *
+ *   IO_PinsSet(MOTOR_PINS_PORT, MOTOR_PINS_LEFT_DIR);    // LATDSET = 1 << 9
+ *   if (IO_PinsRead(SENSOR_PINS_PORT, SENSOR_PINS_BUMP)) // PORTB & 1 << 13
+ *
+ * Counted from the code at 40MHz, IO_PortsSetPortBits runs about 110 cycles,
+ * mostly the 10 pass loop in PortHandleHardwareIndirection, and
+ * IO_PortsReadPort about 60 assembling every pin of the port. The versions
+ * here are 3 to 4 instructions plus the peripheral bus access.
+ *
+ * Pins that share a PIC32 port can also be moved together in one store with
+ * IO_PINS_LAT, so no mix of old and new levels is ever driven. See the mux in
+ * EventCheckerService.c.
+ *
+ * Pin to register map is the PortsBits table in IO_Ports.c, keep them in step.
+ *
+ * Created on December 12, 2014, 4:30 PM
+ */
+
+#ifndef IO_PINS_H
+#define	IO_PINS_H
+
+#include <xc.h>
+#include <IO_Ports.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+/*
+ * Which PIC32 port and bit each header pin 3-12 is on. 0 is no such pin, V
+ * and W stop at pin 8.
+ */
+#define IO_PICK(n, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12) \
+    ((n) == 3 ? (p3) : (n) == 4 ? (p4) : (n) == 5 ? (p5) : (n) == 6 ? (p6) : \
+     (n) == 7 ? (p7) : (n) == 8 ? (p8) : (n) == 9 ? (p9) : (n) == 10 ? (p10) : \
+     (n) == 11 ? (p11) : (p12))
+
+#ifdef JP_SPI_MASTER
+#define IO_X7_BIT 7
+#define IO_X9_BIT 8
+#else
+#define IO_X7_BIT 8
+#define IO_X9_BIT 7
+#endif
+
+#define IO_PIN_PORT(port, n) \
+    ((port) == PORTV || (port) == PORTW ? \
+        IO_PICK(n, 'B', 'B', 'B', 'B', 'B', 'B', 0, 0, 0, 0) : \
+     (port) == PORTX ? \
+        IO_PICK(n, 'F', 'B', 'G', 'F', 'G', 'F', 'G', 'D', 'D', 'D') : \
+     (port) == PORTY ? \
+        IO_PICK(n, 'D', 'D', 'D', 'D', 'E', 'D', 'E', 'D', 'E', 'D') : \
+     (port) == PORTZ ? \
+        IO_PICK(n, 'E', 'F', 'E', 'D', 'E', 'D', 'E', 'F', 'E', 'F') : 0)
+
+#define IO_PIN_BIT(port, n) \
+    ((port) == PORTV ? IO_PICK(n, 2, 3, 4, 5, 8, 9, 0, 0, 0, 0) : \
+     (port) == PORTW ? IO_PICK(n, 11, 10, 13, 12, 15, 14, 0, 0, 0, 0) : \
+     (port) == PORTX ? IO_PICK(n, 5, 0, 6, 4, IO_X7_BIT, 6, IO_X9_BIT, 7, 4, 6) : \
+     (port) == PORTY ? IO_PICK(n, 11, 3, 5, 10, 7, 9, 6, 2, 5, 1) : \
+                       IO_PICK(n, 4, 1, 3, 0, 2, 8, 1, 3, 0, 2))
+
+// Bit pin n sets in PIC32 port reg, 0 if it is not in pattern or on reg
+#define IO_PIN_MASK(port, pattern, n, reg) \
+    ((((pattern) >> (n)) & 1) && IO_PIN_PORT(port, n) == (reg) ? \
+        (1u << IO_PIN_BIT(port, n)) : 0u)
+
+// Every bit pattern touches on PIC32 port reg
+#define IO_PINS_MASK(port, pattern, reg) \
+    (IO_PIN_MASK(port, pattern, 3, reg) | IO_PIN_MASK(port, pattern, 4, reg) | \
+     IO_PIN_MASK(port, pattern, 5, reg) | IO_PIN_MASK(port, pattern, 6, reg) | \
+     IO_PIN_MASK(port, pattern, 7, reg) | IO_PIN_MASK(port, pattern, 8, reg) | \
+     IO_PIN_MASK(port, pattern, 9, reg) | IO_PIN_MASK(port, pattern, 10, reg) | \
+     IO_PIN_MASK(port, pattern, 11, reg) | IO_PIN_MASK(port, pattern, 12, reg))
+
+// One store per PIC32 port, ports with nothing to do drop out at compile time
+#define IO_PINS_STORE(port, pattern, op) \
+    do { \
+        if (IO_PINS_MASK(port, pattern, 'B')) LATB##op = IO_PINS_MASK(port, pattern, 'B'); \
+        if (IO_PINS_MASK(port, pattern, 'D')) LATD##op = IO_PINS_MASK(port, pattern, 'D'); \
+        if (IO_PINS_MASK(port, pattern, 'E')) LATE##op = IO_PINS_MASK(port, pattern, 'E'); \
+        if (IO_PINS_MASK(port, pattern, 'F')) LATF##op = IO_PINS_MASK(port, pattern, 'F'); \
+        if (IO_PINS_MASK(port, pattern, 'G')) LATG##op = IO_PINS_MASK(port, pattern, 'G'); \
+    } while (0)
+
+// Every bit pattern touches, for pins known to share one PIC32 port
+#define IO_PINS_BITS(port, pattern) \
+    (IO_PINS_MASK(port, pattern, 'B') | IO_PINS_MASK(port, pattern, 'D') | \
+     IO_PINS_MASK(port, pattern, 'E') | IO_PINS_MASK(port, pattern, 'F') | \
+     IO_PINS_MASK(port, pattern, 'G'))
+
+// Number of PIC32 ports pattern lands on
+#define IO_PINS_PORTS(port, pattern) \
+    ((IO_PINS_MASK(port, pattern, 'B') != 0) + (IO_PINS_MASK(port, pattern, 'D') != 0) + \
+     (IO_PINS_MASK(port, pattern, 'E') != 0) + (IO_PINS_MASK(port, pattern, 'F') != 0) + \
+     (IO_PINS_MASK(port, pattern, 'G') != 0))
+
+// LATx, LATxSET, LATxCLR or LATxINV of the one port pattern is on
+#define IO_PINS_LAT(port, pattern, op) \
+    (*(IO_PINS_MASK(port, pattern, 'B') ? &LATB##op : \
+       IO_PINS_MASK(port, pattern, 'D') ? &LATD##op : \
+       IO_PINS_MASK(port, pattern, 'E') ? &LATE##op : \
+       IO_PINS_MASK(port, pattern, 'F') ? &LATF##op : &LATG##op))
+
+#define IO_PIN_READ(port, pattern, n) \
+    ((((pattern) >> (n)) & 1) && \
+     ((IO_PIN_PORT(port, n) == 'B' ? PORTB : IO_PIN_PORT(port, n) == 'D' ? PORTD : \
+       IO_PIN_PORT(port, n) == 'E' ? PORTE : IO_PIN_PORT(port, n) == 'F' ? PORTF : \
+       IO_PIN_PORT(port, n) == 'G' ? PORTG : 0) & (1u << IO_PIN_BIT(port, n))) ? \
+        (1u << (n)) : 0u)
+
+/*******************************************************************************
+ * PUBLIC MACROS                                                               *
+ ******************************************************************************/
+
+/**
+ * @Function IO_PinsSet(port, pattern)
+ * @param port - PORTV to PORTZ, a constant
+ * @param pattern - PINx bits, a constant
+ * @brief Drives the pins high, same as IO_PortsSetPortBits
+ * @author rcrobert 2014.12.12
+ */
+#define IO_PinsSet(port, pattern) IO_PINS_STORE(port, pattern, SET)
+
+/**
+ * @Function IO_PinsClear(port, pattern)
+ * @brief Drives the pins low, same as IO_PortsClearPortBits
+ * @author rcrobert 2014.12.12
+ */
+#define IO_PinsClear(port, pattern) IO_PINS_STORE(port, pattern, CLR)
+
+/**
+ * @Function IO_PinsToggle(port, pattern)
+ * @brief Flips the pins, same as IO_PortsTogglePortBits
+ * @author rcrobert 2014.12.12
+ */
+#define IO_PinsToggle(port, pattern) IO_PINS_STORE(port, pattern, INV)
+
+/**
+ * @Function IO_PinsRead(port, pattern)
+ * @return The pins of pattern that are high, as PINx bits, same as
+ *         IO_PortsReadPort(port) & pattern. Only pins in pattern are read
+ * @author rcrobert 2014.12.12
+ */
+#define IO_PinsRead(port, pattern) \
+    (IO_PIN_READ(port, pattern, 3) | IO_PIN_READ(port, pattern, 4) | \
+     IO_PIN_READ(port, pattern, 5) | IO_PIN_READ(port, pattern, 6) | \
+     IO_PIN_READ(port, pattern, 7) | IO_PIN_READ(port, pattern, 8) | \
+     IO_PIN_READ(port, pattern, 9) | IO_PIN_READ(port, pattern, 10) | \
+     IO_PIN_READ(port, pattern, 11) | IO_PIN_READ(port, pattern, 12))
+
+#endif	/* IO_PINS_H */
@@ -8,6 +8,8 @@
 #ifndef MOTORENCODER_H
 #define	MOTORENCODER_H
 
+#include <stdint.h>
+
 /*******************************************************************************
  * PUBLIC #DEFINES
  ******************************************************************************/
@@ -22,6 +24,28 @@
 
 #define NUM_ENCODERS 6
 
+// Velocity estimation
+#define ENCODER_VELOCITY_PERIOD_MS 10
+#define ENCODER_STOP_TIMEOUT_MS 250
+#define ENCODER_BLEND_LOW 2	    // counts per window, at or below is interval only
+#define ENCODER_BLEND_HIGH 8	    // at or above is count only
+
+/*******************************************************************************
+ * PUBLIC TYPES
+ ******************************************************************************/
+
+// Consistent copy of an encoder's counters
+typedef struct {
+    int32_t count;
+    uint32_t errors;
+} EncoderSnapshot;
+
+// Velocity estimate for one encoder
+typedef struct {
+    int32_t countsPerSec;
+    uint32_t timestamp;	    // core timer at the newest edge behind the estimate
+} EncoderVelocity;
+
 /*******************************************************************************
  * PUBLIC FUNCTION PROTOTYPES
  ******************************************************************************/
@@ -42,6 +66,18 @@ char Encoder_Init(void);
  */
 char Encoder_AddPins(int encoder);
 
+/**
+ * @Function Encoder_AddQuadPins(int encoderA, int encoderB)
+ * @param encoderA - Pin for channel A, also used to refer to the encoder after
+ * @param encoderB - Pin for channel B
+ * @return ERROR if either pin is out of range or already active
+ * @brief Activates a quadrature encoder on two pins. Every edge on either
+ * channel is decoded, 4 counts per encoder line, counting down in reverse.
+ * Swap A and B to flip the sign. Transitions that skip a state are not
+ * counted and show up in the error count instead
+ */
+char Encoder_AddQuadPins(int encoderA, int encoderB);
+
 /**
  * @Function Encoder_CountNum(int encoder, int n, void (*func)()
  * @param encoder - The encoder to count on
@@ -72,11 +108,40 @@ char Encoder_CancelCount(int encoder);
  */
 int Encoder_GetCount(int encoder);
 
+/**
+ * @Function Encoder_GetSnapshot(int encoder, EncoderSnapshot *snap)
+ * @param encoder - The encoder to read, channel A for quadrature encoders
+ * @param snap - Filled with the count and error total from the same instant
+ * @return ERROR if the encoder specified is out of range or not active
+ * @brief Copies the counters with the CN interrupt masked
+ */
+char Encoder_GetSnapshot(int encoder, EncoderSnapshot *snap);
+
+/**
+ * @Function Encoder_UpdateVelocity(void)
+ * @return FALSE, never posts events
+ * @brief Refreshes the velocity of every active encoder, rate limited to once
+ * every ENCODER_VELOCITY_PERIOD_MS so it can be called as often as wanted,
+ * e.g. from EVENT_CHECK_LIST. Slow wheels are timed from edge intervals and
+ * fast ones from counts over the update window, with a linear blend between
+ */
+uint8_t Encoder_UpdateVelocity(void);
+
+/**
+ * @Function Encoder_GetVelocity(int encoder, EncoderVelocity *vel)
+ * @param encoder - The encoder to read, channel A for quadrature encoders
+ * @param vel - Filled with the latest velocity in counts per second
+ * @return ERROR if the encoder specified is out of range or not active
+ * @brief Compare vel->timestamp against _CP0_GET_COUNT() to see how old the
+ * data is, a stopped wheel reads 0 once ENCODER_STOP_TIMEOUT_MS passes
+ */
+char Encoder_GetVelocity(int encoder, EncoderVelocity *vel);
+
 /**
  * @Function Encoder_ClrCount(int encoder)
  * @param encoder - The encoder to reset the count for
  * @return ERROR if the encoder specified is out of range or not active
- * @brief Reset function for the internal count value
+ * @brief Reset function for the internal count value and error count
  */
 char Encoder_ClrCount(int encoder);
 
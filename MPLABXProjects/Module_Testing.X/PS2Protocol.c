@@ -0,0 +1,552 @@
+/*
+ * File:   PS2Protocol.c
+ * Author: rcrobert
+ *
+ * Hardware independent PS/2 mouse host, see PS2Protocol.h
+ *
+ * Created on December 7, 2014, 2:10 PM
+ */
+
+#include "PS2Protocol.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+// First packet byte
+#define PACKET_ALWAYS_ONE 0x08
+#define PACKET_X_SIGN 0x10
+#define PACKET_Y_SIGN 0x20
+#define PACKET_X_OVERFLOW 0x40
+#define PACKET_Y_OVERFLOW 0x80
+#define PACKET_BUTTONS 0x07
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static PS2LineAction RequestTx(PS2Mouse *m, uint8_t byte);
+static PS2LineAction RestartInit(PS2Mouse *m);
+static PS2LineAction NextInitStep(PS2Mouse *m);
+static PS2LineAction HandleByte(PS2Mouse *m, uint8_t byte);
+static void HandlePacketByte(PS2Mouse *m, uint8_t byte);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void PS2Mouse_Init(PS2Mouse *m, uint8_t sampleRate, uint8_t resolution)
+{
+    uint8_t *p = (uint8_t *) m;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(PS2Mouse); i++) {
+	p[i] = 0;
+    }
+
+    m->state = PS2_MOUSE_OFF;
+
+    m->initSeq[0] = PS2_CMD_RESET;
+    m->initSeq[1] = PS2_CMD_SET_RATE;
+    m->initSeq[2] = sampleRate;
+    m->initSeq[3] = PS2_CMD_SET_RES;
+    m->initSeq[4] = resolution;
+    m->initSeq[5] = PS2_CMD_ENABLE;
+}
+
+PS2LineAction PS2Mouse_Start(PS2Mouse *m)
+{
+    m->restarts = 0;
+
+    return RestartInit(m);
+}
+
+PS2LineAction PS2Mouse_Write(PS2Mouse *m, uint8_t command)
+{
+    if (m->state != PS2_MOUSE_STREAM || m->transmitting || m->txPending) {
+	return PS2_LINE_NONE;
+    }
+
+    m->state = PS2_MOUSE_COMMAND;
+
+    return RequestTx(m, command);
+}
+
+void PS2Mouse_BeginTx(PS2Mouse *m)
+{
+    uint8_t i;
+
+    // Start bit is already on the line, the first edge asks for bit 0
+    m->transmitting = TRUE;
+    m->txPending = FALSE;
+    m->bitCount = 1;
+    m->shift = m->txByte;
+
+    // Odd parity, the parity bit makes the count of ones odd
+    m->parity = 1;
+    for (i = 0; i < 8; i++) {
+	m->parity ^= (m->txByte >> i) & 0x01;
+    }
+}
+
+PS2LineAction PS2Mouse_ClockFalling(PS2Mouse *m, uint8_t data)
+{
+    uint8_t bit;
+    uint8_t byte;
+
+    data = data ? 1 : 0;
+
+    if (m->transmitting) {
+	bit = m->bitCount++;
+
+	if (bit <= 8) {
+	    // Data bits, LSB first
+	    bit = (m->shift >> (bit - 1)) & 0x01;
+	} else if (bit == 9) {
+	    bit = m->parity;
+	} else if (bit == 10) {
+	    // Stop bit, let go of the line
+	    return PS2_LINE_DATA_RELEASE;
+	} else {
+	    // Ack bit, the mouse pulls data low
+	    m->transmitting = FALSE;
+	    m->bitCount = 0;
+
+	    if (data != 0) {
+		++m->txErrors;
+		return RequestTx(m, m->txByte);
+	    }
+	    return PS2_LINE_NONE;
+	}
+
+	return bit ? PS2_LINE_DATA_RELEASE : PS2_LINE_DATA_LOW;
+    }
+
+    bit = m->bitCount++;
+
+    if (bit == 0) {
+	// Start bit, stay put until a valid one shows up
+	if (data != 0) {
+	    ++m->frameErrors;
+	    m->bitCount = 0;
+	}
+	m->shift = 0;
+	m->parity = 0;
+    } else if (bit <= 8) {
+	m->shift |= data << (bit - 1);
+	m->parity ^= data;
+    } else if (bit == 9) {
+	m->parity ^= data;
+    } else {
+	// Stop bit closes the frame
+	m->bitCount = 0;
+
+	if (data == 0) {
+	    ++m->frameErrors;
+	    m->packetIndex = 0;
+	} else if (m->parity == 0) {
+	    ++m->parityErrors;
+	    m->packetIndex = 0;
+	} else {
+	    byte = m->shift;
+	    return HandleByte(m, byte);
+	}
+    }
+
+    return PS2_LINE_NONE;
+}
+
+PS2LineAction PS2Mouse_Resync(PS2Mouse *m)
+{
+    m->bitCount = 0;
+    m->packetIndex = 0;
+
+    if (m->transmitting) {
+	// Mouse stopped clocking mid transfer, send it again
+	m->transmitting = FALSE;
+	++m->txErrors;
+	return RequestTx(m, m->txByte);
+    }
+
+    return PS2_LINE_NONE;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static PS2LineAction RequestTx(PS2Mouse *m, uint8_t byte)
+{
+    m->txByte = byte;
+    m->txPending = TRUE;
+
+    return PS2_LINE_REQUEST_TX;
+}
+
+static PS2LineAction RestartInit(PS2Mouse *m)
+{
+    ++m->restarts;
+    m->initStep = 0;
+    m->packetIndex = 0;
+    m->state = PS2_MOUSE_CONFIG;
+
+    return RequestTx(m, m->initSeq[0]);
+}
+
+static PS2LineAction NextInitStep(PS2Mouse *m)
+{
+    if (++m->initStep >= sizeof(m->initSeq)) {
+	m->state = PS2_MOUSE_STREAM;
+	return PS2_LINE_NONE;
+    }
+
+    m->state = PS2_MOUSE_CONFIG;
+
+    return RequestTx(m, m->initSeq[m->initStep]);
+}
+
+static PS2LineAction HandleByte(PS2Mouse *m, uint8_t byte)
+{
+    switch (m->state) {
+    case PS2_MOUSE_CONFIG:
+	if (byte == PS2_RESP_ACK) {
+	    if (m->initSeq[m->initStep] == PS2_CMD_RESET) {
+		m->state = PS2_MOUSE_SELF_TEST;
+		return PS2_LINE_NONE;
+	    }
+	    return NextInitStep(m);
+	} else if (byte == PS2_RESP_RESEND) {
+	    return RequestTx(m, m->txByte);
+	}
+	return RestartInit(m);
+
+    case PS2_MOUSE_SELF_TEST:
+	if (byte == PS2_RESP_SELF_TEST) {
+	    m->state = PS2_MOUSE_DEVICE_ID;
+	    return PS2_LINE_NONE;
+	}
+	return RestartInit(m);
+
+    case PS2_MOUSE_DEVICE_ID:
+	// Any id is fine, only the 3 byte packet format is used
+	return NextInitStep(m);
+
+    case PS2_MOUSE_COMMAND:
+	if (byte == PS2_RESP_RESEND) {
+	    return RequestTx(m, m->txByte);
+	}
+	// Ack or error, either way the mouse is still streaming
+	m->state = PS2_MOUSE_STREAM;
+	m->packetIndex = 0;
+	break;
+
+    case PS2_MOUSE_STREAM:
+	HandlePacketByte(m, byte);
+	break;
+
+    default:
+	break;
+    }
+
+    return PS2_LINE_NONE;
+}
+
+static void HandlePacketByte(PS2Mouse *m, uint8_t byte)
+{
+    uint8_t status;
+    int32_t dx;
+    int32_t dy;
+
+    // First byte always has bit 3 set, drop bytes until one lines up
+    if (m->packetIndex == 0 && !(byte & PACKET_ALWAYS_ONE)) {
+	++m->syncErrors;
+	return;
+    }
+
+    m->packet[m->packetIndex++] = byte;
+    if (m->packetIndex < 3) {
+	return;
+    }
+    m->packetIndex = 0;
+
+    status = m->packet[0];
+    if (status & (PACKET_X_OVERFLOW | PACKET_Y_OVERFLOW)) {
+	++m->overflows;
+	return;
+    }
+
+    // 9 bit two's complement, sign bit lives in the first byte
+    dx = (int32_t) m->packet[1] - ((status & PACKET_X_SIGN) ? 256 : 0);
+    dy = (int32_t) m->packet[2] - ((status & PACKET_Y_SIGN) ? 256 : 0);
+
+    m->x += dx;
+    m->y += dy;
+    m->buttons = status & PACKET_BUTTONS;
+    ++m->packets;
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+
+/*
+ * Runs on a PC against a simulated mouse:
+ * gcc -DPS2PROTOCOL_TEST PS2Protocol.c -o ps2test && ./ps2test
+ */
+#ifdef PS2PROTOCOL_TEST
+
+#include <stdio.h>
+
+#define SIM_QUEUE 32
+
+typedef struct {
+    uint8_t out[SIM_QUEUE];	// bytes waiting to go to the host
+    uint8_t outCount;
+    uint8_t expectArg;		// last command takes an argument byte
+    uint8_t resendOnce;		// answer the next command with 0xFE
+    uint8_t nackOnce;		// skip the ack bit on the next host frame
+    uint8_t received[SIM_QUEUE];
+    uint8_t receivedCount;
+    uint8_t streaming;
+} SimMouse;
+
+static PS2Mouse mouse;
+static SimMouse sim;
+static int failures = 0;
+
+static void Expect(int cond, const char *what)
+{
+    if (!cond) {
+	printf("FAIL: %s\n", what);
+	++failures;
+    }
+}
+
+static void SimQueue(uint8_t byte)
+{
+    sim.out[sim.outCount++] = byte;
+}
+
+static void SimCommand(uint8_t byte)
+{
+    sim.received[sim.receivedCount++] = byte;
+
+    if (sim.resendOnce) {
+	sim.resendOnce = FALSE;
+	SimQueue(PS2_RESP_RESEND);
+	return;
+    }
+
+    if (sim.expectArg) {
+	sim.expectArg = FALSE;
+	SimQueue(PS2_RESP_ACK);
+	return;
+    }
+
+    SimQueue(PS2_RESP_ACK);
+    switch (byte) {
+    case PS2_CMD_RESET:
+	SimQueue(PS2_RESP_SELF_TEST);
+	SimQueue(0x00);
+	sim.streaming = FALSE;
+	break;
+    case PS2_CMD_SET_RATE:
+    case PS2_CMD_SET_RES:
+	sim.expectArg = TRUE;
+	break;
+    case PS2_CMD_ENABLE:
+	sim.streaming = TRUE;
+	break;
+    }
+}
+
+// Host to device, returns whatever the host asks for once the frame is done
+static PS2LineAction SimHostFrame(void)
+{
+    PS2LineAction action = PS2_LINE_NONE;
+    uint8_t line = 0;	// start bit, host already pulled data low
+    uint8_t bits[10];
+    uint8_t i;
+    uint8_t byte = 0;
+    uint8_t ones = 0;
+
+    PS2Mouse_BeginTx(&mouse);
+
+    // Mouse samples on each rising edge, after the host set the line
+    for (i = 0; i < 10; i++) {
+	action = PS2Mouse_ClockFalling(&mouse, line);
+	if (action == PS2_LINE_DATA_LOW)
+	    line = 0;
+	else if (action == PS2_LINE_DATA_RELEASE)
+	    line = 1;
+	bits[i] = line;
+    }
+
+    for (i = 0; i < 8; i++) {
+	byte |= bits[i] << i;
+	ones += bits[i];
+    }
+    Expect(((ones + bits[8]) & 0x01) == 1, "host parity is odd");
+    Expect(bits[9] == 1, "host stop bit released");
+
+    if (sim.nackOnce) {
+	sim.nackOnce = FALSE;
+	return PS2Mouse_ClockFalling(&mouse, 1);
+    }
+
+    // Ack bit
+    action = PS2Mouse_ClockFalling(&mouse, 0);
+    SimCommand(byte);
+
+    return action;
+}
+
+// Device to host frame with optional corruption
+static PS2LineAction SimDeviceFrame(uint8_t byte, uint8_t badParity,
+	uint8_t badStop)
+{
+    PS2LineAction action;
+    uint8_t i;
+    uint8_t parity = 1;
+
+    PS2Mouse_ClockFalling(&mouse, 0);
+    for (i = 0; i < 8; i++) {
+	PS2Mouse_ClockFalling(&mouse, (byte >> i) & 0x01);
+	parity ^= (byte >> i) & 0x01;
+    }
+    PS2Mouse_ClockFalling(&mouse, parity ^ badParity);
+    action = PS2Mouse_ClockFalling(&mouse, badStop ? 0 : 1);
+
+    return action;
+}
+
+// Plays out every pending transfer in both directions
+static void SimRun(PS2LineAction action)
+{
+    uint8_t i;
+
+    while (1) {
+	if (action == PS2_LINE_REQUEST_TX) {
+	    action = SimHostFrame();
+	    continue;
+	}
+
+	if (sim.outCount == 0)
+	    break;
+
+	action = SimDeviceFrame(sim.out[0], FALSE, FALSE);
+	for (i = 1; i < sim.outCount; i++) {
+	    sim.out[i - 1] = sim.out[i];
+	}
+	--sim.outCount;
+    }
+}
+
+static void SimPacket(int dx, int dy, uint8_t buttons)
+{
+    uint8_t status = PACKET_ALWAYS_ONE | buttons;
+
+    if (dx < 0)
+	status |= PACKET_X_SIGN;
+    if (dy < 0)
+	status |= PACKET_Y_SIGN;
+
+    SimQueue(status);
+    SimQueue((uint8_t) dx);
+    SimQueue((uint8_t) dy);
+    SimRun(PS2_LINE_NONE);
+}
+
+int main(void)
+{
+    const uint8_t initSeq[] = {0xFF, 0xF3, 100, 0xE8, PS2_RES_4_PER_MM, 0xF4};
+    uint8_t i;
+
+    PS2Mouse_Init(&mouse, 100, PS2_RES_4_PER_MM);
+
+    // Init sequence, mouse asks for one resend and drops one ack bit
+    sim.resendOnce = FALSE;
+    sim.nackOnce = TRUE;
+    SimRun(PS2Mouse_Start(&mouse));
+    Expect(mouse.txErrors == 1, "missing ack bit counted");
+    Expect(mouse.state == PS2_MOUSE_STREAM, "streaming after init");
+    Expect(sim.receivedCount == sizeof(initSeq), "init length");
+    for (i = 0; i < sizeof(initSeq); i++) {
+	Expect(sim.received[i] == initSeq[i], "init byte");
+    }
+
+    // Resend handling on a caller command
+    sim.resendOnce = TRUE;
+    sim.receivedCount = 0;
+    SimRun(PS2Mouse_Write(&mouse, PS2_CMD_ENABLE));
+    Expect(sim.receivedCount == 2, "command resent once");
+    Expect(mouse.state == PS2_MOUSE_STREAM, "streaming after command");
+
+    // Movement in all directions, including the 9 bit extremes
+    SimPacket(10, -5, 0x01);
+    SimPacket(-256, 255, 0x00);
+    SimPacket(-1, 1, 0x02);
+    Expect(mouse.x == (10 - 256 - 1), "x accumulated");
+    Expect(mouse.y == (-5 + 255 + 1), "y accumulated");
+    Expect(mouse.buttons == 0x02, "buttons");
+    Expect(mouse.packets == 3, "packet count");
+
+    // Parity error in the middle of a packet drops the whole packet
+    SimDeviceFrame(PACKET_ALWAYS_ONE, FALSE, FALSE);
+    SimDeviceFrame(20, TRUE, FALSE);
+    Expect(mouse.parityErrors == 1, "parity error counted");
+    SimPacket(3, 4, 0);
+    Expect(mouse.x == (10 - 256 - 1 + 3), "packet after parity error");
+
+    // Bad stop bit
+    SimDeviceFrame(PACKET_ALWAYS_ONE, FALSE, TRUE);
+    Expect(mouse.frameErrors == 1, "frame error counted");
+    SimPacket(1, 1, 0);
+    Expect(mouse.packets == 5, "packet after frame error");
+
+    // Stray byte without the sync bit is skipped
+    SimDeviceFrame(0x00, FALSE, FALSE);
+    Expect(mouse.syncErrors == 1, "sync error counted");
+    SimPacket(-2, -2, 0);
+    Expect(mouse.x == (10 - 256 - 1 + 3 + 1 - 2), "packet after sync error");
+    Expect(mouse.y == (-5 + 255 + 1 + 4 + 1 - 2), "y after sync error");
+
+    // Overflowed packet is dropped
+    SimQueue(PACKET_ALWAYS_ONE | PACKET_X_OVERFLOW);
+    SimQueue(0);
+    SimQueue(0);
+    SimRun(PS2_LINE_NONE);
+    Expect(mouse.overflows == 1, "overflow counted");
+
+    // Missed edge recovers through resync
+    PS2Mouse_ClockFalling(&mouse, 0);
+    PS2Mouse_ClockFalling(&mouse, 1);
+    PS2Mouse_Resync(&mouse);
+    SimPacket(5, 0, 0);
+    Expect(mouse.packets == 7, "packet after resync");
+
+    // Error response during init restarts from reset
+    PS2Mouse_Init(&mouse, 40, PS2_RES_8_PER_MM);
+    sim.receivedCount = 0;
+    SimRun(PS2Mouse_Start(&mouse));
+    mouse.state = PS2_MOUSE_CONFIG;
+    mouse.initStep = 1;
+    SimRun(SimDeviceFrame(PS2_RESP_ERROR, FALSE, FALSE));
+    Expect(mouse.restarts == 2, "restart on error response");
+    Expect(mouse.state == PS2_MOUSE_STREAM, "streaming after restart");
+
+    if (failures == 0) {
+	printf("PS2Protocol: all tests passed\n");
+    }
+
+    return failures ? 1 : 0;
+}
+
+#endif
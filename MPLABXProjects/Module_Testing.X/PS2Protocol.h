@@ -0,0 +1,166 @@
+/*
+ * File:   PS2Protocol.h
+ * Author: rcrobert
+ *
+ * Hardware independent PS/2 mouse host. Everything here runs off of falling
+ * clock edges and the level of the data line at that edge, the caller owns
+ * the pins and timers. This keeps the protocol testable on a PC against a
+ * simulated mouse, build with -DPS2PROTOCOL_TEST.
+ *
+ * Host to device transfers:
+ * 1. PS2Mouse_ClockFalling() or PS2Mouse_Start() returns PS2_LINE_REQUEST_TX
+ * 2. Caller holds clock low for at least 100us
+ * 3. Caller pulls data low, releases clock and calls PS2Mouse_BeginTx()
+ * 4. Following falling edges return the level to put on the data line
+ *
+ * Created on December 7, 2014, 2:10 PM
+ */
+
+#ifndef PS2PROTOCOL_H
+#define	PS2PROTOCOL_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// Commands and responses
+#define PS2_CMD_RESET 0xFF
+#define PS2_CMD_RESEND 0xFE
+#define PS2_CMD_SET_RATE 0xF3
+#define PS2_CMD_SET_RES 0xE8
+#define PS2_CMD_ENABLE 0xF4
+
+#define PS2_RESP_ACK 0xFA
+#define PS2_RESP_RESEND 0xFE
+#define PS2_RESP_ERROR 0xFC
+#define PS2_RESP_SELF_TEST 0xAA
+
+// Resolution argument for PS2_CMD_SET_RES
+#define PS2_RES_1_PER_MM 0x00
+#define PS2_RES_2_PER_MM 0x01
+#define PS2_RES_4_PER_MM 0x02
+#define PS2_RES_8_PER_MM 0x03
+
+/*******************************************************************************
+ * PUBLIC TYPES                                                                *
+ ******************************************************************************/
+
+// What the caller should do with the data line after an edge
+typedef enum {
+    PS2_LINE_NONE,
+    PS2_LINE_DATA_LOW,
+    PS2_LINE_DATA_RELEASE,
+    PS2_LINE_REQUEST_TX
+} PS2LineAction;
+
+typedef enum {
+    PS2_MOUSE_OFF,
+    PS2_MOUSE_CONFIG,	    // waiting on the response to initSeq[initStep]
+    PS2_MOUSE_SELF_TEST,    // reset acked, waiting on 0xAA
+    PS2_MOUSE_DEVICE_ID,    // waiting on the id byte after 0xAA
+    PS2_MOUSE_COMMAND,	    // caller command sent, waiting on 0xFA
+    PS2_MOUSE_STREAM
+} PS2MouseState;
+
+typedef struct {
+    // Bit layer
+    uint8_t transmitting;
+    uint8_t bitCount;
+    uint8_t shift;
+    uint8_t parity;
+    uint8_t txByte;
+    uint8_t txPending;
+
+    // Command layer
+    PS2MouseState state;
+    uint8_t initSeq[6];
+    uint8_t initStep;
+
+    // Packet layer
+    uint8_t packet[3];
+    uint8_t packetIndex;
+
+    // Outputs
+    int32_t x;
+    int32_t y;
+    uint8_t buttons;
+
+    // Error counters
+    uint32_t packets;
+    uint32_t frameErrors;	// bad start or stop bit
+    uint32_t parityErrors;
+    uint32_t syncErrors;	// first packet byte without bit 3 set
+    uint32_t overflows;		// packets dropped for movement overflow
+    uint32_t txErrors;		// no ack bit from the mouse
+    uint32_t restarts;		// init sequence restarted
+} PS2Mouse;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function PS2Mouse_Init(PS2Mouse *m, uint8_t sampleRate, uint8_t resolution)
+ * @param m - Mouse to set up
+ * @param sampleRate - Reports per second, 10 to 200
+ * @param resolution - One of the PS2_RES_* values
+ * @return None
+ * @brief Clears all state, the mouse is left off until PS2Mouse_Start
+ * @author rcrobert 2014.12.07
+ */
+void PS2Mouse_Init(PS2Mouse *m, uint8_t sampleRate, uint8_t resolution);
+
+/**
+ * @Function PS2Mouse_Start(PS2Mouse *m)
+ * @param m - Mouse to start
+ * @return PS2_LINE_REQUEST_TX, the reset command needs to go out
+ * @brief Runs reset, sample rate, resolution and stream enable in order. Any
+ * error response restarts the sequence from reset
+ * @author rcrobert 2014.12.07
+ */
+PS2LineAction PS2Mouse_Start(PS2Mouse *m);
+
+/**
+ * @Function PS2Mouse_Write(PS2Mouse *m, uint8_t command)
+ * @param m - Mouse to send to
+ * @param command - Byte to send
+ * @return PS2_LINE_REQUEST_TX, or PS2_LINE_NONE if a transfer is in progress
+ * or the mouse is not streaming yet
+ * @author rcrobert 2014.12.07
+ */
+PS2LineAction PS2Mouse_Write(PS2Mouse *m, uint8_t command);
+
+/**
+ * @Function PS2Mouse_BeginTx(PS2Mouse *m)
+ * @param m - Mouse being sent to
+ * @return None
+ * @brief Call once the clock has been held low, data pulled low for the start
+ * bit and the clock released
+ * @author rcrobert 2014.12.07
+ */
+void PS2Mouse_BeginTx(PS2Mouse *m);
+
+/**
+ * @Function PS2Mouse_ClockFalling(PS2Mouse *m, uint8_t data)
+ * @param m - Mouse the edge came from
+ * @param data - Level of the data line at the falling clock edge
+ * @return Action for the data line. PS2_LINE_REQUEST_TX means a byte is ready
+ * to go out and the caller should start inhibiting the clock
+ * @brief Drives the bit, byte and packet layers. Safe to call from an ISR
+ * @author rcrobert 2014.12.07
+ */
+PS2LineAction PS2Mouse_ClockFalling(PS2Mouse *m, uint8_t data);
+
+/**
+ * @Function PS2Mouse_Resync(PS2Mouse *m)
+ * @param m - Mouse to resync
+ * @return PS2_LINE_REQUEST_TX if a transfer was cut off and has to be resent
+ * @brief Drops any partial frame and packet. Call when the clock has been idle
+ * longer than a frame, a missed edge would otherwise shift every bit after it
+ * @author rcrobert 2014.12.07
+ */
+PS2LineAction PS2Mouse_Resync(PS2Mouse *m);
+
+#endif	/* PS2PROTOCOL_H */
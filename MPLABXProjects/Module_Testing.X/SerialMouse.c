@@ -1,3 +1,4 @@
+
 /*
  * File:   SerialMouse.h
  * Author: rcrobert
@@ -17,7 +18,10 @@
  * PRIVATE #DEFINES                                                            *
  ******************************************************************************/
 #define F_PB (BOARD_GetPBClock())
-#define TIMER_FREQUENCY (1000)
+#define TIMER_FREQUENCY (10000)	    // 100us clock inhibit
+
+// Clock idle longer than this drops a partial frame, frames take ~1ms
+#define FRAME_GAP_TICKS (2 * 40000)	// 2ms of core timer
 
 /*******************************************************************************
  * PRIVATE VARIABLES                                                           *
@@ -27,28 +31,44 @@ typedef struct {
     uint16_t pin;
 } PIN;
 
+// Stack pin for each CN, port 0 and pin 0 where the CN is not broken out
+static const PIN CNToPin[NUM_CN] = {
+    {0, 0},	    // CN0
+    {0, 0},	    // CN1
+    {PORTX, PIN4},  // CN2
+    {0, 0},	    // CN3
+    {PORTV, PIN3},  // CN4
+    {PORTV, PIN4},  // CN5
+    {PORTV, PIN5},  // CN6
+    {PORTV, PIN6},  // CN7
+    {PORTX, PIN5},  // CN8
+    {0, 0},	    // CN9
+    {PORTX, PIN9},  // CN10
+    {0, 0},	    // CN11
+    {PORTW, PIN7},  // CN12
+    {PORTX, PIN11}, // CN13
+    {PORTY, PIN5},  // CN14
+    {PORTX, PIN12}, // CN15
+    {PORTX, PIN10}, // CN16
+    {PORTX, PIN6},  // CN17
+    {PORTX, PIN3},  // CN18
+    {0, 0},	    // CN19
+    {0, 0},	    // CN20
+    {0, 0}	    // CN21
+};
+
 CN cn = {0};
 PIN clkPin = {0, 0};
 PIN dPin = {0, 0};
 
-typedef enum {
-    READY,
-    READING,
-    WRITING
-}TopState;
-
-TopState topState;
-
-typedef enum {
-    INT_BEGIN_WRITE,
-    INT_TIME,
-    INT_RISING,
-    INT_FALLING
-} InterruptType;
-
 unsigned char isInitialized = 0;
 
-Coordinate dTotal = {0, 0};
+// Protocol state, only touched with the CN interrupt masked outside the ISRs
+static PS2Mouse mouse;
+
+// Clock is held low by us, ignore our own falling edge
+static volatile unsigned char inhibiting = 0;
+static uint32_t lastEdge;
 
 /*******************************************************************************
  * PRIVATE FUNCTION PROTOTYPES                                                 *           *
@@ -60,11 +80,11 @@ void ReleasePin(PIN pin);
 
 unsigned char ReadPin(PIN pin);
 
-void RisingEdgeHandler(void);
+void FallingEdgeHandler(int cnNum);
 
-void FallingEdgeHandler(void);
+static void ApplyAction(PS2LineAction action);
 
-char SerialMouse_Run(InterruptType type);
+static void BeginInhibit(void);
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -83,67 +103,112 @@ void SerialMouse_Init(void)
 	return;
     }
 
-    // Set state machine state, prep to send
-    topState = WRITING;
+    PS2Mouse_Init(&mouse, SM_SAMPLE_RATE, SM_RESOLUTION);
 
     isInitialized = 1;
 }
 
 char SerialMouse_AddPins(CN clk, uint16_t data)
 {
-    // use a lookup table to convert from CN to port/pin
-    // for now, hardcode to CN4
-    cn = clk;
+    if (!isInitialized || clk.num >= NUM_CN) {
+	return ERROR;
+    }
 
-    clkPin.port = PORTV;
-    clkPin.pin = PIN3;
+    // Convert from CN to the stack port/pin
+    if (CNToPin[clk.num].pin == 0) {
+	return ERROR;
+    }
+
+    cn = clk;
+    clkPin = CNToPin[clk.num];
 
     dPin.port = SM_PORT;
     dPin.pin = data;
 
+    // Both lines idle released, the mouse has the pull-ups
+    ReleasePin(clkPin);
+    ReleasePin(dPin);
+
     return SUCCESS;
 }
 
 char SerialMouse_Start(void)
 {
-    // Initialize Timer4 for interrupts, period is 100us, NOT ENABLED
-    OpenTimer4(T4_ON | T4_SOURCE_INT | T4_PS_1_1, F_PB / TIMER_FREQUENCY);
+    unsigned char intState;
+
+    if (clkPin.pin == 0) {
+	return ERROR;
+    }
+
+    // Timer4 times the 100us clock inhibit, left off until needed
+    OpenTimer4(T4_OFF | T4_SOURCE_INT | T4_PS_1_1, F_PB / TIMER_FREQUENCY);
     INTSetVectorPriority(INT_TIMER_4_VECTOR, 3);
     INTSetVectorSubPriority(INT_TIMER_4_VECTOR, 3);
 
     CN_AttachInterrupt(cn, FallingEdgeHandler, FALLING);
-    CN_AttachInterrupt(cn, RisingEdgeHandler, RISING);
-    
-    SerialMouse_Run(INT_BEGIN_WRITE);
+
+    intState = CN_DisableInterrupts();
+    lastEdge = _CP0_GET_COUNT();
+    ApplyAction(PS2Mouse_Start(&mouse));
+    CN_RestoreInterrupts(intState);
 
     return SUCCESS;
 }
 
 char SerialMouse_Write(uint8_t data)
 {
-    // Incomplete DO NOT USE
-    return ERROR;
+    unsigned char intState;
+    PS2LineAction action;
+
+    intState = CN_DisableInterrupts();
+    action = PS2Mouse_Write(&mouse, data);
+    ApplyAction(action);
+    CN_RestoreInterrupts(intState);
+
+    return (action == PS2_LINE_REQUEST_TX) ? SUCCESS : ERROR;
 }
 
 Coordinate SerialMouse_Read(void)
 {
+    Coordinate dTotal;
+    unsigned char intState;
+
+    // Both axes from the same packet
+    intState = CN_DisableInterrupts();
+    dTotal.dx = mouse.x;
+    dTotal.dy = mouse.y;
+    CN_RestoreInterrupts(intState);
+
     return dTotal;
 }
 
+char SerialMouse_IsStreaming(void)
+{
+    return (mouse.state == PS2_MOUSE_STREAM) ? TRUE : FALSE;
+}
+
+void SerialMouse_GetStatus(PS2Mouse *status)
+{
+    unsigned char intState;
+
+    intState = CN_DisableInterrupts();
+    *status = mouse;
+    CN_RestoreInterrupts(intState);
+}
+
 /*******************************************************************************
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 void PullPinLow(PIN pin)
 {
     // Pull the line low
-    IO_PortsSetPortOutputs(pin.port, pin.pin);
     IO_PortsClearPortBits(pin.port, pin.pin);
+    IO_PortsSetPortOutputs(pin.port, pin.pin);
 }
 
 void ReleasePin(PIN pin)
 {
     // Release the line, high impedance with pull-up
-    IO_PortsSetPortBits(pin.port, pin.pin);
     IO_PortsSetPortInputs(pin.port, pin.pin);
 }
 
@@ -152,177 +217,75 @@ unsigned char ReadPin(PIN pin)
     return (IO_PortsReadPort(pin.port) & pin.pin) ? 0x01 : 0x00;
 }
 
-void RisingEdgeHandler(void)
-{
-    SerialMouse_Run(INT_RISING);
-}
-
-void FallingEdgeHandler(void)
-{
-    SerialMouse_Run(INT_FALLING);
-}
-
-char SerialMouse_Run(InterruptType type)
+void FallingEdgeHandler(int cnNum)
 {
-    enum {
-	INIT,
-	CLK_LO,
-	START_BIT,
-	WAIT_LO,
-	WAIT_HI,
-	WAIT_ACK
-    };
-
-    static unsigned char intState = INIT;
-    static int dCnt = 0;
-
-    const unsigned char CMD_INIT = 0xF4;
-    const unsigned char CMD_INIT_PAR = 0x0;
-
-    switch (intState) {
-    case INIT:
-	//DEBUG
-	//printf("\nINIT");
-	
-	// Pull the clock line low
-	PullPinLow(clkPin);
-
-	// Configure timer for 100us wait for holding low clk signal
-	INTClearFlag(INT_T4);
-	INTEnable(INT_T4, INT_ENABLED);
-
-	// if 1, change states
-	topState = WRITING;
-	intState = START_BIT;
-	break;
-
-    case START_BIT:
-	// DEBUG
-	/*
-	printf("\nSTART_BIT");
-	if (type == INT_FALLING)
-	    printf(" - FALLING");
-	else if (type == INT_RISING)
-	    printf(" - RISING");
-	 //*/
+    uint32_t now;
 
-	if (type == INT_TIME) {
-
-	    // Time is up, bring data lo
-	    PullPinLow(dPin);
+    if (inhibiting) {
+	return;
+    }
 
-	    // Release clk line
-	    ReleasePin(clkPin);
+    // Long gap means any partial frame lost an edge somewhere
+    now = _CP0_GET_COUNT();
+    if ((now - lastEdge) > FRAME_GAP_TICKS) {
+	if (PS2Mouse_Resync(&mouse) == PS2_LINE_REQUEST_TX) {
+	    BeginInhibit();
+	    return;
+	}
+    }
+    lastEdge = now;
 
-	    // Now wait for clock low to begin sending data
-	    // Device will read on rising edge, set data when clk goes lo
-	    // Send 8bit data + parity + stop
-	    dCnt = 0;
+    // Data is valid the whole time clock is low
+    ApplyAction(PS2Mouse_ClockFalling(&mouse, ReadPin(dPin)));
+}
 
-	    // change states
-	    intState = WAIT_LO;
-	}
+static void ApplyAction(PS2LineAction action)
+{
+    switch (action) {
+    case PS2_LINE_DATA_LOW:
+	PullPinLow(dPin);
 	break;
 
-    case WAIT_LO:
-	// DEBUG
-	/*
-	printf("\nWAIT_LO");
-	if (type == INT_FALLING)
-	    printf(" - FALLING");
-	else if (type == INT_RISING)
-	    printf(" - RISING");
-	 //*/
-
-	if (type == INT_FALLING) {
-
-	    // set/reset dPin for appropriate data
-	    if (dCnt == 0) {
-		// send start bit
-		PullPinLow(dPin);
-
-		++dCnt;
-
-		// change states
-		//intState = WAIT_HI;
-	    }
-	    else if (dCnt < 9) {
-		if (CMD_INIT & ( 1 << (dCnt - 1) )) {
-		    ReleasePin(dPin);
-		} else {
-		    PullPinLow(dPin);
-		}
-
-		++dCnt;
-
-		// change states
-		//intState = WAIT_HI;
-
-	    } else if (dCnt == 9) {
-		// hardcoded parity for 0xF4 command
-		PullPinLow(dPin);
-
-		++dCnt;
-
-		// change states
-		//intState = WAIT_HI;
-	    } else { // dCnt == 10
-		// send stop bit
-		ReleasePin(dPin);
-
-		// DEBUG
-		// change states
-		//intState = WAIT_LO;
-		dCnt = 0;
-	    }
-
-	    // DEBUG
-	    //printf("\nCount: %d", dCnt);
-	}
+    case PS2_LINE_DATA_RELEASE:
+	ReleasePin(dPin);
 	break;
 
-    case WAIT_HI:
-	// DEBUG
-	/*
-	printf("\nWAIT_HI");
-	if (type == INT_FALLING)
-	    printf(" - FALLING");
-	else if (type == INT_RISING)
-	    printf(" - RISING");
-	 //*/
-
-	if (type == INT_RISING) {
-	    // change states
-	    intState = WAIT_LO;
-	}
+    case PS2_LINE_REQUEST_TX:
+	BeginInhibit();
 	break;
 
-    case WAIT_ACK:	
-	if (type == INT_RISING) {
-	    if (ReadPin(dPin)) {
-		// ACK received, ready to begin reading, clock stays released
-		topState = READING;
-	    } else {
-		// ACK failed, removed interrupts and hold clk line low
-		CN_DetachInterrupt(cn, FALLING);
-		CN_DetachInterrupt(cn, RISING);
-
-		PullPinLow(clkPin);
-	    }
-	}
+    default:
 	break;
     }
+}
 
-    return SUCCESS;
+static void BeginInhibit(void)
+{
+    // Hold clock low for 100us, aborts anything the mouse was sending
+    inhibiting = 1;
+    PullPinLow(clkPin);
+
+    WriteTimer4(0);
+    INTClearFlag(INT_T4);
+    INTEnable(INT_T4, INT_ENABLED);
+    T4CONbits.ON = 1;
 }
 
-void __ISR(_TIMER_4_VECTOR, ipl3) Timer4IntHandler(void) {
-    //INTClearFlag(INT_T4);
+void __ISR(_TIMER_4_VECTOR, ipl3) Timer4IntHandler(void)
+{
+    unsigned char intState;
 
-    // Disable timer and interrupt until next use, possibly replace with one-off?
+    // One shot, disable timer and interrupt until next use
+    T4CONbits.ON = 0;
     INTEnable(INT_T4, INT_DISABLED);
-    CloseTimer4();
-
-    // 100us is up, handle it
-    SerialMouse_Run(INT_TIME);
+    INTClearFlag(INT_T4);
+
+    // 100us is up, start bit then hand the clock back to the mouse
+    intState = CN_DisableInterrupts();
+    PullPinLow(dPin);
+    PS2Mouse_BeginTx(&mouse);
+    inhibiting = 0;
+    lastEdge = _CP0_GET_COUNT();
+    ReleasePin(clkPin);
+    CN_RestoreInterrupts(intState);
 }
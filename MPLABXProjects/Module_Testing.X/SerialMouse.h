@@ -9,6 +9,8 @@
  *
  * NOTE: Currently supports only 1 mouse input.
  * NOTE: Uses Timer4 for its interrupts
+ * NOTE: Bit timing runs off the CN falling edge ISR, protocol is handled by
+ * PS2Protocol.c
  *
  * Created on November 16, 2014, 4:25 PM
  */
@@ -18,22 +20,25 @@
 
 #include <IO_Ports.h>
 #include "ChangeNotification.h"
+#include "PS2Protocol.h"
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                             *
  ******************************************************************************/
-// Definitions for pins available for use with the mouse
-#define SM_CLKPIN1 (1<<0)
-
+// Port for the data pin, the clock pin is given as a CN
 #define SM_PORT PORTV
-#define SM_DPIN1
+
+// Mouse settings sent during SerialMouse_Start
+#define SM_SAMPLE_RATE 100
+#define SM_RESOLUTION PS2_RES_4_PER_MM
 
 /*******************************************************************************
  * PUBLIC TYPES                                                                *
  ******************************************************************************/
+// Movement since SerialMouse_Start, in mouse counts
 typedef struct {
-    int dx;
-    int dy;
+    int32_t dx;
+    int32_t dy;
 } Coordinate;
 
 /*******************************************************************************
@@ -49,14 +54,55 @@ typedef struct {
  */
 void SerialMouse_Init(void);
 
+/**
+ * @Function SerialMouse_AddPins(CN clk, uint16_t data)
+ * @param clk - CN pin wired to the PS/2 clock
+ * @param data - Pin on SM_PORT wired to the PS/2 data line
+ * @return ERROR if clk is not available on the stack or the module is not
+ * initialized
+ * @author Reese Robertson, 2014.11.16
+ */
 char SerialMouse_AddPins(CN clk, uint16_t data);
 
+/**
+ * @Function SerialMouse_Start(void)
+ * @return ERROR if no pins were added
+ * @brief Resets the mouse, sets sample rate and resolution and enables stream
+ * mode. Runs in the background, check SerialMouse_IsStreaming
+ * @author Reese Robertson, 2014.11.16
+ */
 char SerialMouse_Start(void);
 
+/**
+ * @Function SerialMouse_Write(uint8_t data)
+ * @param data - Command byte for the mouse
+ * @return ERROR if the mouse is not streaming or a transfer is in progress
+ * @author Reese Robertson, 2014.11.16
+ */
 char SerialMouse_Write(uint8_t data);
 
+/**
+ * @Function SerialMouse_Read(void)
+ * @return Accumulated movement, both axes from the same packet boundary
+ * @author Reese Robertson, 2014.11.16
+ */
 Coordinate SerialMouse_Read(void);
 
+/**
+ * @Function SerialMouse_IsStreaming(void)
+ * @return TRUE once the init sequence is done and packets are coming in
+ * @author Reese Robertson, 2014.12.07
+ */
+char SerialMouse_IsStreaming(void);
+
+/**
+ * @Function SerialMouse_GetStatus(PS2Mouse *status)
+ * @param status - Filled with a copy of the protocol state and error counters
+ * @return None
+ * @author Reese Robertson, 2014.12.07
+ */
+void SerialMouse_GetStatus(PS2Mouse *status);
+
 
 #endif	/* SERIALMOUSE_H */
 
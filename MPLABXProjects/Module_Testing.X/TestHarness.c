@@ -34,6 +34,8 @@
 //#define HELLO_WORLD
 //#define CN_INT_TEST
 //#define ENCODER_TEST
+//#define CN_BENCH_TEST
+//#define MOUSE_TEST
 #define MOTOR_TEST
 //#define EVENTCHECKER_TEST
 
@@ -114,18 +116,28 @@ int main(void)
 
 /**
  * Test harness for the MotorEncoder.h library
- * This will initialize the motor encoder for Port X03. It takes serial input
- * c - Returns the current count of the encoder.
+ * This will initialize a quadrature encoder on Port X03 (A) and X04 (B). It
+ * takes serial input
+ * c - Returns the current count and error count of the encoder.
+ * v - Returns the velocity in counts per second and its age.
  * a - Attaches an interrupt to notify after 5 counts.
  * r - Clears the current count of the encoder.
  * o - Returns the overflow state of the encoder.
  * x - Deactivates the current encoder and ends the module.
  * h - Cancels the pending interrupt for the encoder.
+ * d - Drives X3 (RF5) and X4 (RB0) as outputs, unplug the encoder first.
+ * j - With the pins driven, flips A and B together while the CN interrupt is
+ *     held off. The ISR sees both change at once, so the errors go up by one
+ *     and the count stays put.
  */
 #ifdef ENCODER_TEST
 
+#include "ChangeNotification.h"
 #include "MotorEncoder.h"
 
+#define JUMP_A_PIN (1 << 5)	// RF5, X3
+#define JUMP_B_PIN (1 << 0)	// RB0, X4
+
 void CallBack(void)
 {
     printf("\nCallback Reached");
@@ -134,6 +146,10 @@ void CallBack(void)
 int main(void)
 {
     char in;
+    unsigned char cnState;
+    EncoderSnapshot snap;
+    EncoderSnapshot jump;
+    EncoderVelocity vel;
 
     BOARD_Init();
     SERIAL_Init();
@@ -147,8 +163,8 @@ int main(void)
     }
 
     // Add some pins
-    printf("\nTesting encoder for pin X3 - ");
-    if (Encoder_AddPins(ENCODER_PORTX3) == SUCCESS) {
+    printf("\nTesting quadrature encoder for pins X3 X4 - ");
+    if (Encoder_AddQuadPins(ENCODER_PORTX3, ENCODER_PORTX4) == SUCCESS) {
 	printf("Pins added");
     } else {
 	printf("Failed to add pins");
@@ -156,13 +172,22 @@ int main(void)
     }
 
     while (1) {
+	Encoder_UpdateVelocity();
+
 	if (!IsReceiveEmpty()) {
 	    in = GetChar();
 
 	    switch (in) {
 
 	    case 'c':
-		printf("\nCount: %d", Encoder_GetCount(ENCODER_PORTX3));
+		Encoder_GetSnapshot(ENCODER_PORTX3, &snap);
+		printf("\nCount: %ld Errors: %lu", snap.count, snap.errors);
+		break;
+
+	    case 'v':
+		Encoder_GetVelocity(ENCODER_PORTX3, &vel);
+		printf("\nVelocity: %ld counts/s, %lu us old", vel.countsPerSec,
+			(_CP0_GET_COUNT() - vel.timestamp) / 40);
 		break;
 
 	    case 'a':
@@ -207,6 +232,25 @@ int main(void)
 		} else {
 		    printf("\nEncoder failed to cancel");
 		}
+		break;
+
+	    case 'd':
+		TRISFCLR = JUMP_A_PIN;
+		TRISBCLR = JUMP_B_PIN;
+		printf("\nX3 X4 driven");
+		break;
+
+	    case 'j':
+		Encoder_GetSnapshot(ENCODER_PORTX3, &snap);
+		cnState = CN_DisableInterrupts();
+		LATFINV = JUMP_A_PIN;
+		LATBINV = JUMP_B_PIN;
+		CN_RestoreInterrupts(cnState);
+		Encoder_GetSnapshot(ENCODER_PORTX3, &jump);
+		printf("\nJump: count %ld -> %ld, errors %lu -> %lu %s", snap.count,
+			jump.count, snap.errors, jump.errors,
+			(jump.count == snap.count && jump.errors == snap.errors + 1) ?
+			"PASS" : "FAIL");
 
 	    } // end switch
 
@@ -219,6 +263,116 @@ int main(void)
 
 #endif
 
+/**
+ * Benchmark for the ChangeNotification.h ISR
+ * Runs all 6 encoder pins as 3 quadrature encoders (X3/X4, X6/X10, X11/X12)
+ * and prints the last and worst case ISR cycles once a second while they spin.
+ * Needs CN_ISR_PROFILE defined in ChangeNotification.h
+ * r - Resets the worst case
+ */
+#ifdef CN_BENCH_TEST
+
+#include "ChangeNotification.h"
+#include "MotorEncoder.h"
+
+#ifndef CN_ISR_PROFILE
+#error "Define CN_ISR_PROFILE in ChangeNotification.h for this test"
+#endif
+
+#define BENCH_TIMER 1
+#define BENCH_PERIOD 1000
+
+extern volatile unsigned int cn_isr_max;
+
+int main(void)
+{
+    unsigned int last, max;
+
+    BOARD_Init();
+    SERIAL_Init();
+    TIMERS_Init();
+    Encoder_Init();
+
+    Encoder_AddQuadPins(ENCODER_PORTX3, ENCODER_PORTX4);
+    Encoder_AddQuadPins(ENCODER_PORTX6, ENCODER_PORTX10);
+    Encoder_AddQuadPins(ENCODER_PORTX11, ENCODER_PORTX12);
+
+    printf("\nCN ISR benchmark, spin all encoders");
+
+    InitTimer(BENCH_TIMER, BENCH_PERIOD);
+
+    while (1) {
+	if (!IsReceiveEmpty() && GetChar() == 'r') {
+	    cn_isr_max = 0;
+	}
+
+	if (IsTimerExpired(BENCH_TIMER) == TIMER_EXPIRED) {
+	    InitTimer(BENCH_TIMER, BENCH_PERIOD);
+
+	    CN_GetISRCycles(&last, &max);
+	    printf("\nISR cycles last: %u max: %u counts: %d %d %d", last, max,
+		    Encoder_GetCount(ENCODER_PORTX3),
+		    Encoder_GetCount(ENCODER_PORTX6),
+		    Encoder_GetCount(ENCODER_PORTX11));
+	}
+    }
+}
+
+#endif
+
+/**
+ * Test harness for the SerialMouse.h library
+ * Clock on V03 (CN4), data on V04. Prints the accumulated movement and error
+ * counters twice a second once the mouse is streaming.
+ * r - Restarts the mouse
+ */
+#ifdef MOUSE_TEST
+
+#include "SerialMouse.h"
+
+#define MOUSE_TIMER 1
+#define MOUSE_PERIOD 500
+
+int main(void)
+{
+    Coordinate pos;
+    PS2Mouse status;
+
+    BOARD_Init();
+    SERIAL_Init();
+    TIMERS_Init();
+
+    SerialMouse_Init();
+    if (SerialMouse_AddPins(CN_4, PIN4) == ERROR) {
+	printf("\nFailed to add mouse pins");
+	while (1);
+    }
+    SerialMouse_Start();
+
+    printf("\nSerialMouse test harness loaded");
+
+    InitTimer(MOUSE_TIMER, MOUSE_PERIOD);
+
+    while (1) {
+	if (!IsReceiveEmpty() && GetChar() == 'r') {
+	    SerialMouse_Write(PS2_CMD_RESET);
+	}
+
+	if (IsTimerExpired(MOUSE_TIMER) == TIMER_EXPIRED) {
+	    InitTimer(MOUSE_TIMER, MOUSE_PERIOD);
+
+	    pos = SerialMouse_Read();
+	    SerialMouse_GetStatus(&status);
+	    printf("\n%s x: %ld y: %ld pkts: %lu par: %lu frm: %lu sync: %lu tx: %lu",
+		    SerialMouse_IsStreaming() ? "STREAM" : "INIT", pos.dx, pos.dy,
+		    status.packets, status.parityErrors, status.frameErrors,
+		    status.syncErrors, status.txErrors);
+	}
+    }
+}
+
+#endif
+
 /**
  * Test harness for the MotorDriver.h library
  * w - Drive motors forward
@@ -349,6 +503,9 @@ int main(void)
 	    ClearTimerExpired(1);
 	    Drive_Stop();
 	}
+
+	// Push the latched command out to the motors
+	Drive_Update();
     }
 
     // DO NOT EXIT
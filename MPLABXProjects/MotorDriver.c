@@ -1,5 +1,9 @@
 
+#include <xc.h>
 #include <BOARD.h>
+#include "BotParams.h"
+#include "IO_Pins.h"
+#include "Battery.h"
 #include "MotorDriver.h"
 
 
@@ -7,20 +11,85 @@
 // (x) Solved with power resistors
 // Solved, H bridge can handle 2.5A per channel
 
+// Marks a wheel as never written so the first update always reaches hardware
+#define SPEED_UNKNOWN (MAX_PWM + 1)
+
+typedef struct {
+	uint8_t active;
+	int left;
+	int right;
+} DriveRequest;
+
+// One latched request per priority, last write in a step wins
+static DriveRequest requests[NUM_DRIVE_PRIORITIES];
+static uint8_t requestsChanged = FALSE;
+
+// Last speeds written to each H bridge channel
+static int appliedLeft = SPEED_UNKNOWN;
+static int appliedRight = SPEED_UNKNOWN;
+
+// Duty on each enable pin, after the ratio and battery compensation
+static int dutyLeft = SPEED_UNKNOWN;
+static int dutyRight = SPEED_UNKNOWN;
+static uint32_t lastRefresh;
+
+// Timed reflex hold, measured on the core timer
+static uint8_t reflexHolding = FALSE;
+static uint32_t reflexStart;
+static uint32_t reflexHoldTicks;
+
 static int ConvertDC(int speed)
 {
-	int x;
 	unsigned int batRead;
-	float inVolt;
-	float mult;
-
-	batRead = AD_ReadADPin(BAT_VOLTAGE);
+	int batMv;
+
+	// Load corrected, the sag the motors cause is not chased with more duty
+	batMv = Battery_GetOpenCircuitMv();
+	if (batMv <= 0) {
+		// Leave the speed alone rather than scale by a bad reading
+		if (AD_ReadADPins(BAT_VOLTAGE, &batRead) == ERROR) {
+			return speed;
+		}
+		batMv = BATTERY_COUNTS_TO_MV(batRead);
+		if (batMv <= 0) {
+			return speed;
+		}
+	}
 
-	inVolt = ((float) batRead) / 1023.0 * 33.0;
-	mult = 9.90 / inVolt;
+	speed = (int) ((int32_t) speed * MOTOR_NOMINAL_MV / batMv);
 
 	// Cap it at 1000
-	return (int) (((speed * mult) > 1000.0) ? 1000.0 : (speed * mult));
+	return (speed > 1000) ? 1000 : speed;
+}
+
+// Duty for a speed, direction is left to the caller
+static int Left_Duty(int speed)
+{
+	// Modify speed for ratio
+	speed = (speed * BotParam(MOTOR_RATIO_Q10)) / 1024;
+
+	return ConvertDC((speed < 0) ? -speed : speed);
+}
+
+static int Right_Duty(int speed)
+{
+	return ConvertDC((speed < 0) ? -speed : speed);
+}
+
+static void Left_SetDuty(int duty)
+{
+	if (duty != dutyLeft) {
+		PWM_SetDutyCycle(MOTOR_PINS_LEFT_EN, duty);
+		dutyLeft = duty;
+	}
+}
+
+static void Right_SetDuty(int duty)
+{
+	if (duty != dutyRight) {
+		PWM_SetDutyCycle(MOTOR_PINS_RIGHT_EN, duty);
+		dutyRight = duty;
+	}
 }
 
 static char Left_MtrSpeed(int speed)
@@ -30,26 +99,17 @@ static char Left_MtrSpeed(int speed)
 		return ERROR;
 	}
 
-	// Modify speed for ratio
-	speed = (int) ((float) speed * MOTOR_RATIO);
-
 	// Check direction
 	if (speed < 0) {
-		// Reverse
-		speed = speed * (-1);
-
-		// Clear direction
-		IO_PortsClearPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LEFT_DIR);
+		// Reverse, clear direction
+		IO_PinsClear(MOTOR_PINS_PORT, MOTOR_PINS_LEFT_DIR);
 	} else {
-		// Forward
-
-		// Set direction
-		IO_PortsSetPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LEFT_DIR);
+		// Forward, set direction
+		IO_PinsSet(MOTOR_PINS_PORT, MOTOR_PINS_LEFT_DIR);
 	}
 
 	// Set PWM
-	speed = ConvertDC(speed);
-	PWM_SetDutyCycle(MOTOR_PINS_LEFT_EN, speed);
+	Left_SetDuty(Left_Duty(speed));
 
 	return SUCCESS;
 }
@@ -63,21 +123,15 @@ static char Right_MtrSpeed(int speed)
 
 	// Check direction
 	if (speed < 0) {
-		// Reverse
-		speed = speed * (-1);
-
-		// Clear direction
-		IO_PortsClearPortBits(MOTOR_PINS_PORT, MOTOR_PINS_RIGHT_DIR);
+		// Reverse, clear direction
+		IO_PinsClear(MOTOR_PINS_PORT, MOTOR_PINS_RIGHT_DIR);
 	} else {
-		// Forward
-
-		// Set direction
-		IO_PortsSetPortBits(MOTOR_PINS_PORT, MOTOR_PINS_RIGHT_DIR);
+		// Forward, set direction
+		IO_PinsSet(MOTOR_PINS_PORT, MOTOR_PINS_RIGHT_DIR);
 	}
 
 	// Set PWM
-	speed = ConvertDC(speed);
-	PWM_SetDutyCycle(MOTOR_PINS_RIGHT_EN, speed);
+	Right_SetDuty(Right_Duty(speed));
 
 	return SUCCESS;
 }
@@ -86,6 +140,8 @@ static char Right_MtrSpeed(int speed)
 
 void Drive_Init(void)
 {
+	int i;
+
 	// Configure PWM components
 	PWM_Init();
 	PWM_SetFrequency(PWM_BOT_FREQUENCY);
@@ -96,90 +152,201 @@ void Drive_Init(void)
 	// Configure direction pins
 	IO_PortsSetPortOutputs(MOTOR_PINS_PORT, MOTOR_PINS_RIGHT_DIR | MOTOR_PINS_LEFT_DIR |
 		MOTOR_PINS_LIFT_DIR);
+
+	// Reset arbiter to a stopped default, first update writes both channels
+	for (i = 0; i < NUM_DRIVE_PRIORITIES; ++i) {
+		requests[i].active = FALSE;
+		requests[i].left = 0;
+		requests[i].right = 0;
+	}
+	requests[DRIVE_PRIORITY_DEFAULT].active = TRUE;
+	appliedLeft = SPEED_UNKNOWN;
+	appliedRight = SPEED_UNKNOWN;
+	dutyLeft = SPEED_UNKNOWN;
+	dutyRight = SPEED_UNKNOWN;
+	lastRefresh = _CP0_GET_COUNT();
+	reflexHolding = FALSE;
+	requestsChanged = TRUE;
 }
 
-char Drive_Straight(int speed)
+char Drive_Request(DrivePriority_t priority, int leftSpeed, int rightSpeed)
 {
-	// Arguments checked in helper functions
-
-	// Should motors be halted first?
-	if (Left_MtrSpeed(speed) == ERROR) {
+	if (priority >= NUM_DRIVE_PRIORITIES) {
 		return ERROR;
 	}
 
-	if (Right_MtrSpeed(speed) == ERROR) {
+	// Check argument range here, hardware is only touched in Drive_Update
+	if (leftSpeed > MAX_PWM || leftSpeed < ((-1) * MAX_PWM) ||
+		rightSpeed > MAX_PWM || rightSpeed < ((-1) * MAX_PWM)) {
 		return ERROR;
 	}
 
-	return SUCCESS;
-}
+	// Anything newer from below means the HSM has reacted, the hold only
+	// covers the gap until then
+	if (priority < DRIVE_PRIORITY_REFLEX && reflexHolding) {
+		reflexHolding = FALSE;
+		requests[DRIVE_PRIORITY_REFLEX].active = FALSE;
+	}
 
-char Drive_Stop(void)
-{
-	return (Drive_Straight(0));
+	requests[priority].left = leftSpeed;
+	requests[priority].right = rightSpeed;
+	requests[priority].active = TRUE;
+	requestsChanged = TRUE;
+
+	return SUCCESS;
 }
 
-char Drive_Left(int speed)
+char Drive_Release(DrivePriority_t priority)
 {
-	// Currently just moves one motor twice as fast, test more to find the right
-	// gradient, maybe accept gradient as an argument
-	if (Right_MtrSpeed(speed) == ERROR) {
+	// Default request can be overwritten but never released
+	if (priority >= NUM_DRIVE_PRIORITIES || priority == DRIVE_PRIORITY_DEFAULT) {
 		return ERROR;
 	}
 
-	if (Left_MtrSpeed((speed / 2)) == ERROR) {
-		return ERROR;
-	}
+	requests[priority].active = FALSE;
+	requestsChanged = TRUE;
 
 	return SUCCESS;
 }
 
-char Drive_Right(int speed)
+uint8_t Drive_Update(void)
 {
-	// Currently just moves one motor twice as fast, test more
-	if (Left_MtrSpeed(speed) == ERROR) {
-		return ERROR;
+	int i;
+
+	// Let a timed reflex go once its hold has run out
+	if (reflexHolding &&
+		((uint32_t) (_CP0_GET_COUNT() - reflexStart) >= reflexHoldTicks)) {
+		reflexHolding = FALSE;
+		Drive_Release(DRIVE_PRIORITY_REFLEX);
 	}
 
-	if (Right_MtrSpeed((speed / 2)) == ERROR) {
-		return ERROR;
+	if (requestsChanged == FALSE) {
+		// Same speeds, but the battery moves under them. Direction stays,
+		// only a duty that comes out different reaches the PWM
+		if ((uint32_t) (_CP0_GET_COUNT() - lastRefresh) >=
+			(uint32_t) DRIVE_REFRESH_MS * CORE_TICKS_PER_MS) {
+			lastRefresh = _CP0_GET_COUNT();
+			if (appliedLeft != SPEED_UNKNOWN) {
+				Left_SetDuty(Left_Duty(appliedLeft));
+			}
+			if (appliedRight != SPEED_UNKNOWN) {
+				Right_SetDuty(Right_Duty(appliedRight));
+			}
+		}
+		return FALSE;
 	}
+	requestsChanged = FALSE;
 
-	return SUCCESS;
-}
+	// Highest active priority wins, default is always active
+	for (i = (NUM_DRIVE_PRIORITIES - 1); i > DRIVE_PRIORITY_DEFAULT; --i) {
+		if (requests[i].active) {
+			break;
+		}
+	}
 
-char Drive_TankLeft(int speed)
-{
-	// Currently just moves one motor opposite, test more
-	if (Right_MtrSpeed(speed) == ERROR) {
-		return ERROR;
+	// Skip channels that already hold the winning command
+	if (requests[i].left != appliedLeft) {
+		Left_MtrSpeed(requests[i].left);
+		appliedLeft = requests[i].left;
 	}
 
-	if (Left_MtrSpeed(speed * (-1)) == ERROR) {
-		return ERROR;
+	if (requests[i].right != appliedRight) {
+		Right_MtrSpeed(requests[i].right);
+		appliedRight = requests[i].right;
 	}
 
-	return SUCCESS;
+	return FALSE;
 }
 
-char Drive_TankRight(int speed)
+char Drive_Reflex(DriveReflex_t action, unsigned int holdMs)
 {
-	// Currently just moves one motor opposite, test more
-	if (Left_MtrSpeed(speed) == ERROR) {
-		return ERROR;
+	int speed;
+
+	switch (action) {
+	case DRIVE_REFLEX_STOP:
+		speed = 0;
+		break;
+
+	case DRIVE_REFLEX_BACKOFF:
+		speed = BotParam(MOTOR_SPEED_REFLEX);
+		break;
+
+	default:
+		return SUCCESS;
 	}
 
-	if (Right_MtrSpeed(speed * (-1)) == ERROR) {
-		return ERROR;
+	// Hit the hardware now, arbiter only keeps it there
+	if (speed != appliedLeft) {
+		Left_MtrSpeed(speed);
+		appliedLeft = speed;
 	}
 
+	if (speed != appliedRight) {
+		Right_MtrSpeed(speed);
+		appliedRight = speed;
+	}
+
+	Drive_Request(DRIVE_PRIORITY_REFLEX, speed, speed);
+
+	reflexStart = _CP0_GET_COUNT();
+	reflexHoldTicks = (uint32_t) holdMs * CORE_TICKS_PER_MS;
+	reflexHolding = TRUE;
+
 	return SUCCESS;
 }
 
+void Drive_GetCommand(int *leftSpeed, int *rightSpeed)
+{
+	// Nothing written yet reads as stopped
+	*leftSpeed = (appliedLeft == SPEED_UNKNOWN) ? 0 : appliedLeft;
+	*rightSpeed = (appliedRight == SPEED_UNKNOWN) ? 0 : appliedRight;
+}
+
+void Drive_GetDuty(int *leftDuty, int *rightDuty)
+{
+	*leftDuty = (dutyLeft == SPEED_UNKNOWN) ? 0 : dutyLeft;
+	*rightDuty = (dutyRight == SPEED_UNKNOWN) ? 0 : dutyRight;
+}
+
+char Drive_Straight(int speed)
+{
+	return (Drive_Request(DRIVE_PRIORITY_BEHAVIOR, speed, speed));
+}
+
+char Drive_Stop(void)
+{
+	return (Drive_Straight(0));
+}
+
+char Drive_Left(int speed)
+{
+	// Currently just moves one motor twice as fast, test more to find the right
+	// gradient, maybe accept gradient as an argument
+	return (Drive_Request(DRIVE_PRIORITY_BEHAVIOR, (speed / 2), speed));
+}
+
+char Drive_Right(int speed)
+{
+	// Currently just moves one motor twice as fast, test more
+	return (Drive_Request(DRIVE_PRIORITY_BEHAVIOR, speed, (speed / 2)));
+}
+
+char Drive_TankLeft(int speed)
+{
+	// Currently just moves one motor opposite, test more
+	return (Drive_Request(DRIVE_PRIORITY_BEHAVIOR, (speed * (-1)), speed));
+}
+
+char Drive_TankRight(int speed)
+{
+	// Currently just moves one motor opposite, test more
+	return (Drive_Request(DRIVE_PRIORITY_BEHAVIOR, speed, (speed * (-1))));
+}
+
 char Drive_LiftUp(void)
 {
 	// Set direction to raise it
-	IO_PortsSetPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_DIR | MOTOR_PINS_LIFT_EN);
+	IO_PinsSet(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_DIR | MOTOR_PINS_LIFT_EN);
 
 	return SUCCESS;
 }
@@ -187,16 +354,16 @@ char Drive_LiftUp(void)
 char Drive_LiftDown(void)
 {
 	// Set direction to lower it
-	IO_PortsClearPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_DIR);
+	IO_PinsClear(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_DIR);
 
-	IO_PortsSetPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_EN);
+	IO_PinsSet(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_EN);
 
 	return SUCCESS;
 }
 
 char Drive_LiftStop(void)
 {
-	IO_PortsClearPortBits(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_EN);
+	IO_PinsClear(MOTOR_PINS_PORT, MOTOR_PINS_LIFT_EN);
 
 	return SUCCESS;
 }
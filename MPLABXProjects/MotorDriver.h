@@ -23,6 +23,32 @@
 #define	MOTORDRIVER_H
 
 #include "BotConfig.h"
+#include <inttypes.h>
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS
+ ******************************************************************************/
+
+/* Drive arbiter
+ * Motion requests are latched per priority during a run-to-completion step and
+ * only the highest active one reaches the hardware when Drive_Update() runs.
+ * The plain Drive_* calls below post at DRIVE_PRIORITY_BEHAVIOR, so a state
+ * machine that calls Drive_Stop() then Drive_Straight() in the same event only
+ * produces one write to the motors.
+ */
+typedef enum {
+	DRIVE_PRIORITY_DEFAULT, // Always active, stopped unless requested otherwise
+	DRIVE_PRIORITY_BEHAVIOR, // HSM states
+	DRIVE_PRIORITY_REFLEX, // Safety reactions, overrides everything
+	NUM_DRIVE_PRIORITIES
+} DrivePriority_t;
+
+// Safety actions for Drive_Reflex
+typedef enum {
+	DRIVE_REFLEX_NONE,
+	DRIVE_REFLEX_STOP,
+	DRIVE_REFLEX_BACKOFF // straight back at MOTOR_SPEED_REFLEX
+} DriveReflex_t;
 
 /*******************************************************************************
  * PUBLIC FUNCTION PROTOTYPES
@@ -31,6 +57,28 @@
 // Init
 void Drive_Init(void);
 
+// Arbiter interface, speeds are -1000 to 1000 per wheel
+char Drive_Request(DrivePriority_t priority, int leftSpeed, int rightSpeed);
+char Drive_Release(DrivePriority_t priority);
+
+// Applies the winning request, call once per control cycle. Battery
+// compensation is redone every DRIVE_REFRESH_MS even with no new request.
+// Returns FALSE so it can sit in EVENT_CHECK_LIST and run after every event is
+// handled
+uint8_t Drive_Update(void);
+
+// Writes the reflex straight to the motors without waiting for Drive_Update,
+// then holds it at DRIVE_PRIORITY_REFLEX for holdMs or until a lower priority
+// request arrives, whichever is first. A hold of 0 lets go on the next
+// Drive_Update, which can come before the HSM sees the triggering event
+char Drive_Reflex(DriveReflex_t action, unsigned int holdMs);
+
+// Speeds last written to the wheels, what the motors are actually being told
+void Drive_GetCommand(int *leftSpeed, int *rightSpeed);
+
+// Duty on each enable pin, 0 to 1000 after the ratio and battery compensation
+void Drive_GetDuty(int *leftDuty, int *rightDuty);
+
 // Range of -1000 to 1000
 char Drive_Straight(int speed);
 char Drive_Stop(void);
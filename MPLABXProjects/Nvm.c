@@ -0,0 +1,771 @@
+/*
+ * File:   Nvm.c
+ * Author: rcrobert
+ *
+ * Wear leveled record storage in program flash. See Nvm.h
+ *
+ * Created on December 12, 2014, 11:40 AM
+ */
+
+#include <string.h>
+#include "Crc16.h"
+#include "Flash.h"
+#include "Nvm.h"
+
+#ifdef FLASH_HOST
+#ifndef SUCCESS
+#define SUCCESS 1
+#define ERROR -1
+#endif
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+#else
+#include <xc.h>
+#include <plib.h>
+#include <BOARD.h>
+#endif
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+#define NVM_MAGIC 0x314D564E        // "NVM1"
+
+// Page header words before the first record
+#define PAGE_HEADER 2
+#define RECORD_HEADER 2
+
+#define STAGE_WORDS (NVM_STAGE_SIZE / 4)
+
+#define RecordWords(length) (RECORD_HEADER + (((length) + 3) / 4))
+#define HeaderType(word) ((word) & 0xFFFF)
+#define HeaderLength(word) ((word) >> 16)
+
+// Guards the page and buffer state, Nvm_WriteNow can run from the undervoltage
+// interrupt or the exception handler. Held for one flash call at a time at
+// most, the scans around them run with interrupts on
+#ifdef FLASH_HOST
+#define NVM_LOCK() 0
+#define NVM_UNLOCK(status) ((void) (status))
+#else
+#define NVM_LOCK() INTDisableInterrupts()
+#define NVM_UNLOCK(status) INTRestoreInterrupts(status)
+#endif
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+static FLASH_RESERVE(nvmStore, NVM_PAGES);
+static FLASH_CONST uint32_t *pages = nvmStore;
+
+static uint8_t ready = FALSE;
+static uint8_t active = 0;
+static uint32_t generation = 0;
+static unsigned int writeWord = FLASH_PAGE_WORDS;
+static uint16_t failures = 0;
+
+// Whole records, header and padded data, exactly as they will be programmed
+static uint32_t stage[STAGE_WORDS];
+static unsigned int stageHead = 0;
+static unsigned int stageTail = 0;
+
+// Record Nvm_Update is part way through, recordLeft is 0 between records
+static unsigned int recordStage = 0;
+static unsigned int recordLeft = 0;
+static unsigned int recordEnd = 0;
+
+// Set while a page change copies records over, no other change can start
+static uint8_t reclaiming = FALSE;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static FLASH_CONST uint32_t *Page(uint8_t page);
+static uint8_t PageErased(uint8_t page);
+static unsigned int FindEnd(uint8_t page);
+static const uint32_t *NextRecord(FLASH_CONST uint32_t *page, unsigned int *word);
+static uint8_t RecordValid(const uint32_t *record);
+static const uint32_t *FindNewest(uint8_t type);
+static void BuildHeader(uint32_t *header, uint8_t type, const void *data,
+	unsigned int length);
+static char ProgramStaged(void);
+static char ProgramRecord(const uint32_t *header, const void *data,
+	unsigned int length);
+static char NextPage(void);
+static char Reclaim(void);
+static char Format(void);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+char Nvm_Init(void)
+{
+	uint32_t newest = 0;
+	uint32_t gen;
+	uint8_t found = FALSE;
+	uint8_t i;
+
+	ready = FALSE;
+	stageHead = stageTail = 0;
+	recordLeft = 0;
+
+	for (i = 0; i < NVM_PAGES; i++) {
+		if (Flash_ReadWord(Page(i)) != NVM_MAGIC) {
+			continue;
+		}
+		gen = Flash_ReadWord(Page(i) + 1);
+		// Signed difference, survives the count wrapping
+		if (!found || (int32_t) (gen - newest) > 0) {
+			newest = gen;
+			active = i;
+			found = TRUE;
+		}
+	}
+
+	if (!found) {
+		if (Format() == ERROR) {
+			return ERROR;
+		}
+	} else {
+		generation = newest;
+		writeWord = FindEnd(active);
+
+		// A reset during a page change leaves the next page unerased
+		if (!PageErased((active + 1) % NVM_PAGES) && Reclaim() == ERROR) {
+			return ERROR;
+		}
+	}
+
+	ready = TRUE;
+	return SUCCESS;
+}
+
+char Nvm_Write(uint8_t type, const void *data, unsigned int length)
+{
+	unsigned int intStatus;
+	unsigned int words = RecordWords(length);
+	char result = ERROR;
+
+	if (!ready || words > STAGE_WORDS) {
+		return ERROR;
+	}
+
+	intStatus = NVM_LOCK();
+	if (stageTail + words <= STAGE_WORDS) {
+		stage[stageTail + words - 1] = FLASH_ERASED;
+		memcpy(&stage[stageTail + RECORD_HEADER], data, length);
+		BuildHeader(&stage[stageTail], type, data, length);
+		stageTail += words;
+		result = SUCCESS;
+	}
+	NVM_UNLOCK(intStatus);
+
+	return result;
+}
+
+char Nvm_WriteNow(uint8_t type, const void *data, unsigned int length)
+{
+	uint32_t header[RECORD_HEADER];
+
+	if (!ready || length > NVM_RECORD_MAX) {
+		return ERROR;
+	}
+
+	// Older buffered records have to land first or they would look newer
+	Nvm_Flush();
+
+	BuildHeader(header, type, data, length);
+	return ProgramRecord(header, data, length);
+}
+
+int Nvm_Read(uint8_t type, void *data, unsigned int size)
+{
+	const uint32_t *record;
+	unsigned int intStatus;
+	unsigned int word;
+	unsigned int length;
+	int found = -1;
+
+	record = FindNewest(type);
+	if (record != NULL) {
+		length = HeaderLength(Flash_ReadWord(record));
+		found = length;
+		if (size < length) {
+			length = size;
+		}
+		Flash_Read(data, record + RECORD_HEADER, length & ~0x03);
+		if (length & 0x03) {
+			word = Flash_ReadWord(record + RECORD_HEADER + (length / 4));
+			memcpy((uint8_t *) data + (length & ~0x03), &word, length & 0x03);
+		}
+	}
+
+	// Anything still buffered is newer than what is in flash
+	intStatus = NVM_LOCK();
+	word = (recordLeft != 0) ? recordStage : stageHead;
+	record = NULL;
+	while (word < stageTail) {
+		if (HeaderType(stage[word]) == type) {
+			record = &stage[word];
+		}
+		word += RecordWords(HeaderLength(stage[word]));
+	}
+	if (record != NULL) {
+		length = HeaderLength(record[0]);
+		found = length;
+		memcpy(data, record + RECORD_HEADER, (size < length) ? size : length);
+	}
+	NVM_UNLOCK(intStatus);
+
+	return found;
+}
+
+uint8_t Nvm_Update(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < NVM_WORDS_PER_UPDATE && stageHead != stageTail; i++) {
+		ProgramStaged();
+	}
+	return FALSE;
+}
+
+char Nvm_Flush(void)
+{
+	char result = SUCCESS;
+
+	while (stageHead != stageTail) {
+		if (ProgramStaged() == ERROR) {
+			result = ERROR;
+		}
+	}
+	return result;
+}
+
+void Nvm_GetStats(NvmStats *stats)
+{
+	stats->generation = generation;
+	stats->activePage = active;
+	stats->freeBytes = (FLASH_PAGE_WORDS - writeWord) * 4;
+	stats->stagedBytes = (stageTail - stageHead) * 4;
+	stats->failures = failures;
+}
+
+#ifdef FLASH_HOST
+
+char Nvm_HostOpen(const char *path)
+{
+	uint32_t *map;
+
+	map = Flash_HostMap(path, NVM_PAGES);
+	if (map == NULL) {
+		return ERROR;
+	}
+	pages = map;
+	return Nvm_Init();
+}
+
+#endif
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static FLASH_CONST uint32_t *Page(uint8_t page)
+{
+	return pages + (page * FLASH_PAGE_WORDS);
+}
+
+static uint8_t PageErased(uint8_t page)
+{
+	unsigned int i;
+
+	for (i = 0; i < FLASH_PAGE_WORDS; i++) {
+		if (Flash_ReadWord(Page(page) + i) != FLASH_ERASED) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * @Function FindEnd(uint8_t page)
+ * @return First free word of the page, FLASH_PAGE_WORDS when a damaged header
+ *         means the rest of it cannot be trusted
+ * @author rcrobert */
+static unsigned int FindEnd(uint8_t page)
+{
+	unsigned int word = PAGE_HEADER;
+
+	while (NextRecord(Page(page), &word) != NULL) {
+	}
+	return word;
+}
+
+/**
+ * @Function NextRecord(FLASH_CONST uint32_t *page, unsigned int *word)
+ * @param word - Where to look, moved past the record found
+ * @return The record at word whether its CRC checks or not, NULL at the end of
+ *         the records. A header that makes no sense sets word to the end of
+ *         the page
+ * @author rcrobert */
+static const uint32_t *NextRecord(FLASH_CONST uint32_t *page, unsigned int *word)
+{
+	const uint32_t *record = page + *word;
+	uint32_t first;
+	uint32_t second;
+	unsigned int words;
+
+	if (*word > FLASH_PAGE_WORDS - RECORD_HEADER) {
+		*word = FLASH_PAGE_WORDS;
+		return NULL;
+	}
+
+	first = Flash_ReadWord(record);
+	second = Flash_ReadWord(record + 1);
+	if (first == FLASH_ERASED) {
+		return NULL;
+	}
+
+	words = RecordWords(HeaderLength(first));
+	if ((HeaderLength(second) ^ 0xFFFF) != HeaderLength(first) ||
+		words > FLASH_PAGE_WORDS - *word) {
+		*word = FLASH_PAGE_WORDS;
+		return NULL;
+	}
+
+	*word += words;
+	return record;
+}
+
+static uint8_t RecordValid(const uint32_t *record)
+{
+	uint32_t first = Flash_ReadWord(record);
+	uint32_t second = Flash_ReadWord(record + 1);
+	uint32_t word;
+	unsigned int length = HeaderLength(first);
+	uint16_t crc;
+
+	crc = Crc16(CRC16_INIT, &first, 4);
+	for (record += RECORD_HEADER; length >= 4; length -= 4) {
+		word = Flash_ReadWord(record++);
+		crc = Crc16(crc, &word, 4);
+	}
+	if (length != 0) {
+		word = Flash_ReadWord(record);
+		crc = Crc16(crc, &word, length);
+	}
+
+	return crc == (second & 0xFFFF);
+}
+
+/**
+ * @Function FindNewest(uint8_t type)
+ * @return Newest record of the type with a good CRC, NULL if there is none
+ * @brief Pages are searched oldest first, the one after the active page is
+ *        the oldest
+ * @author rcrobert */
+static const uint32_t *FindNewest(uint8_t type)
+{
+	const uint32_t *newest = NULL;
+	const uint32_t *record;
+	unsigned int word;
+	uint8_t page;
+	uint8_t i;
+
+	for (i = 1; i <= NVM_PAGES; i++) {
+		page = (active + i) % NVM_PAGES;
+		if (Flash_ReadWord(Page(page)) != NVM_MAGIC) {
+			continue;
+		}
+		word = PAGE_HEADER;
+		while ((record = NextRecord(Page(page), &word)) != NULL) {
+			if (HeaderType(Flash_ReadWord(record)) == type &&
+				RecordValid(record)) {
+				newest = record;
+			}
+		}
+	}
+	return newest;
+}
+
+static void BuildHeader(uint32_t *header, uint8_t type, const void *data,
+	unsigned int length)
+{
+	uint16_t crc;
+
+	header[0] = type | ((uint32_t) length << 16);
+	crc = Crc16(CRC16_INIT, &header[0], 4);
+	crc = Crc16(crc, data, length);
+	header[1] = crc | ((uint32_t) (length ^ 0xFFFF) << 16);
+}
+
+/**
+ * @Function ProgramStaged(void)
+ * @return ERROR if the word did not program, the rest of its record is dropped
+ * @brief Programs the next buffered word, changing pages first when it starts
+ *        a record that does not fit. Interrupts are off from the write until
+ *        the buffer and the page agree again, not for the page change
+ * @author rcrobert */
+static char ProgramStaged(void)
+{
+	unsigned int intStatus;
+	unsigned int words;
+	char result = SUCCESS;
+
+	if (stageHead != stageTail && recordLeft == 0) {
+		words = RecordWords(HeaderLength(stage[stageHead]));
+		if (words > FLASH_PAGE_WORDS - writeWord) {
+			result = NextPage();
+		}
+	}
+
+	intStatus = NVM_LOCK();
+	if (stageHead != stageTail) {
+		if (recordLeft == 0) {
+			// An interrupt can write in between, look again. Still no room
+			// tries another page change next time
+			words = RecordWords(HeaderLength(stage[stageHead]));
+			if (result == SUCCESS && words > FLASH_PAGE_WORDS - writeWord) {
+				NVM_UNLOCK(intStatus);
+				return SUCCESS;
+			}
+			recordStage = stageHead;
+			recordLeft = words;
+			recordEnd = writeWord + words;
+		}
+
+		if (result == SUCCESS) {
+			result = Flash_Write(Page(active) + writeWord, &stage[stageHead], 4);
+		}
+
+		if (result == SUCCESS) {
+			++writeWord;
+			++stageHead;
+			--recordLeft;
+		} else {
+			// Whatever made it into flash fails its CRC, step over all of it
+			++failures;
+			stageHead += recordLeft;
+			recordLeft = 0;
+			writeWord = (recordEnd < FLASH_PAGE_WORDS) ? recordEnd : FLASH_PAGE_WORDS;
+		}
+
+		if (stageHead == stageTail) {
+			stageHead = stageTail = 0;
+		}
+	}
+	NVM_UNLOCK(intStatus);
+
+	return result;
+}
+
+/**
+ * @Function ProgramRecord(const uint32_t *header, const void *data, unsigned int length)
+ * @return ERROR if the record could not be programmed
+ * @brief Header first, so a reset part way leaves a record that fails its CRC
+ *        rather than data with nothing in front of it. The space is claimed
+ *        up front, a record written from an interrupt meanwhile goes after it
+ * @author rcrobert */
+static char ProgramRecord(const uint32_t *header, const void *data,
+	unsigned int length)
+{
+	FLASH_CONST uint32_t *out;
+	unsigned int intStatus;
+	unsigned int words = RecordWords(length);
+	unsigned int whole = length & ~0x03;
+	uint32_t tail = FLASH_ERASED;
+	char result;
+
+	if (words > FLASH_PAGE_WORDS - writeWord && NextPage() == ERROR) {
+		++failures;
+		return ERROR;
+	}
+
+	intStatus = NVM_LOCK();
+	if (words > FLASH_PAGE_WORDS - writeWord) {
+		NVM_UNLOCK(intStatus);
+		++failures;
+		return ERROR;
+	}
+	out = Page(active) + writeWord;
+	writeWord += words;
+	NVM_UNLOCK(intStatus);
+
+	result = Flash_Write(out, header, RECORD_HEADER * 4);
+	if (result == SUCCESS) {
+		result = Flash_Write(out + RECORD_HEADER, data, whole);
+	}
+	if (result == SUCCESS && whole != length) {
+		memcpy(&tail, (const uint8_t *) data + whole, length - whole);
+		result = Flash_Write(out + RECORD_HEADER + (whole / 4), &tail, 4);
+	}
+
+	if (result == ERROR) {
+		++failures;
+	}
+	return result;
+}
+
+/**
+ * @Function NextPage(void)
+ * @return ERROR if the spare page would not take a header
+ * @brief Moves writing to the spare page and turns the oldest page into the
+ *        next spare. Fails from an interrupt that lands in the middle of
+ *        another page change
+ * @author rcrobert */
+static char NextPage(void)
+{
+	uint8_t spare;
+	uint32_t header[PAGE_HEADER];
+	unsigned int intStatus;
+	char result = ERROR;
+
+	// The spare is opened with interrupts off, the CPU stalls for the erase
+	// anyway. The copying after it is what takes the time
+	intStatus = NVM_LOCK();
+	if (!reclaiming) {
+		spare = (active + 1) % NVM_PAGES;
+		header[0] = NVM_MAGIC;
+		header[1] = generation + 1;
+		if ((PageErased(spare) || Flash_ErasePage(Page(spare)) == SUCCESS) &&
+			Flash_Write(Page(spare), header, sizeof (header)) == SUCCESS) {
+			active = spare;
+			++generation;
+			writeWord = PAGE_HEADER;
+			reclaiming = TRUE;
+			result = SUCCESS;
+		}
+	}
+	NVM_UNLOCK(intStatus);
+
+	if (result == SUCCESS) {
+		result = Reclaim();
+		reclaiming = FALSE;
+	}
+	return result;
+}
+
+/**
+ * @Function Reclaim(void)
+ * @return ERROR if the oldest page would not erase
+ * @brief Copies the newest record of each lasting type that only lives in the
+ *        oldest page into the active page, then erases the oldest page. Safe
+ *        to run again after a reset, a copy already made is simply newer
+ * @author rcrobert */
+static char Reclaim(void)
+{
+	uint8_t oldest = (active + 1) % NVM_PAGES;
+	const uint32_t *record;
+	uint32_t header[RECORD_HEADER];
+	unsigned int intStatus;
+	unsigned int word = PAGE_HEADER;
+	char result;
+
+	if (Flash_ReadWord(Page(oldest)) == NVM_MAGIC) {
+		while ((record = NextRecord(Page(oldest), &word)) != NULL) {
+			header[0] = Flash_ReadWord(record);
+			if (HeaderType(header[0]) >= NVM_TYPE_LOG ||
+				FindNewest(HeaderType(header[0])) != record) {
+				continue;
+			}
+
+			// Never another page change from in here, the lasting types are small
+			if (RecordWords(HeaderLength(header[0])) > FLASH_PAGE_WORDS - writeWord) {
+				++failures;
+				continue;
+			}
+			header[1] = Flash_ReadWord(record + 1);
+			ProgramRecord(header, record + RECORD_HEADER, HeaderLength(header[0]));
+		}
+	}
+
+	intStatus = NVM_LOCK();
+	result = Flash_ErasePage(Page(oldest));
+	NVM_UNLOCK(intStatus);
+
+	return result;
+}
+
+/**
+ * @Function Format(void)
+ * @return ERROR if a page would not erase
+ * @brief Blank storage, every page erased and the first one opened
+ * @author rcrobert */
+static char Format(void)
+{
+	uint32_t header[PAGE_HEADER] = {NVM_MAGIC, 1};
+	uint8_t i;
+
+	for (i = 0; i < NVM_PAGES; i++) {
+		if (!PageErased(i) && Flash_ErasePage(Page(i)) == ERROR) {
+			return ERROR;
+		}
+	}
+
+	active = 0;
+	generation = 1;
+	writeWord = PAGE_HEADER;
+	return Flash_Write(Page(0), header, sizeof (header));
+}
+
+
+//#define NVM_TEST
+#ifdef NVM_TEST
+
+/*
+ * PC only, build with FLASH_HOST. Runs the storage through a few thousand
+ * page changes in a file and checks the calibration records always survive,
+ * every page wears the same, a reopen finds everything again and damaged or
+ * half finished writes are stepped over.
+ *   gcc -std=gnu99 -DFLASH_HOST -DNVM_TEST Nvm.c Flash.c Crc16.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TEST_FILE "nvm_test.bin"
+#define TEST_BLACKBOXES 3000
+#define TEST_BLACKBOX_SIZE 1500
+
+typedef struct {
+	uint32_t saved;
+	int16_t values[12];
+} TestCal;
+
+static uint8_t blackBox[TEST_BLACKBOX_SIZE];
+static unsigned int pageChanges[NVM_PAGES];
+static int failed = 0;
+
+static void Check(int condition, const char *what)
+{
+	if (!condition) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void CheckCal(uint8_t type, uint32_t saved)
+{
+	TestCal cal;
+
+	Check(Nvm_Read(type, &cal, sizeof (cal)) == sizeof (cal) && cal.saved == saved &&
+		cal.values[11] == (int16_t) (saved * 11), "newest calibration reads back");
+}
+
+static void SaveCal(uint8_t type, uint32_t saved)
+{
+	TestCal cal;
+	int i;
+
+	cal.saved = saved;
+	for (i = 0; i < 12; i++) {
+		cal.values[i] = saved * i;
+	}
+	Check(Nvm_Write(type, &cal, sizeof (cal)) == SUCCESS, "calibration buffered");
+}
+
+int main(void)
+{
+	NvmStats stats;
+	uint32_t *flash;
+	uint32_t tapeSaved = 0;
+	uint32_t lastGeneration;
+	unsigned int low = ~0U;
+	unsigned int high = 0;
+	unsigned int i;
+	int length;
+	uint8_t odd[7];
+
+	unlink(TEST_FILE);
+	Check(Nvm_HostOpen(TEST_FILE) == SUCCESS, "blank file formats");
+	Check(Nvm_Read(NVM_TYPE_CAL_TAPE, odd, sizeof (odd)) == -1, "blank has no records");
+
+	// Buffered records read back before and after they are programmed
+	SaveCal(NVM_TYPE_CAL_BEACON, 7);
+	CheckCal(NVM_TYPE_CAL_BEACON, 7);
+	Nvm_GetStats(&stats);
+	Check(stats.stagedBytes == 4 * RecordWords(sizeof (TestCal)), "record is buffered");
+	while (stats.stagedBytes != 0) {
+		Nvm_Update();
+		Nvm_GetStats(&stats);
+	}
+	CheckCal(NVM_TYPE_CAL_BEACON, 7);
+
+	// Odd lengths keep their bytes and get padded
+	Check(Nvm_WriteNow(NVM_TYPE_CAL_ODOMETRY, "abcdefg", 7) == SUCCESS, "odd write");
+	Check(Nvm_Read(NVM_TYPE_CAL_ODOMETRY, odd, 7) == 7 && memcmp(odd, "abcdefg", 7) == 0,
+		"odd length reads back");
+
+	// Black boxes fill pages, the tape table keeps changing, beacon never does
+	Nvm_GetStats(&stats);
+	lastGeneration = stats.generation;
+	for (i = 0; i < TEST_BLACKBOXES && !failed; i++) {
+		memset(blackBox, i, sizeof (blackBox));
+		Check(Nvm_WriteNow(NVM_TYPE_BLACKBOX, blackBox, sizeof (blackBox)) == SUCCESS,
+			"black box written");
+		if (i % 3 == 0) {
+			SaveCal(NVM_TYPE_CAL_TAPE, ++tapeSaved);
+			Nvm_Update();
+		}
+		CheckCal(NVM_TYPE_CAL_TAPE, tapeSaved);
+
+		Nvm_GetStats(&stats);
+		if (stats.generation != lastGeneration) {
+			++pageChanges[stats.activePage];
+			lastGeneration = stats.generation;
+		}
+	}
+	Nvm_Flush();
+	CheckCal(NVM_TYPE_CAL_BEACON, 7);
+	CheckCal(NVM_TYPE_CAL_TAPE, tapeSaved);
+	Check(Nvm_Read(NVM_TYPE_BLACKBOX, blackBox, sizeof (blackBox)) == TEST_BLACKBOX_SIZE &&
+		blackBox[0] == (uint8_t) (TEST_BLACKBOXES - 1), "newest black box reads back");
+
+	for (i = 0; i < NVM_PAGES; i++) {
+		low = (pageChanges[i] < low) ? pageChanges[i] : low;
+		high = (pageChanges[i] > high) ? pageChanges[i] : high;
+	}
+	Nvm_GetStats(&stats);
+	printf("%u page changes, erases per page %u to %u, %u failures\n",
+		(unsigned int) stats.generation, low, high, stats.failures);
+	Check(high - low <= 1, "pages wear evenly");
+	Check(stats.failures == 0, "no write failures");
+
+	// Everything is still there after a restart
+	Check(Nvm_HostOpen(TEST_FILE) == SUCCESS, "reopen");
+	CheckCal(NVM_TYPE_CAL_BEACON, 7);
+	CheckCal(NVM_TYPE_CAL_TAPE, tapeSaved);
+
+	// A damaged newest copy falls back to the one before
+	SaveCal(NVM_TYPE_CAL_TAPE, tapeSaved + 1);
+	Nvm_Flush();
+	Nvm_GetStats(&stats);
+	flash = Flash_HostMap(TEST_FILE, NVM_PAGES);
+	flash[(stats.activePage * FLASH_PAGE_WORDS) + (FLASH_PAGE_WORDS - stats.freeBytes / 4) - 1] = 0;
+	CheckCal(NVM_TYPE_CAL_TAPE, tapeSaved);
+
+	// Reset half way through a page change, the spare still holds data
+	flash[(((stats.activePage + 1) % NVM_PAGES) * FLASH_PAGE_WORDS) + 100] = 0x12345678;
+	Check(Nvm_HostOpen(TEST_FILE) == SUCCESS, "reopen after a cut page change");
+	CheckCal(NVM_TYPE_CAL_BEACON, 7);
+	CheckCal(NVM_TYPE_CAL_TAPE, tapeSaved);
+	Check(flash[(((stats.activePage + 1) % NVM_PAGES) * FLASH_PAGE_WORDS) + 100] == FLASH_ERASED,
+		"spare erased again");
+
+	// A record the buffer can never hold is refused, not split
+	length = Nvm_Write(NVM_TYPE_CAL_TAPE, blackBox, NVM_STAGE_SIZE);
+	Check(length == ERROR, "oversize buffered write refused");
+
+	unlink(TEST_FILE);
+	printf(failed ? "NVM test FAILED\n" : "NVM test passed\n");
+	return failed;
+}
+
+#endif // NVM_TEST
@@ -0,0 +1,169 @@
+/*
+ * File:   Nvm.h
+ * Author: rcrobert
+ *
+ * Typed records kept in program flash across power cycles. Records are only
+ * ever appended, Nvm_Read returns the newest copy of a type, so updating a
+ * calibration table is just writing it again.
+ *
+ * NVM_PAGES flash pages are used in a ring with one page always erased. When
+ * the page being written fills up the spare becomes the new one, the newest
+ * copy of every type below NVM_TYPE_LOG that only exists in the oldest page
+ * is carried into it and the oldest page is erased to become the spare. Every
+ * page sees the same number of erases and logs like the black box fall off
+ * the end on their own. Each page starts with a generation count, the total
+ * number of page changes, so the erases per page are about
+ * generation / NVM_PAGES. At the PIC32's 1000 guaranteed erases that is a
+ * few thousand black boxes or tens of thousands of calibration saves.
+ *
+ * Page layout, words
+ *  0  NVM_MAGIC
+ *  1  generation
+ *  2  records until an erased word
+ *
+ * Record layout
+ *  0  u16 type, u16 length in bytes
+ *  1  u16 CRC16 of type, length and data, u16 length ^ 0xFFFF
+ *  2  data, padded with ones to a whole word
+ * A record cut short by a reset fails its CRC and is skipped.
+ *
+ * Nvm_Write only copies the record into a RAM buffer, Nvm_Update programs a
+ * few words from it each idle pass so the service queues barely notice. A
+ * page change still stalls for the ~20ms erase. Nvm_WriteNow programs
+ * straight away for the times there is no idle pass to wait for: crashes and
+ * undervoltage.
+ *
+ * Building with FLASH_HOST keeps the pages in a file, see Nvm_HostOpen and
+ * the NVM_TEST harness in Nvm.c.
+ *
+ * Created on December 12, 2014, 11:40 AM
+ */
+
+#ifndef NVM_H
+#define	NVM_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+#define NVM_PAGES 4
+
+// Write-behind buffer, records plus 8 bytes of header each
+#define NVM_STAGE_SIZE 256
+
+// Flash words programmed per Nvm_Update, about 20us each
+#define NVM_WORDS_PER_UPDATE 8
+
+// Largest record that fits a page next to its header
+#define NVM_RECORD_MAX (4096 - 16)
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+// Types below NVM_TYPE_LOG always keep their newest copy, the rest age out.
+// The CAL types are reserved, nothing measures those tables yet
+typedef enum {
+    NVM_TYPE_CAL_TAPE = 0x01,
+    NVM_TYPE_CAL_BEACON,
+    NVM_TYPE_CAL_ODOMETRY,
+
+    NVM_TYPE_LOG = 0x80,
+    NVM_TYPE_BLACKBOX = NVM_TYPE_LOG,
+} NvmType_t;
+
+typedef struct {
+    uint32_t generation;    // page changes since the storage was formatted
+    uint16_t activePage;
+    uint16_t freeBytes;     // left in the active page
+    uint16_t stagedBytes;   // waiting for Nvm_Update
+    uint16_t failures;      // writes that did not verify
+} NvmStats;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function Nvm_Init(void)
+ * @return ERROR if the storage could not be brought into a usable state
+ * @brief Finds the newest page and the end of its records. Blank storage is
+ *        formatted and a page change cut short by a reset is finished, both
+ *        can erase a page
+ * @author rcrobert 2014.12.12
+ */
+char Nvm_Init(void);
+
+/**
+ * @Function Nvm_Write(uint8_t type, const void *data, unsigned int length)
+ * @param type - An NvmType_t
+ * @param data - Copied before this returns
+ * @param length - Up to NVM_STAGE_SIZE - 8 bytes
+ * @return ERROR if the write-behind buffer has no room for it
+ * @brief Queues the record for Nvm_Update, Nvm_Read sees it right away
+ * @author rcrobert 2014.12.12
+ */
+char Nvm_Write(uint8_t type, const void *data, unsigned int length);
+
+/**
+ * @Function Nvm_WriteNow(uint8_t type, const void *data, unsigned int length)
+ * @param type - An NvmType_t
+ * @param data - Bytes to store
+ * @param length - Up to NVM_RECORD_MAX bytes
+ * @return ERROR if it was not stored
+ * @brief Flushes the buffer and programs the record before returning. Safe
+ *        from an interrupt or exception handler, interrupts stay off while
+ *        flash is programmed so no other writer is ever caught half way
+ * @author rcrobert 2014.12.12
+ */
+char Nvm_WriteNow(uint8_t type, const void *data, unsigned int length);
+
+/**
+ * @Function Nvm_Read(uint8_t type, void *data, unsigned int size)
+ * @param type - An NvmType_t
+ * @param data - Gets up to size bytes of the newest record of that type
+ * @param size - Room in data
+ * @return Length of the stored record, which can be more than size, -1 if
+ *         there is none
+ * @author rcrobert 2014.12.12
+ */
+int Nvm_Read(uint8_t type, void *data, unsigned int size);
+
+/**
+ * @Function Nvm_Update(void)
+ * @return FALSE, never posts
+ * @brief Programs up to NVM_WORDS_PER_UPDATE buffered words. Lives in
+ *        EVENT_CHECK_LIST
+ * @author rcrobert 2014.12.12
+ */
+uint8_t Nvm_Update(void);
+
+/**
+ * @Function Nvm_Flush(void)
+ * @return ERROR if a buffered record could not be programmed, it is dropped
+ * @brief Programs everything still buffered before returning
+ * @author rcrobert 2014.12.12
+ */
+char Nvm_Flush(void);
+
+/**
+ * @Function Nvm_GetStats(NvmStats *stats)
+ * @return None
+ * @author rcrobert 2014.12.12
+ */
+void Nvm_GetStats(NvmStats *stats);
+
+#ifdef FLASH_HOST
+/**
+ * @Function Nvm_HostOpen(const char *path)
+ * @param path - Flash image, NVM_PAGES pages, created blank if missing
+ * @return ERROR if the file could not be mapped or Nvm_Init failed
+ * @brief PC builds only, use in place of Nvm_Init
+ * @author rcrobert 2014.12.12
+ */
+char Nvm_HostOpen(const char *path);
+#endif
+
+#endif	/* NVM_H */
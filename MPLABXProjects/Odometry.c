@@ -0,0 +1,366 @@
+/*
+ * File:   Odometry.c
+ * Author: rcrobert
+ *
+ * Pose estimate from the encoders, mouse and motor commands. See Odometry.h
+ *
+ * Created on December 8, 2014, 1:40 PM
+ */
+
+#include <BOARD.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "EventCheckerService.h"
+#include "MotorDriver.h"
+#include "MotorEncoder.h"
+#include "SerialMouse.h"
+#include "Odometry.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES
+ ******************************************************************************/
+
+// 2^32 / (2 * pi), micrometers of wheel difference over the base to Q16 BAM
+#define THETA_Q32_PER_RAD (683565276LL)
+
+// Q8 weights
+#define WEIGHT_ONE (256)
+
+// Saturate covariance terms well short of overflowing the next prediction
+#define COV_MAX (0x3FFFFFFF)
+
+/*******************************************************************************
+ * PRIVATE VARIABLES
+ ******************************************************************************/
+
+// First quadrant of sine in Q14, 64 steps plus the endpoint for interpolation
+static const int16_t SineTable[65] = {
+	0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196, 3590, 3981, 4370, 4756,
+	5139, 5520, 5897, 6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765, 9102,
+	9434, 9760, 10080, 10394, 10702, 11003, 11297, 11585, 11866, 12140, 12406,
+	12665, 12916, 13160, 13395, 13623, 13842, 14053, 14256, 14449, 14635, 14811,
+	14978, 15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986, 16069, 16143,
+	16207, 16261, 16305, 16340, 16364, 16379, 16384
+};
+
+static uint8_t isInitialized = FALSE;
+static uint8_t mouseAdded = FALSE;
+
+// Pose, heading kept in Q16 so small turns still accumulate
+static int32_t poseX;
+static int32_t poseY;
+static uint32_t thetaQ;
+static OdomCovariance P;
+
+// Raw sensor totals at the last update
+static int32_t lastLeft;
+static int32_t lastRight;
+static int32_t lastMouse;
+static uint8_t mouseSynced = FALSE;
+
+// Slip window
+static uint8_t windowCount;
+static int32_t windowEncoder;
+static int32_t windowMouse;
+static int32_t windowTravel;
+static int32_t windowCommand;
+
+static uint8_t flags = ODOM_FLAG_NO_MOUSE;
+static uint32_t lastUpdate;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES
+ ******************************************************************************/
+
+static int32_t Sine(uint16_t angle);
+static int32_t Cosine(uint16_t angle);
+static int32_t Sat32(int64_t x);
+static void Predict(int32_t ds, int32_t travel, uint16_t heading,
+	int32_t noise);
+static uint8_t CheckSlip(void);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+char Odometry_Init(void)
+{
+	EncoderSnapshot snap;
+
+	// Encoder_Init fails when already running, only the pins matter here
+	Encoder_Init();
+	if (Encoder_AddQuadPins(ODOM_ENCODER_LEFT_A, ODOM_ENCODER_LEFT_B) == ERROR ||
+		Encoder_AddQuadPins(ODOM_ENCODER_RIGHT_A, ODOM_ENCODER_RIGHT_B) == ERROR) {
+		return ERROR;
+	}
+
+	Encoder_GetSnapshot(ODOM_ENCODER_LEFT_A, &snap);
+	lastLeft = snap.count;
+	Encoder_GetSnapshot(ODOM_ENCODER_RIGHT_A, &snap);
+	lastRight = snap.count;
+
+	// Mouse is optional, encoders carry on alone without it
+	SerialMouse_Init();
+	if (SerialMouse_AddPins(ODOM_MOUSE_CLK, ODOM_MOUSE_DATA) == SUCCESS &&
+		SerialMouse_Start() == SUCCESS) {
+		mouseAdded = TRUE;
+	}
+	mouseSynced = FALSE;
+
+	poseX = 0;
+	poseY = 0;
+	thetaQ = 0;
+	P.xx = 0;
+	P.yy = 0;
+	P.xy = 0;
+	P.xt = 0;
+	P.yt = 0;
+	P.tt = 0;
+
+	windowCount = 0;
+	windowEncoder = 0;
+	windowMouse = 0;
+	windowTravel = 0;
+	windowCommand = 0;
+	flags = ODOM_FLAG_NO_MOUSE;
+
+	lastUpdate = ES_Timer_GetTime();
+	isInitialized = TRUE;
+
+	return SUCCESS;
+}
+
+uint8_t Odometry_Update(void)
+{
+	EncoderSnapshot snap;
+	Coordinate mouse;
+	int32_t dLeft;
+	int32_t dRight;
+	int32_t dsEncoder;
+	int32_t dsMouse = 0;
+	int32_t ds;
+	int32_t travel;
+	int32_t dTheta;
+	int32_t weight;
+	int32_t noise;
+	int cmdLeft;
+	int cmdRight;
+	uint32_t now;
+
+	if (!isInitialized) {
+		return FALSE;
+	}
+
+	// Fixed rate, the filter noise is tuned per step
+	now = ES_Timer_GetTime();
+	if ((now - lastUpdate) < ODOM_PERIOD_MS) {
+		return FALSE;
+	}
+	lastUpdate = now;
+
+	// Wheel travel in micrometers since the last step
+	Encoder_GetSnapshot(ODOM_ENCODER_LEFT_A, &snap);
+	dLeft = (snap.count - lastLeft) * ODOM_UM_PER_COUNT;
+	lastLeft = snap.count;
+	Encoder_GetSnapshot(ODOM_ENCODER_RIGHT_A, &snap);
+	dRight = (snap.count - lastRight) * ODOM_UM_PER_COUNT;
+	lastRight = snap.count;
+
+	dsEncoder = (dLeft + dRight) / 2;
+	travel = ((dLeft < 0) ? -dLeft : dLeft) + ((dRight < 0) ? -dRight : dRight);
+	travel /= 2;
+
+	// Forward travel seen by the mouse, rebaseline after any restart
+	if (mouseAdded && SerialMouse_IsStreaming()) {
+		mouse = SerialMouse_Read();
+		if (mouseSynced) {
+			dsMouse = (mouse.dy - lastMouse) * ODOM_MOUSE_UM_PER_COUNT;
+			flags &= ~ODOM_FLAG_NO_MOUSE;
+		}
+		lastMouse = mouse.dy;
+		mouseSynced = TRUE;
+	} else {
+		mouseSynced = FALSE;
+		flags |= ODOM_FLAG_NO_MOUSE;
+	}
+
+	// Complementary blend, mouse alone while the wheels are slipping
+	if (flags & ODOM_FLAG_NO_MOUSE) {
+		weight = 0;
+	} else if (flags & ODOM_FLAG_SLIP) {
+		weight = WEIGHT_ONE;
+	} else {
+		weight = ODOM_MOUSE_WEIGHT;
+	}
+	ds = (int32_t) (((int64_t) dsMouse * weight +
+		(int64_t) dsEncoder * (WEIGHT_ONE - weight)) / WEIGHT_ONE);
+	noise = (ODOM_NOISE_MOUSE * weight +
+		ODOM_NOISE_ENCODER * (WEIGHT_ONE - weight)) / WEIGHT_ONE;
+
+	// Heading only from the wheels, mouse sits on the axle and cannot see it
+	dTheta = (int32_t) (((int64_t) (dRight - dLeft) * THETA_Q32_PER_RAD) /
+		ODOM_WHEEL_BASE_UM);
+
+	// Move along the mid step heading
+	Predict(ds, travel, (uint16_t) ((thetaQ + (dTheta / 2)) >> 16), noise);
+	thetaQ += dTheta;
+
+	// Slip and stall are judged over a window, single steps are too noisy
+	Drive_GetCommand(&cmdLeft, &cmdRight);
+	windowEncoder += (dsEncoder < 0) ? -dsEncoder : dsEncoder;
+	windowMouse += (dsMouse < 0) ? -dsMouse : dsMouse;
+	windowTravel += travel;
+	windowCommand += (((cmdLeft < 0) ? -cmdLeft : cmdLeft) +
+		((cmdRight < 0) ? -cmdRight : cmdRight)) / 2;
+	if (++windowCount < ODOM_SLIP_WINDOW) {
+		return FALSE;
+	}
+
+	return CheckSlip();
+}
+
+void Odometry_GetPose(OdomPose *pose, OdomCovariance *cov)
+{
+	pose->x = poseX;
+	pose->y = poseY;
+	pose->theta = (uint16_t) (thetaQ >> 16);
+
+	if (cov != NULL) {
+		*cov = P;
+	}
+}
+
+uint8_t Odometry_GetFlags(void)
+{
+	return flags;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS
+ ******************************************************************************/
+
+static int32_t Sine(uint16_t angle)
+{
+	uint16_t index;
+	int32_t value;
+
+	// Fold into the first quadrant, then interpolate between table steps
+	index = angle & 0x3FFF;
+	if (angle & 0x4000) {
+		index = 0x4000 - index;
+	}
+
+	value = SineTable[index >> 8];
+	if (index < 0x4000) {
+		value += ((SineTable[(index >> 8) + 1] - value) * (index & 0xFF)) >> 8;
+	}
+
+	return (angle & 0x8000) ? -value : value;
+}
+
+static int32_t Cosine(uint16_t angle)
+{
+	return Sine(angle + 0x4000);
+}
+
+static int32_t Sat32(int64_t x)
+{
+	if (x > COV_MAX) {
+		return COV_MAX;
+	}
+	if (x < -COV_MAX) {
+		return -COV_MAX;
+	}
+	return (int32_t) x;
+}
+
+/*
+ * EKF prediction for the unicycle model
+ * x' = x + ds cos(t), y' = y + ds sin(t), t' = t + dt
+ * Jacobian on the state is identity plus a = -ds sin(t) and b = ds cos(t) in
+ * the heading column, kept as mm per mrad in Q16
+ */
+static void Predict(int32_t ds, int32_t travel, uint16_t heading,
+	int32_t noise)
+{
+	int32_t s;
+	int32_t c;
+	int64_t a;
+	int64_t b;
+	int64_t varS;
+	int64_t varT;
+	OdomCovariance old = P;
+
+	s = Sine(heading);
+	c = Cosine(heading);
+
+	poseX += (int32_t) (((int64_t) ds * c + (1 << 13)) >> 14);
+	poseY += (int32_t) (((int64_t) ds * s + (1 << 13)) >> 14);
+
+	// um * Q14 to mm/mrad Q16 is times 4 over 10^6
+	a = -((int64_t) ds * s * 4) / 1000000;
+	b = ((int64_t) ds * c * 4) / 1000000;
+
+	// F P F'
+	P.xx = Sat32(old.xx + ((2 * a * old.xt) >> 16) +
+		((((a * a) >> 16) * old.tt) >> 16));
+	P.yy = Sat32(old.yy + ((2 * b * old.yt) >> 16) +
+		((((b * b) >> 16) * old.tt) >> 16));
+	P.xy = Sat32(old.xy + ((a * old.yt) >> 16) + ((b * old.xt) >> 16) +
+		((((a * b) >> 16) * old.tt) >> 16));
+	P.xt = Sat32(old.xt + ((a * old.tt) >> 16));
+	P.yt = Sat32(old.yt + ((b * old.tt) >> 16));
+
+	// Process noise grows with distance, travel error along the heading
+	varS = ((int64_t) ((ds < 0) ? -ds : ds) * noise) / 1000;
+	varT = ((int64_t) travel * ODOM_NOISE_HEADING) / 1000;
+
+	P.xx = Sat32(P.xx + ((varS * c * c) >> 28));
+	P.yy = Sat32(P.yy + ((varS * s * s) >> 28));
+	P.xy = Sat32(P.xy + ((varS * c * s) >> 28));
+	P.tt = Sat32(old.tt + varT);
+}
+
+static uint8_t CheckSlip(void)
+{
+	ES_Event PostEvent;
+	EventStorage EventData;
+	uint8_t newFlags;
+	int32_t command;
+
+	newFlags = flags & ~(ODOM_FLAG_SLIP | ODOM_FLAG_STALL);
+	command = windowCommand / ODOM_SLIP_WINDOW;
+
+	// Wheels turning but the floor is not moving under the mouse
+	if (!(flags & ODOM_FLAG_NO_MOUSE) && windowEncoder >= ODOM_SLIP_MIN_UM &&
+		((int64_t) windowMouse * 100) <
+		((int64_t) windowEncoder * ODOM_SLIP_PERCENT)) {
+		newFlags |= ODOM_FLAG_SLIP;
+	}
+
+	// Driven and no wheel turns at all, motors stalled against something
+	if (command >= ODOM_STALL_COMMAND && windowTravel < ODOM_STALL_MAX_UM &&
+		((flags & ODOM_FLAG_NO_MOUSE) || windowMouse < ODOM_STALL_MAX_UM)) {
+		newFlags |= ODOM_FLAG_STALL;
+	}
+
+	windowCount = 0;
+	windowEncoder = 0;
+	windowMouse = 0;
+	windowTravel = 0;
+	windowCommand = 0;
+
+	EventData.bits.event = (newFlags ^ flags) & (ODOM_FLAG_SLIP | ODOM_FLAG_STALL);
+	EventData.bits.type = newFlags & (ODOM_FLAG_SLIP | ODOM_FLAG_STALL);
+	flags = newFlags;
+
+	if (EventData.bits.event == 0x00) {
+		return FALSE;
+	}
+
+	PostEvent.EventType = WHEEL_SLIP;
+	PostEvent.EventParam = EventData.val;
+	PostToMainHSM(PostEvent);
+
+	return TRUE;
+}
@@ -0,0 +1,90 @@
+/*
+ * File:   Odometry.h
+ * Author: rcrobert
+ *
+ * Fuses the wheel encoders, the optical mouse and the commanded motor speeds
+ * into one pose estimate. Runs an extended Kalman prediction at a fixed rate,
+ * the measured forward travel is a complementary blend of encoders and mouse
+ * weighted by how much each is trusted at the moment. Everything is fixed
+ * point.
+ *
+ * Units
+ * x, y      - micrometers from where Odometry_Init was called
+ * theta     - binary angle, 65536 per revolution, counter clockwise
+ * Covariance Q8 throughout, position terms in mm^2, heading in mrad^2 and
+ * cross terms in mm * mrad
+ *
+ * Posts WHEEL_SLIP when the mouse sees much less travel than the encoders,
+ * or when the motors are driven and nothing moves. The param is an
+ * EventStorage with ODOM_FLAG_* bits, type holds the flags set now and event
+ * holds the ones that just changed.
+ *
+ * Created on December 8, 2014, 1:40 PM
+ */
+
+#ifndef ODOMETRY_H
+#define	ODOMETRY_H
+
+#include <inttypes.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES
+ ******************************************************************************/
+
+#define ODOM_FLAG_SLIP 0x01	// wheels turning faster than the ground moves
+#define ODOM_FLAG_STALL 0x02	// driven, but neither encoders nor mouse move
+#define ODOM_FLAG_NO_MOUSE 0x04	// mouse not streaming, encoders only
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS
+ ******************************************************************************/
+
+typedef struct {
+	int32_t x;
+	int32_t y;
+	uint16_t theta;
+} OdomPose;
+
+typedef struct {
+	int32_t xx;
+	int32_t yy;
+	int32_t xy;
+	int32_t xt;
+	int32_t yt;
+	int32_t tt;
+} OdomCovariance;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES
+ ******************************************************************************/
+
+/**
+ * @Function Odometry_Init(void)
+ * @return ERROR if the encoders could not be set up, else SUCCESS
+ * @brief Starts the encoders and the mouse and zeroes the pose
+ * @author rcrobert */
+char Odometry_Init(void);
+
+/**
+ * @Function Odometry_Update(void)
+ * @return TRUE if WHEEL_SLIP was posted
+ * @brief Runs one filter step every ODOM_PERIOD_MS, call as often as wanted.
+ *        Lives in EVENT_CHECK_LIST
+ * @author rcrobert */
+uint8_t Odometry_Update(void);
+
+/**
+ * @Function Odometry_GetPose(OdomPose *pose, OdomCovariance *cov)
+ * @param pose - filled with the current estimate
+ * @param cov - filled with its covariance, may be NULL
+ * @return None
+ * @author rcrobert */
+void Odometry_GetPose(OdomPose *pose, OdomCovariance *cov);
+
+/**
+ * @Function Odometry_GetFlags(void)
+ * @return ODOM_FLAG_* bits as of the last update
+ * @author rcrobert */
+uint8_t Odometry_GetFlags(void);
+
+#endif	/* ODOMETRY_H */
@@ -0,0 +1,377 @@
+/*
+ * File:   RingBuffer.c
+ * Author: rcrobert
+ *
+ * Single producer, single consumer byte ring. See RingBuffer.h
+ *
+ * Created on December 9, 2014, 7:15 PM
+ */
+
+#include <string.h>
+#include <BOARD.h>
+#include "RingBuffer.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+/*
+ * The PIC32 is single core and the other side is always an interrupt, keeping
+ * the compiler from reordering is enough there. A PC test runs real threads
+ */
+#ifdef __PIC32MX__
+#define RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define RING_BARRIER() __sync_synchronize()
+#endif
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static inline uint32_t LoadAcquire(const volatile uint32_t *index);
+static inline void StoreRelease(volatile uint32_t *index, uint32_t value);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+char RingBuffer_Init(RingBuffer *rb, uint8_t *storage, uint32_t size)
+{
+    if (size == 0 || (size & (size - 1)) != 0) {
+	return ERROR;
+    }
+
+    rb->buffer = storage;
+    rb->mask = size - 1;
+    rb->head = 0;
+    rb->tail = 0;
+
+    return SUCCESS;
+}
+
+uint32_t RingBuffer_Count(const RingBuffer *rb)
+{
+    return LoadAcquire(&rb->tail) - LoadAcquire(&rb->head);
+}
+
+uint32_t RingBuffer_Space(const RingBuffer *rb)
+{
+    return (rb->mask + 1) - RingBuffer_Count(rb);
+}
+
+char RingBuffer_Put(RingBuffer *rb, uint8_t data)
+{
+    uint32_t tail = rb->tail;
+
+    if ((tail - LoadAcquire(&rb->head)) > rb->mask) {
+	return ERROR;
+    }
+
+    rb->buffer[tail & rb->mask] = data;
+    StoreRelease(&rb->tail, tail + 1);
+
+    return SUCCESS;
+}
+
+char RingBuffer_Get(RingBuffer *rb, uint8_t *data)
+{
+    uint32_t head = rb->head;
+
+    if (LoadAcquire(&rb->tail) == head) {
+	return ERROR;
+    }
+
+    *data = rb->buffer[head & rb->mask];
+    StoreRelease(&rb->head, head + 1);
+
+    return SUCCESS;
+}
+
+char RingBuffer_Peek(const RingBuffer *rb, uint8_t *data)
+{
+    uint32_t head = rb->head;
+
+    if (LoadAcquire(&rb->tail) == head) {
+	return ERROR;
+    }
+
+    *data = rb->buffer[head & rb->mask];
+
+    return SUCCESS;
+}
+
+uint32_t RingBuffer_Write(RingBuffer *rb, const void *data, uint32_t length)
+{
+    uint32_t tail = rb->tail;
+    uint32_t space;
+    uint32_t offset;
+    uint32_t first;
+
+    space = (rb->mask + 1) - (tail - LoadAcquire(&rb->head));
+    if (length > space) {
+	length = space;
+    }
+    if (length == 0) {
+	return 0;
+    }
+
+    // Up to the end of storage, then the rest from the start
+    offset = tail & rb->mask;
+    first = (rb->mask + 1) - offset;
+    if (first > length) {
+	first = length;
+    }
+    memcpy(&rb->buffer[offset], data, first);
+    memcpy(rb->buffer, (const uint8_t *) data + first, length - first);
+
+    StoreRelease(&rb->tail, tail + length);
+
+    return length;
+}
+
+uint32_t RingBuffer_Read(RingBuffer *rb, void *data, uint32_t length)
+{
+    uint32_t head = rb->head;
+    uint32_t count;
+    uint32_t offset;
+    uint32_t first;
+
+    count = LoadAcquire(&rb->tail) - head;
+    if (length > count) {
+	length = count;
+    }
+    if (length == 0) {
+	return 0;
+    }
+
+    offset = head & rb->mask;
+    first = (rb->mask + 1) - offset;
+    if (first > length) {
+	first = length;
+    }
+    memcpy(data, &rb->buffer[offset], first);
+    memcpy((uint8_t *) data + first, rb->buffer, length - first);
+
+    StoreRelease(&rb->head, head + length);
+
+    return length;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static inline uint32_t LoadAcquire(const volatile uint32_t *index)
+{
+    uint32_t value = *index;
+
+    // Nothing after this may be read before the index
+    RING_BARRIER();
+    return value;
+}
+
+static inline void StoreRelease(volatile uint32_t *index, uint32_t value)
+{
+    // Everything before this is visible before the index moves
+    RING_BARRIER();
+    *index = value;
+}
+
+
+//#define RINGBUFFER_TEST
+#ifdef RINGBUFFER_TEST
+
+/*
+ * PC only, one producer thread and one consumer thread hammer a small ring
+ * with random span sizes and check every byte comes out in order. Then times
+ * bulk and single byte transfers. BOARD.h from the course include directory
+ * has to be on the include path for SUCCESS and ERROR.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define TEST_RING_SIZE 64
+#define TEST_BYTES (16UL * 1024 * 1024)
+#define BENCH_RING_SIZE 1024
+#define BENCH_BYTES (64UL * 1024 * 1024)
+#define BENCH_SPAN 64
+
+static uint8_t storage[BENCH_RING_SIZE];
+static RingBuffer ring;
+static uint32_t span;
+static volatile int failed = 0;
+
+static uint8_t Pattern(uint32_t n)
+{
+    // Cheap sequence that still catches swapped or repeated bytes
+    return (uint8_t) ((n * 2654435761u) >> 24);
+}
+
+static void Backoff(uint32_t moved)
+{
+    // Give the other thread the core when there was nothing to do
+    if (moved == 0) {
+	sched_yield();
+    }
+}
+
+static void *StressProducer(void *arg)
+{
+    uint8_t chunk[TEST_RING_SIZE];
+    uint32_t sent = 0;
+    uint32_t seed = 1;
+    uint32_t length;
+    uint32_t i;
+
+    (void) arg;
+
+    while (sent < TEST_BYTES && !failed) {
+	seed = seed * 1103515245 + 12345;
+	length = 1 + ((seed >> 16) % TEST_RING_SIZE);
+	if (length > TEST_BYTES - sent) {
+	    length = TEST_BYTES - sent;
+	}
+
+	for (i = 0; i < length; ++i) {
+	    chunk[i] = Pattern(sent + i);
+	}
+
+	// Single byte puts now and then so both paths get exercised
+	if ((seed & 0x700) == 0) {
+	    length = (RingBuffer_Put(&ring, chunk[0]) != ERROR) ? 1 : 0;
+	} else {
+	    length = RingBuffer_Write(&ring, chunk, length);
+	}
+	sent += length;
+	Backoff(length);
+    }
+    return NULL;
+}
+
+static void *StressConsumer(void *arg)
+{
+    uint8_t chunk[TEST_RING_SIZE];
+    uint32_t received = 0;
+    uint32_t seed = 7;
+    uint32_t length;
+    uint32_t i;
+
+    (void) arg;
+
+    while (received < TEST_BYTES && !failed) {
+	seed = seed * 1103515245 + 12345;
+	if ((seed & 0x700) == 0) {
+	    length = (RingBuffer_Get(&ring, chunk) != ERROR) ? 1 : 0;
+	} else {
+	    length = RingBuffer_Read(&ring, chunk,
+		    1 + ((seed >> 16) % TEST_RING_SIZE));
+	}
+
+	for (i = 0; i < length; ++i) {
+	    if (chunk[i] != Pattern(received + i)) {
+		printf("\nMismatch at byte %u", received + i);
+		failed = 1;
+		break;
+	    }
+	}
+	received += length;
+	Backoff(length);
+    }
+    return NULL;
+}
+
+static void *BenchProducer(void *arg)
+{
+    uint8_t chunk[BENCH_SPAN] = {0};
+    unsigned long sent = 0;
+    uint32_t moved;
+
+    (void) arg;
+
+    while (sent < BENCH_BYTES) {
+	if (span == 1) {
+	    moved = (RingBuffer_Put(&ring, chunk[0]) != ERROR) ? 1 : 0;
+	} else {
+	    moved = RingBuffer_Write(&ring, chunk, span);
+	}
+	sent += moved;
+	Backoff(moved);
+    }
+    return NULL;
+}
+
+static void *BenchConsumer(void *arg)
+{
+    uint8_t chunk[BENCH_SPAN];
+    unsigned long received = 0;
+    uint32_t moved;
+
+    (void) arg;
+
+    while (received < BENCH_BYTES) {
+	if (span == 1) {
+	    moved = (RingBuffer_Get(&ring, chunk) != ERROR) ? 1 : 0;
+	} else {
+	    moved = RingBuffer_Read(&ring, chunk, span);
+	}
+	received += moved;
+	Backoff(moved);
+    }
+    return NULL;
+}
+
+static double RunPair(void *(*producer)(void *), void *(*consumer)(void *))
+{
+    pthread_t p;
+    pthread_t c;
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(void)
+{
+    double seconds;
+
+    if (RingBuffer_Init(&ring, storage, 100) != ERROR) {
+	printf("\nInit accepted a size that is not a power of two");
+	return 1;
+    }
+
+    RingBuffer_Init(&ring, storage, TEST_RING_SIZE);
+    seconds = RunPair(StressProducer, StressConsumer);
+    if (failed || RingBuffer_Count(&ring) != 0) {
+	printf("\nStress test FAILED\n");
+	return 1;
+    }
+    printf("\nStress test passed, %lu bytes through a %d byte ring in %.2fs",
+	    TEST_BYTES, TEST_RING_SIZE, seconds);
+
+    span = BENCH_SPAN;
+    RingBuffer_Init(&ring, storage, BENCH_RING_SIZE);
+    seconds = RunPair(BenchProducer, BenchConsumer);
+    printf("\nBulk %d byte spans: %.1f MB/s", BENCH_SPAN,
+	    BENCH_BYTES / seconds / 1e6);
+
+    span = 1;
+    RingBuffer_Init(&ring, storage, BENCH_RING_SIZE);
+    seconds = RunPair(BenchProducer, BenchConsumer);
+    printf("\nSingle bytes: %.1f MB/s\n", BENCH_BYTES / seconds / 1e6);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * File:   RingBuffer.h
+ * Author: rcrobert
+ *
+ * Lock free byte ring for one producer and one consumer, e.g. main code and
+ * an ISR. Size must be a power of two. Head and tail run freely and are only
+ * masked on access, so the whole buffer is usable and count is tail - head.
+ * Only the producer writes tail and only the consumer writes head, data is
+ * published with a release store and picked up with an acquire load.
+ *
+ * Build RingBuffer.c with -DRINGBUFFER_TEST -lpthread on a PC for the stress
+ * test and throughput benchmark.
+ *
+ * Created on December 9, 2014, 7:15 PM
+ */
+
+#ifndef RINGBUFFER_H
+#define	RINGBUFFER_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef struct {
+    uint8_t *buffer;
+    uint32_t mask;
+    volatile uint32_t head;	// next byte to read, consumer only
+    volatile uint32_t tail;	// next byte to write, producer only
+} RingBuffer;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function RingBuffer_Init(RingBuffer *rb, uint8_t *storage, uint32_t size)
+ * @param rb - Ring to set up
+ * @param storage - Backing array, size bytes
+ * @param size - Power of two
+ * @return ERROR if size is not a power of two
+ * @author rcrobert 2014.12.09
+ */
+char RingBuffer_Init(RingBuffer *rb, uint8_t *storage, uint32_t size);
+
+/**
+ * @Function RingBuffer_Count(const RingBuffer *rb)
+ * @return Bytes waiting to be read. Exact for the consumer, a lower bound for
+ * anyone else
+ * @author rcrobert 2014.12.09
+ */
+uint32_t RingBuffer_Count(const RingBuffer *rb);
+
+/**
+ * @Function RingBuffer_Space(const RingBuffer *rb)
+ * @return Bytes that can be written. Exact for the producer, a lower bound for
+ * anyone else
+ * @author rcrobert 2014.12.09
+ */
+uint32_t RingBuffer_Space(const RingBuffer *rb);
+
+/**
+ * @Function RingBuffer_Put(RingBuffer *rb, uint8_t data)
+ * @return ERROR if full, producer side
+ * @author rcrobert 2014.12.09
+ */
+char RingBuffer_Put(RingBuffer *rb, uint8_t data);
+
+/**
+ * @Function RingBuffer_Get(RingBuffer *rb, uint8_t *data)
+ * @return ERROR if empty, consumer side
+ * @author rcrobert 2014.12.09
+ */
+char RingBuffer_Get(RingBuffer *rb, uint8_t *data);
+
+/**
+ * @Function RingBuffer_Peek(const RingBuffer *rb, uint8_t *data)
+ * @return ERROR if empty, consumer side. The byte stays in the buffer
+ * @author rcrobert 2014.12.16
+ */
+char RingBuffer_Peek(const RingBuffer *rb, uint8_t *data);
+
+/**
+ * @Function RingBuffer_Write(RingBuffer *rb, const void *data, uint32_t length)
+ * @param data - Bytes to add
+ * @param length - Number of bytes
+ * @return Number written, less than length when it did not all fit
+ * @brief Producer side. Copies in at most two spans and publishes once
+ * @author rcrobert 2014.12.09
+ */
+uint32_t RingBuffer_Write(RingBuffer *rb, const void *data, uint32_t length);
+
+/**
+ * @Function RingBuffer_Read(RingBuffer *rb, void *data, uint32_t length)
+ * @param data - Filled with up to length bytes
+ * @param length - Most bytes to take
+ * @return Number read
+ * @brief Consumer side. Copies out in at most two spans and frees them once
+ * @author rcrobert 2014.12.09
+ */
+uint32_t RingBuffer_Read(RingBuffer *rb, void *data, uint32_t length);
+
+#endif	/* RINGBUFFER_H */
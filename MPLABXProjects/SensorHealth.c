@@ -0,0 +1,281 @@
+/*
+ * File:   SensorHealth.c
+ * Author: rcrobert
+ *
+ * Per channel statistics and stuck, saturated and dead flags. See
+ * SensorHealth.h
+ *
+ * Created on December 15, 2014, 3:40 PM
+ */
+
+#include <BOARD.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "BotConfig.h"
+#include "BotParams.h"
+#include "DebugLog.h"
+#include "SensorHealth.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+// Readings per window. A bumper is read every pass, about 3s of them
+#define HEALTH_WINDOW (64)
+
+// Mean and the sum of squares kept in Q4, enough to tell under one count of
+// variance. A full swing of tape contrast, 2046 << 4, squared still fits in
+// 32 bits
+#define HEALTH_Q (4)
+
+#define NUM_FLAGS (3)
+
+/*******************************************************************************
+ * PRIVATE TYPEDEFS                                                            *
+ ******************************************************************************/
+
+typedef struct {
+	int32_t mean;		// Q(HEALTH_Q)
+	uint32_t m2;		// sum of squared deviations, Q(HEALTH_Q)
+	uint32_t windowStart;
+	uint32_t badSince[NUM_FLAGS];
+	int16_t max;
+	uint8_t n;
+	uint8_t edges;
+	uint8_t railed;
+	uint8_t level;
+	uint8_t bad;		// flags the last window showed, not yet for long
+	uint8_t flags;
+} HealthChannel;
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+static HealthChannel channels[HEALTH_CHANNELS];
+static SensorHealthStats stats[HEALTH_CHANNELS];
+
+// Bit per channel for each flag, HEALTH_STUCK first
+static uint32_t flagged[NUM_FLAGS];
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static uint8_t ChecksFor(uint8_t channel);
+static void EndWindow(uint8_t channel);
+static void SetFlags(uint8_t channel, uint8_t flags);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void SensorHealth_Init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < HEALTH_CHANNELS; i++) {
+		channels[i].n = 0;
+		channels[i].level = FALSE;
+		channels[i].bad = 0;
+		channels[i].flags = 0;
+		stats[i].mean = 0;
+		stats[i].variance = 0;
+		stats[i].windowMs = 0;
+		stats[i].edges = 0;
+		stats[i].flags = 0;
+	}
+	for (i = 0; i < NUM_FLAGS; i++) {
+		flagged[i] = 0;
+	}
+}
+
+void SensorHealth_Sample(uint8_t channel, int value, uint8_t level,
+	uint8_t railed)
+{
+	HealthChannel *c;
+	int32_t x;
+	int32_t delta;
+
+	if (channel >= HEALTH_CHANNELS) {
+		return;
+	}
+	c = &channels[channel];
+
+	if (c->n == 0) {
+		c->windowStart = ES_Timer_GetTime();
+		c->m2 = 0;
+		c->max = value;
+		c->edges = 0;
+		c->railed = 0;
+	}
+
+	// Welford, the mean moves 1/n of the way and m2 takes the deviation
+	// from both the old and the new mean
+	x = (int32_t) value << HEALTH_Q;
+	++c->n;
+	delta = x - c->mean;
+	c->mean += delta / c->n;
+	c->m2 += (uint32_t) ((delta * (x - c->mean)) >> HEALTH_Q);
+
+	if (value > c->max) {
+		c->max = value;
+	}
+	if (railed) {
+		++c->railed;
+	}
+
+	level = level ? TRUE : FALSE;
+	if (level != c->level) {
+		c->level = level;
+		if (c->edges < 0xFF) {
+			++c->edges;
+		}
+		// Moving at all is enough to not be stuck
+		c->bad &= ~HEALTH_STUCK;
+		if (c->flags & HEALTH_STUCK) {
+			SetFlags(channel, c->flags & ~HEALTH_STUCK);
+		}
+	}
+
+	if (c->n >= HEALTH_WINDOW) {
+		EndWindow(channel);
+	}
+}
+
+uint32_t SensorHealth_GetMasked(void)
+{
+	if (!BotParam(HEALTH_MASK)) {
+		return 0;
+	}
+	return flagged[0] | flagged[1] | flagged[2];
+}
+
+uint32_t SensorHealth_GetFlagged(uint8_t flag)
+{
+	uint8_t i;
+
+	for (i = 0; i < NUM_FLAGS; i++) {
+		if (flag == (1 << i)) {
+			return flagged[i];
+		}
+	}
+	return 0;
+}
+
+void SensorHealth_GetStats(uint8_t channel, SensorHealthStats *out)
+{
+	if (channel >= HEALTH_CHANNELS) {
+		out->mean = 0;
+		out->variance = 0;
+		out->windowMs = 0;
+		out->edges = 0;
+		out->flags = 0;
+		return;
+	}
+	*out = stats[channel];
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+/**
+ * @Function ChecksFor(uint8_t channel)
+ * @return Flags that mean something for the channel's sensor group
+ * @author rcrobert */
+static uint8_t ChecksFor(uint8_t channel)
+{
+	if (channel < HEALTH_TAPE) {
+		return HEALTH_STUCK;
+	} else if (channel < HEALTH_BEACON) {
+		return HEALTH_STUCK | HEALTH_SATURATED | HEALTH_DEAD;
+	} else if (channel < HEALTH_DIST) {
+		return HEALTH_STUCK;
+	} else if (channel < HEALTH_TRACK) {
+		return HEALTH_STUCK | HEALTH_SATURATED;
+	}
+	return HEALTH_STUCK;
+}
+
+/**
+ * @Function EndWindow(uint8_t channel)
+ * @param channel - channel whose window just filled
+ * @return None
+ * @brief Publishes the window's statistics, then flags what has been wrong
+ *        for long enough and clears what no longer is
+ * @author rcrobert */
+static void EndWindow(uint8_t channel)
+{
+	HealthChannel *c = &channels[channel];
+	SensorHealthStats *s = &stats[channel];
+	uint32_t now = ES_Timer_GetTime();
+	uint32_t variance;
+	uint32_t limit;
+	uint8_t bad = 0;
+	uint8_t flags = 0;
+	uint8_t bit;
+	uint8_t i;
+
+	variance = (c->m2 / c->n) >> HEALTH_Q;
+	s->mean = c->mean >> HEALTH_Q;
+	s->variance = (variance > 0xFFFF) ? 0xFFFF : variance;
+	s->windowMs = ((now - c->windowStart) > 0xFFFF) ? 0xFFFF :
+		(now - c->windowStart);
+	s->edges = c->edges;
+
+	if (c->level && (c->edges == 0) && (c->m2 < ((uint32_t) c->n << HEALTH_Q))) {
+		bad |= HEALTH_STUCK;
+	}
+	if (c->railed >= (HEALTH_WINDOW * 3 / 4)) {
+		bad |= HEALTH_SATURATED;
+	}
+	if (c->max < BotParam(HEALTH_DEAD_CONTRAST)) {
+		bad |= HEALTH_DEAD;
+	}
+	bad &= ChecksFor(channel);
+
+	// Each problem dates from the start of the first window that showed it
+	for (i = 0; i < NUM_FLAGS; i++) {
+		bit = 1 << i;
+		if (!(bad & bit)) {
+			continue;
+		}
+		if (!(c->bad & bit)) {
+			c->badSince[i] = c->windowStart;
+		}
+		limit = (bit == HEALTH_STUCK) ? BotParam(HEALTH_STUCK_MS) :
+			BotParam(HEALTH_FAULT_MS);
+		if ((now - c->badSince[i]) >= limit) {
+			flags |= bit;
+		}
+	}
+	c->bad = bad;
+	c->n = 0;
+
+	if (flags != c->flags) {
+		SetFlags(channel, flags);
+	}
+}
+
+/**
+ * @Function SetFlags(uint8_t channel, uint8_t flags)
+ * @param channel - channel to update
+ * @param flags - all of its flags from now on
+ * @return None
+ * @author rcrobert */
+static void SetFlags(uint8_t channel, uint8_t flags)
+{
+	uint8_t i;
+
+	channels[channel].flags = flags;
+	stats[channel].flags = flags;
+	for (i = 0; i < NUM_FLAGS; i++) {
+		if (flags & (1 << i)) {
+			flagged[i] |= 1UL << channel;
+		} else {
+			flagged[i] &= ~(1UL << channel);
+		}
+	}
+	DLOG("Sensor health: channel %d flags 0x%02X\r\n", channel, flags);
+}
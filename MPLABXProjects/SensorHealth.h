@@ -0,0 +1,132 @@
+/*
+ * File:   SensorHealth.h
+ * Author: rcrobert
+ *
+ * Running statistics on every sensor channel EventCheckerService reads, to
+ * catch the ones that have failed. A dead tape LED or a bump switch stuck
+ * closed otherwise only shows as the HSMs doing strange things, a stuck
+ * bumper sits in the type bits of every BUMPER after it and keeps the Ram
+ * aligns bouncing.
+ *
+ * Each channel is fed the value the checker read and the level it decided on
+ * after hysteresis. Mean and variance come from Welford updates in fixed
+ * point over windows of HEALTH_WINDOW samples, along with the level changes
+ * (edge rate), the largest value and how many readings sat at an A/D rail.
+ * Tape channels are fed the LED on minus LED off contrast.
+ *
+ * Flags, checked at the end of each window
+ * STUCK     - active the whole window with no edges and under one count of
+ *             variance, for HEALTH_STUCK_MS. Bump, tape, beacon, distance
+ *             and track. Clears on the next edge
+ * SATURATED - 3/4 of the readings at a rail, for HEALTH_FAULT_MS. Tape and
+ *             distance, beacons legitimately rail up close
+ * DEAD      - contrast never reached HEALTH_DEAD_CONTRAST, for
+ *             HEALTH_FAULT_MS. Tape only, it is the LED that dies
+ * SATURATED and DEAD clear after one good window.
+ *
+ * With HEALTH_MASK set, flagged channels are masked: EventCheckerService
+ * keeps them out of events and the snapshot, their hysteresis keeps running
+ * so a channel that recovers comes back in step. Telemetry carries the flag
+ * masks and one channel's statistics per frame.
+ *
+ * Created on December 15, 2014, 3:40 PM
+ */
+
+#ifndef SENSORHEALTH_H
+#define	SENSORHEALTH_H
+
+#include <inttypes.h>
+#include "BotConfig.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// First channel of each sensor group, channels are the mux select from there
+#define HEALTH_BUMP 0
+#define HEALTH_TAPE (HEALTH_BUMP + NUM_BUMP_SENSORS)
+#define HEALTH_BEACON (HEALTH_TAPE + NUM_TAPE_SENSORS)
+#define HEALTH_DIST (HEALTH_BEACON + NUM_LIGHT_SENSORS)
+#define HEALTH_TRACK (HEALTH_DIST + NUM_DIST_SENSORS)
+#define HEALTH_CHANNELS (HEALTH_TRACK + 1)
+
+// Flags
+#define HEALTH_STUCK 0x01
+#define HEALTH_SATURATED 0x02
+#define HEALTH_DEAD 0x04
+
+// A/D counts this close to 0 or full scale count as at the rail
+#define HEALTH_RAIL 8
+#define HEALTH_RAILED(counts) \
+    ((counts) <= HEALTH_RAIL || (counts) >= 1023 - HEALTH_RAIL)
+
+// Channels in a group as bits from 0, e.g. HEALTH_GROUP(masked, HEALTH_TAPE,
+// NUM_TAPE_SENSORS) lines up with the TAPE bits
+#define HEALTH_GROUP(channels, first, count) \
+    (((channels) >> (first)) & ((1UL << (count)) - 1))
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+// One channel as of its last full window
+typedef struct {
+    int16_t mean;       // counts
+    uint16_t variance;  // counts^2, stops at 0xFFFF
+    uint16_t windowMs;  // time the window took, edges / windowMs is the rate
+    uint8_t edges;      // level changes
+    uint8_t flags;
+} SensorHealthStats;
+
+// Channel masks are one uint32_t
+typedef char SensorHealthChannelsFit[(HEALTH_CHANNELS <= 32) ? 1 : -1];
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function SensorHealth_Init(void)
+ * @return None
+ * @brief Clears every channel and flag. InitEventCheckerService calls it
+ * @author rcrobert */
+void SensorHealth_Init(void);
+
+/**
+ * @Function SensorHealth_Sample(uint8_t channel, int value, uint8_t level,
+ *           uint8_t railed)
+ * @param channel - HEALTH_* group plus mux select
+ * @param value - reading, -1023 to 1023
+ * @param level - TRUE if the checker has the channel active, closed, on tape,
+ *                seen, near or found
+ * @param railed - TRUE if the raw reading was HEALTH_RAILED
+ * @return None
+ * @brief Adds one reading to the window, evaluates the flags once it is full
+ * @author rcrobert */
+void SensorHealth_Sample(uint8_t channel, int value, uint8_t level,
+        uint8_t railed);
+
+/**
+ * @Function SensorHealth_GetMasked(void)
+ * @return Bit per channel of the ones kept out of events, 0 with HEALTH_MASK
+ *         off
+ * @author rcrobert */
+uint32_t SensorHealth_GetMasked(void);
+
+/**
+ * @Function SensorHealth_GetFlagged(uint8_t flag)
+ * @param flag - one HEALTH_STUCK, HEALTH_SATURATED or HEALTH_DEAD
+ * @return Bit per channel that has it, whether or not masking is on
+ * @author rcrobert */
+uint32_t SensorHealth_GetFlagged(uint8_t flag);
+
+/**
+ * @Function SensorHealth_GetStats(uint8_t channel, SensorHealthStats *stats)
+ * @param channel - HEALTH_* group plus mux select
+ * @param stats - filled with the last full window, zeros if there is no such
+ *                channel
+ * @return None
+ * @author rcrobert */
+void SensorHealth_GetStats(uint8_t channel, SensorHealthStats *stats);
+
+#endif	/* SENSORHEALTH_H */
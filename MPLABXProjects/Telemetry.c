@@ -0,0 +1,228 @@
+/*
+ * File:   Telemetry.c
+ * Author: rcrobert
+ *
+ * Framed binary telemetry. See Telemetry.h
+ *
+ * Created on December 11, 2014, 10:20 AM
+ */
+
+#include <BOARD.h>
+#include <AD.h>
+#include <serial.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_QueueStats.h"
+#include "Crc16.h"
+#include "BotConfig.h"
+#include "EventCheckerService.h"
+#include "MotorDriver.h"
+#include "TopHSM.h"
+#include "ExitHSM.h"
+#include "SearchHSM.h"
+#include "ApproachHSM.h"
+#include "ReturnHSM.h"
+#include "RamSubHSM.h"
+#include "SensorHealth.h"
+#include "Telemetry.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+// Payload and CRC, COBS adds one byte per 254, then a delimiter either side
+#define BODY_SIZE (TELEMETRY_PAYLOAD_SIZE + 2)
+#define FRAME_MAX (1 + BODY_SIZE + (BODY_SIZE / 254) + 1 + 1)
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+static unsigned int period = 0;
+static uint32_t lastFrame = 0;
+static uint8_t sequence = 0;
+static unsigned int skips = 0;
+static uint8_t healthChannel = 0;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static unsigned int BuildPayload(uint8_t *payload);
+static unsigned int CobsEncode(const uint8_t *in, unsigned int length,
+	uint8_t *out);
+static uint8_t *Put16(uint8_t *out, uint16_t value);
+static uint8_t *Put32(uint8_t *out, uint32_t value);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void Telemetry_Init(void)
+{
+	period = TELEMETRY_PERIOD_MS;
+	lastFrame = ES_Timer_GetTime();
+	sequence = 0;
+	skips = 0;
+	healthChannel = 0;
+}
+
+void Telemetry_SetPeriod(unsigned int periodMs)
+{
+	period = periodMs;
+}
+
+uint8_t Telemetry_Update(void)
+{
+	uint8_t body[BODY_SIZE];
+	uint8_t frame[FRAME_MAX];
+	unsigned int length;
+	uint16_t crc;
+	uint32_t now;
+
+	if (period == 0) {
+		return FALSE;
+	}
+
+	now = ES_Timer_GetTime();
+	if ((now - lastFrame) < period) {
+		return FALSE;
+	}
+	lastFrame = now;
+
+	// Sent whole or not at all, a partial frame only wastes the link
+	if (SERIAL_TransmitSpace() < FRAME_MAX) {
+		++skips;
+		++sequence;
+		return FALSE;
+	}
+
+	length = BuildPayload(body);
+	crc = Crc16(CRC16_INIT, body, length);
+	body[length++] = crc;
+	body[length++] = crc >> 8;
+
+	frame[0] = 0x00;
+	length = 1 + CobsEncode(body, length, &frame[1]);
+	frame[length++] = 0x00;
+
+	SERIAL_Write((const char *) frame, length);
+	++sequence;
+
+	return FALSE;
+}
+
+unsigned int Telemetry_GetSkipCount(void)
+{
+	return skips;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static unsigned int BuildPayload(uint8_t *payload)
+{
+	SensorSnapshot sensors;
+	SensorHealthStats health;
+	uint8_t *out = payload;
+	int leftSpeed;
+	int rightSpeed;
+	int i;
+
+	EventChecker_GetSnapshot(&sensors);
+	Drive_GetCommand(&leftSpeed, &rightSpeed);
+
+	*out++ = TELEMETRY_VERSION;
+	*out++ = sequence;
+	out = Put32(out, ES_Timer_GetTime());
+
+	*out++ = sensors.bump;
+	*out++ = sensors.tape;
+	*out++ = sensors.beacon;
+	*out++ = sensors.track;
+
+	out = Put16(out, (uint16_t) leftSpeed);
+	out = Put16(out, (uint16_t) rightSpeed);
+	out = Put16(out, AD_ReadBatteryFilter());
+
+	*out++ = QueryTopHSM();
+	*out++ = QueryExitHSM();
+	*out++ = QuerySearchHSM();
+	*out++ = QueryApproachHSM();
+	*out++ = QueryReturnHSM();
+	*out++ = QueryRamSubHSM();
+
+	for (i = 0; i < TELEMETRY_QUEUES; i++) {
+		*out++ = ES_GetQueueDepth(i);
+	}
+
+	out = Put16(out, skips);
+
+	out = Put32(out, SensorHealth_GetFlagged(HEALTH_STUCK));
+	out = Put32(out, SensorHealth_GetFlagged(HEALTH_SATURATED));
+	out = Put32(out, SensorHealth_GetFlagged(HEALTH_DEAD));
+
+	// Statistics of every channel go round once every HEALTH_CHANNELS frames
+	SensorHealth_GetStats(healthChannel, &health);
+	*out++ = healthChannel;
+	*out++ = health.flags;
+	out = Put16(out, (uint16_t) health.mean);
+	out = Put16(out, health.variance);
+	*out++ = health.edges;
+	out = Put16(out, health.windowMs);
+	if (++healthChannel >= HEALTH_CHANNELS) {
+		healthChannel = 0;
+	}
+
+	return out - payload;
+}
+
+/**
+ * @Function CobsEncode(const uint8_t *in, unsigned int length, uint8_t *out)
+ * @param in - Bytes to encode
+ * @param length - Number of bytes
+ * @param out - At least length + length / 254 + 1 bytes
+ * @return Encoded length, no zero bytes and no delimiter
+ * @brief Each zero is replaced by the distance to the next one, the first
+ *        byte holds the distance to the first zero
+ * @author rcrobert */
+static unsigned int CobsEncode(const uint8_t *in, unsigned int length,
+	uint8_t *out)
+{
+	uint8_t *code = out;
+	uint8_t *dst = out + 1;
+	uint8_t run = 1;
+
+	while (length--) {
+		if (*in != 0x00) {
+			*dst++ = *in;
+			++run;
+		}
+		if (*in == 0x00 || run == 0xFF) {
+			*code = run;
+			code = dst++;
+			run = 1;
+		}
+		++in;
+	}
+	*code = run;
+
+	return dst - out;
+}
+
+static uint8_t *Put16(uint8_t *out, uint16_t value)
+{
+	*out++ = value;
+	*out++ = value >> 8;
+	return out;
+}
+
+static uint8_t *Put32(uint8_t *out, uint32_t value)
+{
+	*out++ = value;
+	*out++ = value >> 8;
+	*out++ = value >> 16;
+	*out++ = value >> 24;
+	return out;
+}
@@ -0,0 +1,94 @@
+/*
+ * File:   Telemetry.h
+ * Author: rcrobert
+ *
+ * Binary telemetry on UART1. Every period one snapshot of the bot goes out as
+ * a COBS frame: 0x00, COBS(payload, CRC16), 0x00. COBS leaves no zero bytes
+ * inside the frame so printf and DebugLog output on the same UART can never
+ * be mistaken for one, the host drops anything that fails the CRC.
+ *
+ * CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over the payload, sent
+ * little endian after it.
+ *
+ * Payload, little endian
+ *  0  u8   TELEMETRY_VERSION
+ *  1  u8   sequence, counts every frame built so gaps show skipped frames
+ *  2  u32  ES_Timer_GetTime in ms
+ *  6  u8   bump bits         see SensorSnapshot
+ *  7  u8   tape bits
+ *  8  u8   beacon bits
+ *  9  u8   track
+ * 10  s16  left motor command
+ * 12  s16  right motor command
+ * 14  u16  filtered battery, A/D counts
+ * 16  u8   TopHSM state
+ * 17  u8   ExitHSM, SearchHSM, ApproachHSM, ReturnHSM, RamSubHSM states
+ * 22  u8   queue depth of services 0-3
+ * 26  u16  frames skipped because the UART was full
+ * 28  u32  channels SensorHealth has STUCK        bit per HEALTH_* channel
+ * 32  u32  channels SATURATED
+ * 36  u32  channels DEAD
+ * 40  u8   health channel, one more each frame    see SensorHealthStats
+ * 41  u8   its flags
+ * 42  s16  its mean
+ * 44  u16  its variance
+ * 46  u8   its edges
+ * 47  u16  its window ms
+ *
+ * Telemetry_Update lives in EVENT_CHECK_LIST, so it only runs when every
+ * service queue is empty. A frame is only built when the whole thing fits in
+ * the transmit buffer, otherwise it is skipped and counted rather than
+ * waiting. HostTools/telemetry_record.py records the stream.
+ *
+ * Created on December 11, 2014, 10:20 AM
+ */
+
+#ifndef TELEMETRY_H
+#define	TELEMETRY_H
+
+#include <inttypes.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_PAYLOAD_SIZE 49
+#define TELEMETRY_QUEUES 4
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function Telemetry_Init(void)
+ * @return None
+ * @brief Starts sending every TELEMETRY_PERIOD_MS
+ * @author rcrobert 2014.12.11
+ */
+void Telemetry_Init(void);
+
+/**
+ * @Function Telemetry_SetPeriod(unsigned int periodMs)
+ * @param periodMs - Time between frames, 0 stops telemetry
+ * @return None
+ * @author rcrobert 2014.12.11
+ */
+void Telemetry_SetPeriod(unsigned int periodMs);
+
+/**
+ * @Function Telemetry_Update(void)
+ * @return FALSE, never posts
+ * @brief Sends a frame when one is due. Lives in EVENT_CHECK_LIST
+ * @author rcrobert 2014.12.11
+ */
+uint8_t Telemetry_Update(void);
+
+/**
+ * @Function Telemetry_GetSkipCount(void)
+ * @return Frames skipped since Telemetry_Init because they did not fit
+ * @author rcrobert 2014.12.11
+ */
+unsigned int Telemetry_GetSkipCount(void);
+
+#endif	/* TELEMETRY_H */
@@ -25,7 +25,7 @@
 //#define PWM_DEBUG_VERBOSE
 #ifdef PWM_DEBUG_VERBOSE
 #include "serial.h"
-#define dbprintf(...) while(!IsTransmitEmpty()); printf(__VA_ARGS__)
+#define dbprintf(...) printf(__VA_ARGS__)
 #else
 #define dbprintf(...)
 #endif
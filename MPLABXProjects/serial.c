@@ -12,6 +12,8 @@
 #include <BOARD.h>
 #include <stdint.h>
 #include <plib.h>
+#include <string.h>
+#include "RingBuffer.h"
 //#include <stdlib.h>
 
 
@@ -21,44 +23,17 @@
  ******************************************************************************/
 
 #define F_PB (BOARD_GetPBClock())
-#define QUEUESIZE 512
-
-/*******************************************************************************
- * PRIVATE DATATYPES                                                           *
- ******************************************************************************/
-typedef struct CircBuffer {
-    unsigned char buffer[QUEUESIZE];
-    int head;
-    int tail;
-    unsigned int size;
-    unsigned char overflowCount;
-} CircBuffer;
-typedef struct CircBuffer* CBRef;
-
-
-/*******************************************************************************
- * PRIVATE FUNCTIONS PROTOTYPES                                                *
- ******************************************************************************/
-void newCircBuffer(CBRef cB);
-void freeCircBuffer(CBRef* cB);
-unsigned int getLength(CBRef cB);
-int readHead(CBRef cB);
-int readTail(CBRef cB);
-unsigned char peak(CBRef cB);
-unsigned char readFront(CBRef cB);
-unsigned char writeBack(CBRef cB, unsigned char data);
 
 /*******************************************************************************
  * PRIVATE VARIABLES                                                           *
  ******************************************************************************/
-struct CircBuffer outgoingUart;
-CBRef transmitBuffer;
-struct CircBuffer incomingUart;
-CBRef receiveBuffer;
-static uint8_t AddingToTransmit = FALSE;
-static uint8_t GettingFromReceive = FALSE;
-static uint8_t TransmitCollisionOccured = FALSE;
-static uint8_t ReceiveCollisionOccured = FALSE;
+static uint8_t outgoingStorage[SERIAL_TX_QUEUESIZE];
+static uint8_t incomingStorage[SERIAL_RX_QUEUESIZE];
+
+// Main code produces and the ISR consumes transmit, the other way for receive
+static RingBuffer transmitBuffer;
+static RingBuffer receiveBuffer;
+static unsigned int transmitDrops = 0;
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                           *
@@ -73,45 +48,80 @@ static uint8_t ReceiveCollisionOccured = FALSE;
 
 void SERIAL_Init(void)
 {
-    transmitBuffer = (struct CircBuffer*) &outgoingUart; //set up buffer for receive
-    newCircBuffer(transmitBuffer);
-
-    receiveBuffer = (struct CircBuffer*) &incomingUart; //set up buffer for transmit
-    newCircBuffer(receiveBuffer);
+    RingBuffer_Init(&transmitBuffer, outgoingStorage, SERIAL_TX_QUEUESIZE);
+    RingBuffer_Init(&receiveBuffer, incomingStorage, SERIAL_RX_QUEUESIZE);
+    transmitDrops = 0;
 
     UARTConfigure(UART1, 0x00);
     UARTSetDataRate(UART1, F_PB, 115200);
-    UARTSetFifoMode(UART1, UART_INTERRUPT_ON_RX_NOT_EMPTY | UART_INTERRUPT_ON_RX_NOT_EMPTY);
+    UARTSetFifoMode(UART1, UART_INTERRUPT_ON_TX_BUFFER_EMPTY | UART_INTERRUPT_ON_RX_NOT_EMPTY);
 
     INTSetVectorPriority(INT_UART_1_VECTOR, INT_PRIORITY_LEVEL_4); //set the interrupt priority
 
     UARTEnable(UART1, UART_ENABLE_FLAGS(UART_PERIPHERAL | UART_TX | UART_RX));
     INTEnable(INT_U1RX, INT_ENABLED);
-    INTEnable(INT_U1TX, INT_ENABLED);
+
+    // Transmit interrupt is only on while there is something to send
+    INTEnable(INT_U1TX, INT_DISABLED);
 }
 
 /**
  * @Function PutChar(char ch)
  * @param ch - the char to be sent out the serial port
  * @return None.
- * @brief  adds char to the end of the circular buffer and forces the interrupt flag 
- * high if nothing is currently transmitting
+ * @brief  adds char to the end of the circular buffer, dropped if it is full
  * @author Max Dunne, 2011.11.10 */
 void PutChar(char ch)
 {
-    if (getLength(transmitBuffer) != QUEUESIZE) {
-        AddingToTransmit = TRUE;
-        writeBack(transmitBuffer, ch);
-        AddingToTransmit = FALSE;
-        if (U1STAbits.TRMT) {
-            INTSetFlag(INT_U1TX);
-        }
-        //re-enter the interrupt if we removed a character while getting another one
-        if (TransmitCollisionOccured) {
-            INTSetFlag(INT_U1TX);
-            TransmitCollisionOccured = FALSE;
-        }
+    if (RingBuffer_Put(&transmitBuffer, (uint8_t) ch) == ERROR) {
+        ++transmitDrops;
+        return;
     }
+
+    // ISR turns itself off once the buffer drains
+    INTEnable(INT_U1TX, INT_ENABLED);
+}
+
+/**
+ * @Function SERIAL_Write(const char *data, unsigned int length)
+ * @param data - bytes to be sent out the serial port
+ * @param length - number of bytes
+ * @return Number of bytes queued, the rest were dropped
+ * @brief  copies as much as fits into the transmit buffer in at most two
+ * chunks and never waits on the UART
+ * @author rcrobert, 2014.12.09 */
+unsigned int SERIAL_Write(const char *data, unsigned int length)
+{
+    unsigned int written;
+
+    written = RingBuffer_Write(&transmitBuffer, data, length);
+    transmitDrops += length - written;
+
+    if (written != 0) {
+        INTEnable(INT_U1TX, INT_ENABLED);
+    }
+
+    return written;
+}
+
+/**
+ * @Function SERIAL_TransmitSpace(void)
+ * @param None.
+ * @return Bytes that can be queued right now without dropping any
+ * @author rcrobert, 2014.12.10 */
+unsigned int SERIAL_TransmitSpace(void)
+{
+    return RingBuffer_Space(&transmitBuffer);
+}
+
+/**
+ * @Function SERIAL_GetDropCount(void)
+ * @param None.
+ * @return Transmit characters dropped since SERIAL_Init
+ * @author rcrobert, 2014.12.09 */
+unsigned int SERIAL_GetDropCount(void)
+{
+    return transmitDrops;
 }
 
 /**
@@ -122,18 +132,9 @@ void PutChar(char ch)
  * @author Max Dunne, 2011.11.10 */
 char GetChar(void)
 {
-    char ch;
-    if (getLength(receiveBuffer) == 0) {
+    uint8_t ch;
+    if (RingBuffer_Get(&receiveBuffer, &ch) == ERROR) {
         ch = 0;
-    } else {
-        GettingFromReceive = TRUE;
-        ch = readFront(receiveBuffer);
-        GettingFromReceive = FALSE;
-    }
-    //re-enter the interrupt if we added a character while transmitting another one
-    if (ReceiveCollisionOccured) {
-        INTSetFlag(INT_U1RX);
-        ReceiveCollisionOccured = FALSE;
     }
     return ch;
 }
@@ -159,9 +160,7 @@ void _mon_putc(char c)
  * @author Max Dunne, 2011.11.10 */
 void _mon_puts(const char* s)
 {
-    int i;
-    for (i = 0; i<sizeof (s); i++)
-        PutChar(s[i]);
+    SERIAL_Write(s, strlen(s));
 }
 
 /**
@@ -173,9 +172,10 @@ void _mon_puts(const char* s)
  * @author Max Dunne, 2011.11.10 */
 int _mon_getc(int CanBlock)
 {
-    if (getLength(receiveBuffer) == 0)
+    uint8_t ch;
+    if (RingBuffer_Get(&receiveBuffer, &ch) == ERROR)
         return -1;
-    return GetChar();
+    return ch;
 }
 
 /**
@@ -186,7 +186,7 @@ int _mon_getc(int CanBlock)
  * @author Max Dunne, 2011.12.15 */
 char IsReceiveEmpty(void)
 {
-    if (getLength(receiveBuffer) == 0)
+    if (RingBuffer_Count(&receiveBuffer) == 0)
         return TRUE;
     return FALSE;
 }
@@ -195,11 +195,11 @@ char IsReceiveEmpty(void)
  * @Function IsTransmitEmpty(void)
  * @param None.
  * @return TRUE or FALSE
- * @brief  returns the state of the receive buffer
+ * @brief  returns the state of the transmit buffer
  * @author Max Dunne, 2011.12.15 */
 char IsTransmitEmpty(void)
 {
-    if (getLength(transmitBuffer) == 0)
+    if (RingBuffer_Count(&transmitBuffer) == 0)
         return TRUE;
     return FALSE;
 }
@@ -226,199 +226,30 @@ char IsTransmitEmpty(void)
 void __ISR(_UART1_VECTOR, ipl4) IntUart1Handler(void)
 {
     if (INTGetFlag(INT_U1RX)) {
-        INTClearFlag(INT_U1RX);
-        if (!GettingFromReceive) {
-            writeBack(receiveBuffer, (unsigned char) U1RXREG);
-        } else {
-            //acknowledge we have a collision and return
-            ReceiveCollisionOccured = TRUE;
-        }
-    }
-    if (INTGetFlag(INT_U1TX)) {
-        INTClearFlag(INT_U1TX);
-        if (!(getLength(transmitBuffer) == 0)) {
-            if (!AddingToTransmit) {
-                U1TXREG = readFront(transmitBuffer);
-            } else {
-                //acknowledge we have a collision and return
-                TransmitCollisionOccured = TRUE;
-            }
-        }
-    }
-
-}
-
-/*******************************************************************************
- * PRIVATE FUNCTIONS                                                          *
- ******************************************************************************/
-
-void newCircBuffer(CBRef cB)
-{
-
-    // initialize to zero
-    int i;
-    for (i = 0; i < QUEUESIZE; i++) {
-        cB->buffer[i] = 0;
-    }
-
-    // initialize the data members
-    cB->head = 0;
-    cB->tail = 0;
-    cB->size = QUEUESIZE;
-    cB->overflowCount = 0;
-
-}
-
-// this function frees the Circular Buffer CB Ref
-
-void freeCircBuffer(CBRef* cB)
-{
-    // if it is already null, nothing to free
-    if (cB == NULL || *cB == NULL) {
-        return;
-    }
-
-    // free and nil the pointer
-    //free(*cB);
-    *cB = NULL;
-}
-
-
-
-
-// Accesor Methods
-// ===============
-
-// returns the amount of unread bytes in the circular buffer
-
-unsigned int getLength(CBRef cB)
-{
-    // if the circular buffer is not null
-    if (cB != NULL) {
-        if (cB->head <= cB->tail) {
-            return (cB->tail - cB->head);
-        } else {
-            return (cB->size + cB->tail - cB->head);
+        // Drain the whole receive FIFO, an overrun stops the receiver
+        while (U1STAbits.URXDA) {
+            RingBuffer_Put(&receiveBuffer, (uint8_t) U1RXREG);
         }
-    } else {
-        return 0;
-    }
-
-
-}
-
-// returns the actual index of the head
-
-int readHead(CBRef cB)
-{
-    // if the circular buffer is not null
-    if (cB != NULL) {
-        return (cB->head);
-    } else {
-        return 0;
-    }
-
-}
-
-// returns the actual index of the tail
-
-int readTail(CBRef cB)
-{
-    // if the circular buffer is not null
-    if (cB != NULL) {
-        return (cB->tail);
-    } else {
-        return 0;
-    }
-
-}
-
-// returns the byte (actual value) that the head points to. this
-// does not mark the byte as read, so succesive calls to peak will
-// always return the same value
-
-unsigned char peak(CBRef cB)
-{
-    // if the circular buffer is not null
-    if (cB != NULL) {
-        // if there are bytes in the buffer
-        if (getLength(cB) > 0) {
-            return cB->buffer[cB->head];
-        }
-    }
-    return 0;
-}
-
-
-// Manipulation Procedures
-// ======================
-// returns the front of the circular buffer and marks the byte as read
-
-unsigned char readFront(CBRef cB)
-{
-    // if the circular buffer is not null
-    if (cB != NULL) {
-        char retVal;
-        // if there are bytes in the buffer
-        if (getLength(cB) > 0) {
-            retVal = cB->buffer[cB->head];
-            cB->head = cB->head < (cB->size - 1) ? cB->head + 1 : 0;
-            return retVal;
+        if (U1STAbits.OERR) {
+            U1STAbits.OERR = 0;
         }
-        return 128;
+        INTClearFlag(INT_U1RX);
     }
-    return 254;
-}
-
-// writes one byte at the end of the circular buffer,
-// increments overflow count if overflow occurs
+    if (INTGetFlag(INT_U1TX) && INTGetEnable(INT_U1TX)) {
+        uint8_t ch;
 
-unsigned char writeBack(CBRef cB, unsigned char data)
-{
-    // if the circular buffer is not null
-    if (cB != NULL) {
-        if (getLength(cB) == (cB->size - 1)) {
-            cB->overflowCount++;
-            //return 1;
-        } else {
-            cB->buffer[cB->tail] = data;
-            cB->tail = cB->tail < (cB->size - 1) ? cB->tail + 1 : 0;
-            //return 0;
+        // Top up the hardware FIFO, one interrupt per FIFO instead of per char
+        while (!U1STAbits.UTXBF && (RingBuffer_Get(&transmitBuffer, &ch) != ERROR)) {
+            U1TXREG = ch;
         }
-        //return 0;
-    } else {
-        return 1;
-    }
-    return 0;
-}
-
-// empties the circular buffer. It does not change the size. use with caution!!
-
-void makeEmpty(CBRef cB)
-{
-    if (cB != NULL) {
-        int i;
-        for (i = 0; i < cB->size; ++i) {
-            cB->buffer[i] = 0;
+        if (RingBuffer_Count(&transmitBuffer) == 0) {
+            INTEnable(INT_U1TX, INT_DISABLED);
         }
-        cB->head = 0;
-        cB->tail = 0;
-        cB->overflowCount = 0;
+        INTClearFlag(INT_U1TX);
     }
-}
-
-// returns the amount of times the CB has overflown;
 
-unsigned char getOverflow(CBRef cB)
-{
-    if (cB != NULL) {
-        return cB->overflowCount;
-    }
-    return 0;
 }
 
-
-
 //#define SERIAL_TEST
 #ifdef SERIAL_TEST
 #include "serial.h"
@@ -0,0 +1,121 @@
+/*
+ * File:   serial.h
+ * Author: mdunne
+ *
+ * Interrupt driven UART1 at 115200. Transmit never blocks, characters that do
+ * not fit in the transmit buffer are dropped and counted so debug output does
+ * not change the timing of the caller.
+ *
+ * Local copy of the CMPE118 header, shadows the one in C:\CMPE118\include as
+ * long as ..\ comes first in the include directories.
+ *
+ * Created on November 10, 2011, 8:43 AM
+ */
+
+#ifndef SERIAL_H
+#define	SERIAL_H
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// Buffer sizes, powers of two. Transmit is large so bursts of debug output fit
+#define SERIAL_TX_QUEUESIZE 1024
+#define SERIAL_RX_QUEUESIZE 128
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function SERIAL_Init(void)
+ * @param none
+ * @return none
+ * @brief  Initializes the UART subsystem to 115200 and sets up the circular buffer
+ * @author Max Dunne, 2011.11.10 */
+void SERIAL_Init(void);
+
+/**
+ * @Function PutChar(char ch)
+ * @param ch - the char to be sent out the serial port
+ * @return None.
+ * @brief  adds char to the end of the circular buffer, dropped if it is full
+ * @author Max Dunne, 2011.11.10 */
+void PutChar(char ch);
+
+/**
+ * @Function SERIAL_Write(const char *data, unsigned int length)
+ * @param data - bytes to be sent out the serial port
+ * @param length - number of bytes
+ * @return Number of bytes queued, the rest were dropped
+ * @brief  copies as much as fits into the transmit buffer in at most two
+ * chunks and never waits on the UART
+ * @author rcrobert, 2014.12.09 */
+unsigned int SERIAL_Write(const char *data, unsigned int length);
+
+/**
+ * @Function SERIAL_TransmitSpace(void)
+ * @param None.
+ * @return Bytes that can be queued right now without dropping any
+ * @author rcrobert, 2014.12.10 */
+unsigned int SERIAL_TransmitSpace(void);
+
+/**
+ * @Function SERIAL_GetDropCount(void)
+ * @param None.
+ * @return Transmit characters dropped since SERIAL_Init
+ * @author rcrobert, 2014.12.09 */
+unsigned int SERIAL_GetDropCount(void);
+
+/**
+ * @Function GetChar(void)
+ * @param None.
+ * @return ch - char from the serial port
+ * @brief  reads first character from buffer or returns 0 if no chars available
+ * @author Max Dunne, 2011.11.10 */
+char GetChar(void);
+
+/**
+ * @Function _mon_putc(char c)
+ * @param c - char to be sent
+ * @return None.
+ * @brief  overwrites weakly define extern to use circular buffer instead of Microchip
+ * functions
+ * @author Max Dunne, 2011.11.10 */
+void _mon_putc(char c);
+
+/**
+ * @Function _mon_puts(const char* s)
+ * @param s - pointer to the string to be sent
+ * @return None.
+ * @brief  overwrites weakly defined extern to use circular buffer instead of Microchip
+ * functions
+ * @author Max Dunne, 2011.11.10 */
+void _mon_puts(const char* s);
+
+/**
+ * @Function _mon_getc(int CanBlock)
+ * @param CanBlock - unused variable but required to match Microchip form
+ * @return None.
+ * @brief  overwrites weakly defined extern to use circular buffer instead of Microchip
+ * functions
+ * @author Max Dunne, 2011.11.10 */
+int _mon_getc(int CanBlock);
+
+/**
+ * @Function IsReceiveEmpty(void)
+ * @param None.
+ * @return TRUE or FALSE
+ * @brief  returns the state of the receive buffer
+ * @author Max Dunne, 2011.12.15 */
+char IsReceiveEmpty(void);
+
+/**
+ * @Function IsTransmitEmpty(void)
+ * @param None.
+ * @return TRUE or FALSE
+ * @brief  returns the state of the transmit buffer
+ * @author Max Dunne, 2011.12.15 */
+char IsTransmitEmpty(void);
+
+#endif	/* SERIAL_H */